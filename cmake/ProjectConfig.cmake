@@ -27,6 +27,26 @@ if(SANITIZE)
     endif()
 endif()
 
+# Add option to use computed-goto threaded opcode dispatch in the CPU
+# Only has an effect on GCC/Clang, other compilers fall back to a plain dispatch loop
+
+option(THREADED_DISPATCH "Use computed-goto threaded opcode dispatch on GCC/Clang" ON)
+
+# Add option to lazily evaluate CPU flags
+# Flags are stored as the raw values they derive from and only packed into F when read
+
+option(LAZY_FLAGS "Lazily evaluate CPU flags" ON)
+
+# Add option to translate hot CPU blocks into native code
+# Only supported on x86-64 hosts. Exposes CPU::runJit()
+
+option(JIT "Enable the x86-64 dynamic recompiler" OFF)
+
+# Add option to use SSE2/AVX2 kernels for decoding tiles and applying palettes
+# Only has an effect on x86-64 hosts, which pick between them at runtime. Others use the scalar kernels
+
+option(SIMD "Use SSE2/AVX2 pixel kernels on x86-64 hosts" ON)
+
 # Enable extra warnings
 # Targets must be linked with `project_warnings` to be affected
 
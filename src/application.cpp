@@ -1,6 +1,7 @@
 #include "application.h"
 
 #include <chrono>
+#include <future>
 #include <stdexcept>
 #include <string>
 #include <thread>
@@ -9,6 +10,7 @@
 
 #include "common/log.h"
 
+#include "platform.h"
 #include "version.h"
 
 static constexpr int SCREEN_WIDTH  { 640 };
@@ -19,7 +21,17 @@ Application::~Application() {
     close();
 }
 
-void Application::init() {
+void Application::init(const Options& options) {
+    m_startupProfile = options.startupProfile;
+    m_startTime = options.startTime;
+
+    // Mapping the ROM and parsing its header don't need SDL, so they overlap with SDL starting up.
+    // Nothing else touches gb until the load is waited on
+    std::future<void> romLoad {};
+    if (options.romPath) {
+        romLoad = std::async(std::launch::async, [this, romPath = *options.romPath] { gb.init(romPath); });
+    }
+
     SDL_SetAppMetadata("GBBuddy", GBBUDDY_VERSION, "com.mattkolega.gbbuddy");
 
     if(!SDL_Init(SDL_INIT_VIDEO)) {
@@ -40,12 +52,23 @@ void Application::init() {
 
     log::info("SDL Renderer: {}", SDL_GetRendererName(m_renderer));
 
-    m_texture = SDL_CreateTexture(m_renderer, SDL_PIXELFORMAT_RGB24, SDL_TEXTUREACCESS_TARGET, SCREEN_HEIGHT, SCREEN_HEIGHT);
-    if (m_texture == nullptr) {
-        throw std::runtime_error("SDL texture could not be created! SDL_Error: " + std::string(SDL_GetError()));
+    m_sdlReadyTime = Clock::now();
+
+    if (romLoad.valid()) {
+        romLoad.get();  // Rethrows anything loading threw
+    } else {
+        auto romPath = platform::openFileDialog({{"Game Boy ROMs", "gb,gbc"}});
+        if (!romPath) throw std::runtime_error("No ROM file was selected");
+
+        gb.init(*romPath);
     }
 
-    gb.init();
+    m_romReadyTime = Clock::now();
+
+    // No gamepad is opened to drive a motor yet, so rumble only gets logged
+    gb.cartridge.setRumbleHandler([](void*, bool enabled) {
+        log::debug("Rumble motor switched {}", enabled ? "on" : "off");
+    }, nullptr);
 
     if (gb.cartridge.cartHeader.title[0] != '\0') {
         windowTitle = fmt::format("GBBuddy ({}) | {}", GBBUDDY_VERSION, gb.cartridge.cartHeader.title);
@@ -54,6 +77,8 @@ void Application::init() {
 }
 
 void Application::run() {
+    bool firstFrame {true};
+
     while (!m_quit) {
         auto frameStart = std::chrono::steady_clock::now();
         constexpr auto nsPerSec = std::chrono::nanoseconds(std::chrono::seconds(1));
@@ -61,12 +86,15 @@ void Application::run() {
 
         handleEvents();
 
-        // for (int i = 0; i < (gb.cyclesPerSecond / FPS); i++) {
-        //     gb.run();
-        // }
+        gb.run(GameBoy::CYCLES_PER_FRAME);
 
         updateDisplay();
 
+        if (firstFrame) {
+            if (m_startupProfile) reportStartupProfile(Clock::now());
+            firstFrame = false;
+        }
+
         auto frameEnd = std::chrono::steady_clock::now();
 
         if (frameDeadline > frameEnd) std::this_thread::sleep_for(frameDeadline - frameEnd);
@@ -93,6 +121,8 @@ void Application::handleEvents() {
 }
 
 void Application::updateDisplay() {
+    if (m_texture == nullptr) createTexture();
+
     // Render to texture
     SDL_SetRenderTarget(m_renderer, m_texture);
     SDL_SetRenderDrawColor(m_renderer, 0, 0, 0, 255);
@@ -104,6 +134,22 @@ void Application::updateDisplay() {
     SDL_RenderPresent(m_renderer);
 }
 
+void Application::createTexture() {
+    m_texture = SDL_CreateTexture(m_renderer, SDL_PIXELFORMAT_RGB24, SDL_TEXTUREACCESS_TARGET, SCREEN_HEIGHT, SCREEN_HEIGHT);
+    if (m_texture == nullptr) {
+        throw std::runtime_error("SDL texture could not be created! SDL_Error: " + std::string(SDL_GetError()));
+    }
+}
+
+void Application::reportStartupProfile(Clock::time_point firstFrameTime) const {
+    const auto sinceStart = [this](Clock::time_point time) {
+        return std::chrono::duration<double, std::milli>(time - m_startTime).count();
+    };
+
+    log::info("Startup profile: SDL ready {:.1f}ms, ROM ready {:.1f}ms, first frame {:.1f}ms",
+        sinceStart(m_sdlReadyTime), sinceStart(m_romReadyTime), sinceStart(firstFrameTime));
+}
+
 void Application::close() {
     SDL_DestroyTexture(m_texture);
     m_texture = nullptr;
@@ -1,16 +1,28 @@
 #pragma once
 
+#include <chrono>
+#include <filesystem>
+#include <optional>
+
 #include <SDL3/SDL.h>
 
 #include "core/gameboy.h"
 
 class Application {
 public:
+    struct Options {
+        std::optional<std::filesystem::path> romPath {};  // File dialog is shown if there isn't one
+        bool startupProfile {false};                        // Logs how long each startup stage took
+        std::chrono::steady_clock::time_point startTime {std::chrono::steady_clock::now()};  // Process start
+    };
+
     ~Application();
 
-    void init();
+    void init(const Options& options);
     void run();
 private:
+    using Clock = std::chrono::steady_clock;
+
     GameBoy gb;
 
     SDL_Window *m_window   { nullptr };
@@ -21,7 +33,19 @@ private:
 
     bool m_quit { false };
 
+    // Startup timestamps. Only reported with --startup-profile
+    bool m_startupProfile { false };
+    Clock::time_point m_startTime {};
+    Clock::time_point m_sdlReadyTime {};
+    Clock::time_point m_romReadyTime {};
+
     void handleEvents();
     void updateDisplay();
     void close();
+
+    // Texture only gets created when the first frame is presented so it doesn't hold up startup
+    void createTexture();
+
+    // Logs time from process start to each startup stage and the first emulated frame
+    void reportStartupProfile(Clock::time_point firstFrameTime) const;
 };
@@ -4,9 +4,22 @@
 #include <cstring>
 #include <filesystem>
 #include <fstream>
+#include <map>
+#include <mutex>
 #include <optional>
+#include <stdexcept>
 #include <vector>
 
+#ifdef _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
 #include "log.h"
 #include "types.h"
 
@@ -37,3 +50,135 @@ std::optional<std::vector<u8>> fs::loadFileIntoBuffer(const std::filesystem::pat
 
     return buffer;
 }
+
+MappedFile::MappedFile(const std::filesystem::path& filepath) {
+#ifdef _WIN32
+    HANDLE file = CreateFileW(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) throw std::runtime_error("Failed to open file: " + filepath.string());
+
+    LARGE_INTEGER fileSize {};
+    GetFileSizeEx(file, &fileSize);
+    m_size = static_cast<usize>(fileSize.QuadPart);
+
+    // Empty files can't be mapped
+    if (m_size > 0) {
+        HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping != nullptr) {
+            m_data = static_cast<const u8*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+            CloseHandle(mapping);  // View keeps the mapping alive
+        }
+    }
+    CloseHandle(file);
+#else
+    const int file = open(filepath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (file < 0) throw std::runtime_error("Failed to open file: " + filepath.string() + " Error: " + std::strerror(errno));
+
+    struct stat info {};
+    if (fstat(file, &info) == 0) m_size = static_cast<usize>(info.st_size);
+
+    if (m_size > 0) {
+        void* memory = mmap(nullptr, m_size, PROT_READ, MAP_SHARED, file, 0);
+        if (memory != MAP_FAILED) {
+            m_data = static_cast<const u8*>(memory);
+
+            // Whole file is going to be used and banked code gets accessed in no particular order
+            madvise(memory, m_size, MADV_WILLNEED);
+            madvise(memory, m_size, MADV_RANDOM);
+        }
+    }
+    close(file);  // Mapping stays valid after the descriptor is closed
+#endif
+
+    if (m_size > 0 && m_data == nullptr) throw std::runtime_error("Failed to map file: " + filepath.string());
+}
+
+MappedFile::~MappedFile() {
+    if (m_data == nullptr) return;
+#ifdef _WIN32
+    UnmapViewOfFile(m_data);
+#else
+    munmap(const_cast<u8*>(m_data), m_size);
+#endif
+}
+
+WritableMappedFile::WritableMappedFile(const std::filesystem::path& filepath, usize size)
+    : m_size(size)
+{
+    if (size == 0) throw std::runtime_error("Can't map empty file: " + filepath.string());
+
+#ifdef _WIN32
+    HANDLE file = CreateFileW(filepath.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) throw std::runtime_error("Failed to open file: " + filepath.string());
+
+    // Mapping grows the file if it's smaller than size
+    HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READWRITE, static_cast<DWORD>(static_cast<u64>(size) >> 32), static_cast<DWORD>(size), nullptr);
+    if (mapping != nullptr) {
+        m_data = static_cast<u8*>(MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, size));
+        CloseHandle(mapping);  // View keeps the mapping alive
+    }
+    if (m_data == nullptr) {
+        CloseHandle(file);
+        throw std::runtime_error("Failed to map file: " + filepath.string());
+    }
+    m_file = file;  // Needed to flush metadata
+#else
+    const int file = open(filepath.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (file < 0) throw std::runtime_error("Failed to open file: " + filepath.string() + " Error: " + std::strerror(errno));
+
+    // Grow file to size. Existing contents are kept and new bytes read as 0
+    struct stat info {};
+    const bool sized = fstat(file, &info) == 0 && (static_cast<usize>(info.st_size) >= size || ftruncate(file, static_cast<off_t>(size)) == 0);
+
+    void* memory = sized ? mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0) : MAP_FAILED;
+    close(file);  // Mapping stays valid after the descriptor is closed
+
+    if (memory == MAP_FAILED) throw std::runtime_error("Failed to map file: " + filepath.string() + " Error: " + std::strerror(errno));
+    m_data = static_cast<u8*>(memory);
+#endif
+}
+
+WritableMappedFile::~WritableMappedFile() {
+    flush();
+#ifdef _WIN32
+    UnmapViewOfFile(m_data);
+    CloseHandle(m_file);
+#else
+    munmap(m_data, m_size);
+#endif
+}
+
+void WritableMappedFile::flush() {
+#ifdef _WIN32
+    FlushViewOfFile(m_data, m_size);
+    FlushFileBuffers(m_file);
+#else
+    msync(m_data, m_size, MS_SYNC);
+#endif
+}
+
+std::shared_ptr<const MappedFile> fs::mapFile(const std::filesystem::path& filepath) {
+    static std::mutex mutex;
+    static std::map<std::filesystem::path, std::weak_ptr<const MappedFile>> mappedFiles;
+
+    std::error_code error;
+    const std::filesystem::path key {std::filesystem::weakly_canonical(filepath, error)};
+
+    const std::lock_guard lock {mutex};
+
+    // Forget files that nobody holds anymore so the map doesn't grow with every ROM opened
+    std::erase_if(mappedFiles, [](const auto& entry) { return entry.second.expired(); });
+
+    const std::filesystem::path& lookup {error ? filepath : key};
+    if (const auto existing = mappedFiles.find(lookup); existing != mappedFiles.end()) {
+        if (auto file = existing->second.lock()) return file;
+    }
+
+    try {
+        auto file = std::make_shared<const MappedFile>(filepath);
+        mappedFiles.insert_or_assign(lookup, file);
+        return file;
+    } catch (const std::runtime_error& exception) {
+        log::fatal("{}", exception.what());
+        return nullptr;
+    }
+}
@@ -1,12 +1,65 @@
 #pragma once
 
 #include <filesystem>
+#include <memory>
 #include <optional>
+#include <span>
 #include <vector>
 
 #include "types.h"
 
+// Read-only view of a whole file mapped into memory. Pages come straight from the OS page cache,
+// so every mapping of the same file shares one physical copy and nothing gets copied on load
+class MappedFile {
+public:
+    // Maps file at filepath. Throws std::runtime_error on failure
+    explicit MappedFile(const std::filesystem::path& filepath);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const u8* data() const { return m_data; }
+    usize size() const { return m_size; }
+    std::span<const u8> bytes() const { return {m_data, m_size}; }
+
+private:
+    const u8* m_data {nullptr};
+    usize m_size {0};
+};
+
+// Writable shared mapping of a file, which gets created or grown to the requested size.
+// Writes land straight in the OS page cache so they outlive the process crashing. flush() forces them to disk
+class WritableMappedFile {
+public:
+    // Maps file at filepath. Throws std::runtime_error on failure
+    WritableMappedFile(const std::filesystem::path& filepath, usize size);
+    ~WritableMappedFile();
+
+    WritableMappedFile(const WritableMappedFile&) = delete;
+    WritableMappedFile& operator=(const WritableMappedFile&) = delete;
+
+    u8* data() { return m_data; }
+    usize size() const { return m_size; }
+    std::span<u8> bytes() { return {m_data, m_size}; }
+
+    // Writes modified pages to disk and waits for them. Safe to call from another thread while the mapping is written
+    void flush();
+
+private:
+    u8* m_data {nullptr};
+    usize m_size {0};
+
+#ifdef _WIN32
+    void* m_file {nullptr};
+#endif
+};
+
 namespace fs {
     // Opens a file in binary mode and loads its contents into a vector of bytes
     std::optional<std::vector<u8>> loadFileIntoBuffer(const std::filesystem::path& filepath);
+
+    // Maps a file read-only. Files which are already mapped get reused so everything in the process
+    // shares one mapping. Returns nullptr on failure
+    std::shared_ptr<const MappedFile> mapFile(const std::filesystem::path& filepath);
 }
@@ -0,0 +1,106 @@
+#include "hash.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+namespace {
+    // Byte-at-a-time lookup table for the reflected polynomial
+    constexpr std::array<u32, 256> CRC32_TABLE = [] {
+        std::array<u32, 256> table {};
+        for (u32 i {0}; i < 256; i++) {
+            u32 crc {i};
+            for (int bit {0}; bit < 8; bit++) crc = (crc >> 1) ^ ((crc & 1) != 0 ? 0xEDB88320 : 0);
+            table[i] = crc;
+        }
+        return table;
+    }();
+}
+
+void Crc32::update(std::span<const u8> data) {
+    u32 crc {m_crc};
+    for (u8 byte : data) crc = CRC32_TABLE[(crc ^ byte) & 0xFF] ^ (crc >> 8);
+    m_crc = crc;
+}
+
+void Sha1::update(std::span<const u8> data) {
+    m_length += data.size();
+
+    // Top up a partial block first
+    if (m_blockSize > 0) {
+        const usize size {std::min(data.size(), BLOCK_SIZE - m_blockSize)};
+        std::memcpy(m_block.data() + m_blockSize, data.data(), size);
+        m_blockSize += size;
+        data = data.subspan(size);
+
+        if (m_blockSize < BLOCK_SIZE) return;
+        processBlock(m_block.data());
+        m_blockSize = 0;
+    }
+
+    // Whole blocks are hashed in place
+    while (data.size() >= BLOCK_SIZE) {
+        processBlock(data.data());
+        data = data.subspan(BLOCK_SIZE);
+    }
+
+    std::memcpy(m_block.data(), data.data(), data.size());
+    m_blockSize = data.size();
+}
+
+Sha1::Digest Sha1::finish() {
+    const u64 bitLength {m_length * 8};
+
+    // 0x80 terminator, zeros up to 56 bytes into a block, then the big-endian bit length
+    std::array<u8, BLOCK_SIZE * 2> padding {0x80};
+    const usize paddingSize {(m_blockSize < 56 ? 56 : 120) - m_blockSize};
+    for (usize i {0}; i < 8; i++) padding[paddingSize + i] = static_cast<u8>(bitLength >> (56 - i * 8));
+    update({padding.data(), paddingSize + 8});
+
+    Digest digest {};
+    for (usize i {0}; i < m_state.size(); i++) {
+        for (usize byte {0}; byte < 4; byte++) digest[i * 4 + byte] = static_cast<u8>(m_state[i] >> (24 - byte * 8));
+    }
+    return digest;
+}
+
+void Sha1::processBlock(const u8* block) {
+    std::array<u32, 80> words {};
+    for (usize i {0}; i < 16; i++) {
+        words[i] = (static_cast<u32>(block[i * 4]) << 24) | (block[i * 4 + 1] << 16) | (block[i * 4 + 2] << 8) | block[i * 4 + 3];
+    }
+    for (usize i {16}; i < 80; i++) {
+        words[i] = std::rotl(words[i - 3] ^ words[i - 8] ^ words[i - 14] ^ words[i - 16], 1);
+    }
+
+    u32 a {m_state[0]}, b {m_state[1]}, c {m_state[2]}, d {m_state[3]}, e {m_state[4]};
+    for (usize i {0}; i < 80; i++) {
+        u32 f {}, k {};
+        if (i < 20) {
+            f = (b & c) | (~b & d);
+            k = 0x5A827999;
+        } else if (i < 40) {
+            f = b ^ c ^ d;
+            k = 0x6ED9EBA1;
+        } else if (i < 60) {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8F1BBCDC;
+        } else {
+            f = b ^ c ^ d;
+            k = 0xCA62C1D6;
+        }
+
+        const u32 temp {std::rotl(a, 5) + f + e + k + words[i]};
+        e = d;
+        d = c;
+        c = std::rotl(b, 30);
+        b = a;
+        a = temp;
+    }
+
+    m_state[0] += a;
+    m_state[1] += b;
+    m_state[2] += c;
+    m_state[3] += d;
+    m_state[4] += e;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <array>
+#include <span>
+
+#include "types.h"
+
+// Streaming CRC-32 (IEEE 802.3, as used by zip and No-Intro DATs). Data can be fed in any number of pieces
+class Crc32 {
+public:
+    void update(std::span<const u8> data);
+    u32 value() const { return ~m_crc; }
+
+private:
+    u32 m_crc {0xFFFFFFFF};
+};
+
+// Streaming SHA-1. Data can be fed in any number of pieces, then finish() gives the digest
+class Sha1 {
+public:
+    using Digest = std::array<u8, 20>;
+
+    void update(std::span<const u8> data);
+
+    // Pads the message and returns the digest. Nothing more can be fed in afterwards
+    Digest finish();
+
+private:
+    static constexpr usize BLOCK_SIZE {64};
+
+    std::array<u32, 5> m_state {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+    std::array<u8, BLOCK_SIZE> m_block {};
+    usize m_blockSize {0};  // Bytes waiting in m_block
+    u64 m_length {0};       // Total bytes fed in
+
+    void processBlock(const u8* block);
+};
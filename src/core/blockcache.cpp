@@ -0,0 +1,62 @@
+#include "blockcache.h"
+
+#include <utility>
+
+Block* BlockCache::find(u16 address, u16 bank) {
+    m_retired.clear();
+
+    auto it = m_blocks.find(makeKey(address, bank));
+    if (it == m_blocks.end()) {
+        m_stats.misses++;
+        return nullptr;
+    }
+
+    m_stats.hits++;
+    return &it->second;
+}
+
+Block& BlockCache::insert(u16 bank, Block block) {
+    const u32 key {makeKey(block.start, bank)};
+
+    // Register block with every page its code touches so writes there can find it
+    // End wraps to 0 for blocks which run up to $FFFF
+    const usize lastPage {static_cast<u16>(block.end - 1) / PAGE_SIZE};
+    for (usize page {block.start / PAGE_SIZE}; page <= lastPage; page++) {
+        m_pageBlocks[pageOf(static_cast<u16>(page * PAGE_SIZE))].push_back(key);
+    }
+
+    return m_blocks.insert_or_assign(key, std::move(block)).first->second;
+}
+
+void BlockCache::clear() {
+    for (auto& [key, block] : m_blocks) {
+        block.valid = false;
+    }
+    while (!m_blocks.empty()) {
+        m_retired.push_back(m_blocks.extract(m_blocks.begin()));
+    }
+    for (auto& keys : m_pageBlocks) {
+        keys.clear();
+    }
+}
+
+void BlockCache::invalidatePage(usize page) {
+    for (u32 key : m_pageBlocks[page]) {
+        auto node = m_blocks.extract(key);
+        if (node.empty()) continue;  // Already thrown away through another page
+
+        // Drop it from the other pages it spans too, otherwise a re-decoded block under the same key
+        // would keep adding to their lists
+        const Block& block {node.mapped()};
+        const usize lastPage {static_cast<u16>(block.end - 1) / PAGE_SIZE};
+        for (usize other {block.start / PAGE_SIZE}; other <= lastPage; other++) {
+            const usize otherPage {pageOf(static_cast<u16>(other * PAGE_SIZE))};
+            if (otherPage != page) std::erase(m_pageBlocks[otherPage], key);
+        }
+
+        node.mapped().valid = false;
+        m_retired.push_back(std::move(node));
+        m_stats.invalidations++;
+    }
+    m_pageBlocks[page].clear();
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <array>
+#include <unordered_map>
+#include <vector>
+
+#include "common/types.h"
+
+// A single instruction with its immediate operands already resolved
+struct DecodedInstruction {
+    u8 opcode;
+    u8 length;
+    u16 operand;  // Immediate operands, or the second byte of $CB opcodes
+    u16 offset;   // M-cycles taken by instructions before this one in the block
+};
+
+// Straight-line run of pre-decoded instructions. Ends at the first instruction which can branch
+struct Block {
+    std::vector<DecodedInstruction> instructions {};
+    u16 start {};  // Address of first instruction
+    u16 end {};    // Address after last instruction
+    u32 cycles {};       // M-cycles taken by whole block if any final branch isn't taken
+    u8 branchCycles {};  // Extra M-cycles taken if final branch is taken
+    bool valid {true};
+    bool idleLoop {false};  // Branches back to its start and only polls memory
+
+    u32 executions {};               // Number of times block has run. Used to find hot blocks
+    const void* compiled {nullptr};  // Native code translated by the JIT
+};
+
+struct BlockCacheStats {
+    u64 hits {};
+    u64 misses {};
+    u64 invalidations {};  // Number of blocks thrown away due to writes
+};
+
+// Cache of pre-decoded blocks keyed by start address and the bank mapped there.
+// Blocks for every bank stay cached so bank switches only change which blocks get looked up
+class BlockCache {
+public:
+    static constexpr usize MAX_BLOCK_LENGTH {64};   // Max instructions per block
+    static constexpr usize PAGE_SIZE {256};         // Granularity of write invalidation
+
+    // Gets cached block for address and bank. Returns nullptr if none is cached
+    Block* find(u16 address, u16 bank);
+
+    // Adds decoded block to cache and returns it
+    Block& insert(u16 bank, Block block);
+
+    // Invalidates blocks containing code at address. Cheap when the page holds no code
+    void invalidateWrite(u16 address) {
+        const usize page {pageOf(address)};
+        if (!m_pageBlocks[page].empty()) invalidatePage(page);
+    }
+
+    // Throws away all cached blocks
+    void clear();
+
+    const BlockCacheStats& stats() const { return m_stats; }
+
+private:
+    using BlockMap = std::unordered_map<u32, Block>;
+
+    BlockMap m_blocks {};
+
+    // Keys of the blocks which have code in each page
+    std::array<std::vector<u32>, 0x10000 / PAGE_SIZE> m_pageBlocks {};
+
+    // Blocks which were invalidated but may still be executing. Freed on the next lookup
+    std::vector<BlockMap::node_type> m_retired {};
+
+    BlockCacheStats m_stats {};
+
+    void invalidatePage(usize page);
+
+    // Gets page holding code at address. Echo RAM shares pages with the WRAM it mirrors
+    static constexpr usize pageOf(u16 address) {
+        if (address >= 0xE000 && address <= 0xFDFF) address -= 0x2000;
+        return address / PAGE_SIZE;
+    }
+
+    static constexpr u32 makeKey(u16 address, u16 bank) {
+        return (static_cast<u32>(bank) << 16) | address;
+    }
+};
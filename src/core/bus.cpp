@@ -1,42 +1,151 @@
 #include "bus.h"
 
-#include "common/log.h"
+#include <algorithm>
 
-#include "cartridge.h"
+RealBus::RealBus(Cartridge& cartridge)
+    : m_cartridge(cartridge)
+{
+    mapPages(0xC000, WRAM_BANK_SIZE, wram(0), wram(0));
+    mapPages(0xE000, WRAM_BANK_SIZE, wram(0), wram(0));  // Echo RAM mirrors $C000-$DDFF, so $F000-$FDFF follows the WRAM bank
+    mapPages(0xFE00, m_oam.size(), m_oam.data(), m_oam.data());
+    setVramBank(0);
+    setWramBank(1);
+}
 
-u8 RealBus::read(u16 address) {
-    if (address <= 0x7FFF) return m_cartridge.romRead(address);
-    if (address <= 0xDFFF) return m_memory[address];
-    if (address <= 0xFDFF) return m_memory[address - 0x2000];
-    if (address <= 0xFF44) return m_memory[address];
-    if (address <= 0xFFFF) return m_memory[address];
+void RealBus::mapCartridge() {
+    const BankMapping& banks {m_cartridge.banks()};
+
+    // ROM is never written directly as writes there go to mapper registers
+    if (banks.rom0 != m_mappedBanks.rom0) mapPages(0x0000, 0x4000, banks.rom0, nullptr);
+    if (banks.romX != m_mappedBanks.romX) mapPages(0x4000, 0x4000, banks.romX, nullptr);
+    if (banks.ram != m_mappedBanks.ram) mapPages(0xA000, 0x2000, banks.ram, m_trackRamWrites ? nullptr : banks.ram);
+
+    m_mappedBanks = banks;
+}
 
-    log::warn("Attempted read from unmapped memory at address: {:X}", address);
-    return 0;
+void RealBus::trackCartridgeWrites() {
+    m_trackRamWrites = true;
+    if (m_mappedBanks.ram != nullptr) mapPages(0xA000, 0x2000, m_mappedBanks.ram, nullptr);
 }
 
-void RealBus::write(u16 address, u8 value) {
-    if (address <= 0x7FFF) { m_cartridge.romWrite(address, value); return; }
-    if (address <= 0xDFFF) { m_memory[address] = value; return; }
-    if (address <= 0xFDFF) { m_memory[address - 0x2000] = value; return; }
-    if (address <= 0xFFFF) { m_memory[address] = value;  return; }
+void RealBus::setCgbMode(bool enabled) {
+    setVramBank(0);
+    setWramBank(1);
+    m_high[VBK_ADDRESS - 0xFF00] = 0;
+    m_high[SVBK_ADDRESS - 0xFF00] = 0;
 
-    log::warn("Illegal write to unmapped memory at address: {:X}", address);
+    if (!enabled) {
+        setIORegister(VBK_ADDRESS, {});
+        setIORegister(SVBK_ADDRESS, {});
+        return;
+    }
+
+    setIORegister(VBK_ADDRESS, {
+        .context = this,
+        .write = [](void* context, u16, u8 value) { static_cast<RealBus*>(context)->setVramBank(value); },
+        .readMask = 0x01,
+        .writeMask = 0x01,
+    });
+    setIORegister(SVBK_ADDRESS, {
+        .context = this,
+        .write = [](void* context, u16, u8 value) { static_cast<RealBus*>(context)->setWramBank(value); },
+        .readMask = 0x07,
+        .writeMask = 0x07,
+    });
 }
 
-u8 MockBus::read(u16 address) {
-    if (address <= 0xFFFF) {
-        return m_memory[address];
-    } else {
-        log::warn("Attempted read from unmapped memory at address: {:X}", address);
-        return 0;
+void RealBus::setVramBank(u8 bank) {
+    m_vramBank = bank & 0x01;
+
+    // Tile data writes go through the slow path so the decoded tile can be thrown away
+    mapPages(0x8000, TileCache::TILE_DATA_SIZE, vram(m_vramBank), nullptr);
+    mapPages(0x8000 + TileCache::TILE_DATA_SIZE, VRAM_BANK_SIZE - TileCache::TILE_DATA_SIZE,
+             vram(m_vramBank) + TileCache::TILE_DATA_SIZE, vram(m_vramBank) + TileCache::TILE_DATA_SIZE);
+}
+
+void RealBus::setWramBank(u8 bank) {
+    m_wramBank = std::max<u8>(bank & 0x07, 1);  // SVBK still reads back 0
+    mapPages(0xD000, WRAM_BANK_SIZE, wram(m_wramBank), wram(m_wramBank));
+    mapPages(0xF000, 0x0E00, wram(m_wramBank), wram(m_wramBank));
+}
+
+void RealBus::setOamAccessible(bool accessible) {
+    mapPages(0xFE00, m_oam.size(), accessible ? m_oam.data() : nullptr, accessible ? m_oam.data() : nullptr);
+}
+
+void RealBus::setIORegister(u16 address, IORegister ioRegister) {
+    m_ioRegisters[address - 0xFF00] = ioRegister;
+}
+
+void RealBus::mapPages(u16 start, usize size, const u8* readMemory, u8* writeMemory) {
+    for (usize offset {0}; offset < size; offset += PAGE_SIZE) {
+        m_readPages[(start + offset) / PAGE_SIZE] = readMemory != nullptr ? readMemory + offset : nullptr;
+        m_writePages[(start + offset) / PAGE_SIZE] = writeMemory != nullptr ? writeMemory + offset : nullptr;
     }
 }
 
-void MockBus::write(u16 address, u8 value) {
-    if (address <= 0xFFFF) {
-        m_memory[address] = value;
-    } else {
-        log::warn("Illegal write to unmapped memory at address: {:X}", address);
+u8 RealBus::peek(u16 address) const {
+    if (const u8* memory {readPointer(address)}) return *memory;
+    if (address >= 0xFF80) return m_high[address - 0xFF00];
+    if (address < 0xFF00) return 0xFF;
+
+    const IORegister& ioRegister {m_ioRegisters[address - 0xFF00]};
+    const u8 value {ioRegister.read != nullptr ? ioRegister.read(ioRegister.context, address) : m_high[address - 0xFF00]};
+    return value | static_cast<u8>(~ioRegister.readMask);
+}
+
+u8 RealBus::readSlow(u16 address) {
+    if (address <= 0x7FFF) return m_cartridge.romRead(address);
+    if (address >= 0xFF00 && address <= 0xFF7F) return readIO(address);
+    if (address >= 0xA000 && address <= 0xBFFF) return m_cartridge.ramRead(address);
+    return 0xFF;
+}
+
+void RealBus::writeSlow(u16 address, u8 value) {
+    if (address <= 0x7FFF) {
+        // May switch banks, so ROM and RAM pages have to be looked up again
+        m_cartridge.romWrite(address, value);
+        mapCartridge();
+        return;
+    }
+    if (address >= 0xFF00 && address <= 0xFF7F) {
+        writeIO(address, value);
+        return;
+    }
+    if (address >= 0x8000 && address < 0x8000 + TileCache::TILE_DATA_SIZE) {
+        const u16 offset {static_cast<u16>(address - 0x8000)};
+        vram(m_vramBank)[offset] = value;
+        m_tileCache.invalidate(m_vramBank, offset);
+        return;
+    }
+    if (address >= 0xA000 && address <= 0xBFFF) {
+        if (m_mappedBanks.ram == nullptr) {
+            m_cartridge.ramWrite(address, value);
+            return;
+        }
+
+        // First write to tracked RAM. Only one is needed to know the save has to be flushed
+        m_cartridge.markRamDirty();
+        m_trackRamWrites = false;
+        mapPages(0xA000, 0x2000, m_mappedBanks.ram, m_mappedBanks.ram);
+        m_writePages[address / PAGE_SIZE][address % PAGE_SIZE] = value;
     }
 }
+
+u8 RealBus::readIO(u16 address) {
+    const IORegister& ioRegister {m_ioRegisters[address - 0xFF00]};
+    if (ioRegister.sync != nullptr) ioRegister.sync(ioRegister.context);
+
+    const u8 value {ioRegister.read != nullptr ? ioRegister.read(ioRegister.context, address) : m_high[address - 0xFF00]};
+    return value | static_cast<u8>(~ioRegister.readMask);
+}
+
+void RealBus::writeIO(u16 address, u8 value) {
+    const IORegister& ioRegister {m_ioRegisters[address - 0xFF00]};
+    if (ioRegister.sync != nullptr) ioRegister.sync(ioRegister.context);
+
+    u8& stored {m_high[address - 0xFF00]};
+    stored = (stored & ~ioRegister.writeMask) | (value & ioRegister.writeMask);
+
+    if (ioRegister.write != nullptr) ioRegister.write(ioRegister.context, address, stored);
+}
@@ -1,41 +1,195 @@
 #pragma once
 
 #include <array>
+#include <concepts>
 
 #include "common/types.h"
 
+#include "cartridge.h"
+#include "tilecache.h"
+
 static constexpr usize BUS_MEMORY_SIZE {1024 * 64};
 
-class Cartridge;
+// Anything which can service CPU memory accesses.
+// Used as a template constraint rather than a virtual interface so accesses can be inlined
+template<typename T>
+concept Bus = requires(T bus, u16 address, u8 value) {
+    { bus.read(address) } -> std::same_as<u8>;
+    bus.write(address, value);
 
-class Bus {
-public:
-    virtual ~Bus() = default;
-    virtual u8   read(u16 address)          = 0;
-    virtual void write(u16 address, u8 val) = 0;
+    // Reads without any side effects, such as I/O hooks syncing their owner. Used by the JIT's diff mode
+    { bus.peek(address) } -> std::same_as<u8>;
+
+    // Bank currently mapped at address. Used to tell apart cached code from different banks
+    { bus.codeBank(address) } -> std::same_as<u16>;
+
+    // Whether writes to $0000-$7FFF leave memory untouched
+    { T::READ_ONLY_ROM } -> std::convertible_to<bool>;
 };
 
-// Proper Bus implementation to be used in the emulator
-class RealBus : public Bus {
+// Hooks for a single I/O register in $FF00-$FF7F. Registers without hooks act as plain storage
+struct IORegister {
+    using SyncHandler = void (*)(void* context);
+    using ReadHandler = u8 (*)(void* context, u16 address);
+    using WriteHandler = void (*)(void* context, u16 address, u8 value);
+
+    void* context {nullptr};       // Component which owns the register. Passed to every hook
+    SyncHandler sync {nullptr};    // Lets the owner catch up to the current time before any access
+    ReadHandler read {nullptr};    // Produces the value on reads. Stored value is used if nullptr
+    WriteHandler write {nullptr};  // Called with the new value after a write is stored
+
+    u8 readMask {0xFF};   // Bits which can be read. The rest read as 1
+    u8 writeMask {0xFF};  // Bits which can be written. The rest keep their value
+};
+
+// Proper Bus implementation to be used in the emulator.
+// Memory is split into 256-byte pages which point straight at host memory where possible, so most accesses
+// are a table lookup and a load. HRAM gets checked for inline as it shares its page with I/O. Pages without a
+// pointer (I/O, missing cartridge RAM, ROM writes, VRAM tile data writes) go through the slow path
+class RealBus {
 public:
-    u8 read(u16 address) override;
-    void write(u16 address, u8 value) override;
+    static constexpr bool READ_ONLY_ROM {true};
+
+    static constexpr usize PAGE_SIZE {256};
+    static constexpr usize PAGE_COUNT {BUS_MEMORY_SIZE / PAGE_SIZE};
+
+    static constexpr usize VRAM_BANK_SIZE {0x2000};
+    static constexpr usize WRAM_BANK_SIZE {0x1000};
+    static constexpr u16 VBK_ADDRESS {0xFF4F};   // VRAM bank select
+    static constexpr u16 SVBK_ADDRESS {0xFF70};  // WRAM bank select
+
+    u8 read(u16 address);
+    void write(u16 address, u8 value);
+
+    // Gets what a read would return without syncing the register's owner, so hooked I/O registers may be stale.
+    // Cartridge memory without a page reads as $FF
+    u8 peek(u16 address) const;
+
+    u16 codeBank(u16 address) const;
+
+    // Rebuilds page table entries for cartridge memory which changed since the last call.
+    // Needed after the cartridge is loaded and whenever its mapper switches banks
+    void mapCartridge();
+
+    // Sends the next write to cartridge RAM through the slow path so it can be marked dirty.
+    // Later writes go straight to RAM again until this is called after the next save flush
+    void trackCartridgeWrites();
+
+    // Enables the GBC VBK and SVBK bank registers. Without them VRAM bank 0 and WRAM bank 1 stay mapped
+    // and the registers act as plain storage
+    void setCgbMode(bool enabled);
+
+    // Maps VRAM bank to $8000-$9FFF. Only bit 0 is used
+    void setVramBank(u8 bank);
+
+    // Maps WRAM bank to $D000-$DFFF and its echo. Bank 0 selects bank 1
+    void setWramBank(u8 bank);
+
+    u8 vramBank() const { return m_vramBank; }
+
+    // Host memory backing a VRAM bank and OAM. Lets DMA and the PPU bypass the page table
+    u8* vram(u8 bank) { return m_ram.data() + bank * VRAM_BANK_SIZE; }
+    u8* oam() { return m_oam.data(); }
+
+    // Decoded tiles from both VRAM banks. Anything writing VRAM through vram() has to invalidate what it changes
+    TileCache& tiles() { return m_tileCache; }
 
-    explicit RealBus(Cartridge& cartridge)
-        : m_cartridge(cartridge) {}
+    // Gets host memory address is read from, or nullptr if reads there go through the slow path and may have side effects
+    const u8* readPointer(u16 address) const;
+
+    // Blocks CPU access to OAM, which reads as $FF and ignores writes. Used while OAM DMA runs
+    void setOamAccessible(bool accessible);
+
+    // Sets hooks for I/O register at address, which must be in $FF00-$FF7F
+    void setIORegister(u16 address, IORegister ioRegister);
+
+    explicit RealBus(Cartridge& cartridge);
 
 private:
-    std::array<u8, BUS_MEMORY_SIZE> m_memory {};  // Temporary 64KB will gradually be reduced to actual RAM size as proper memory mapping is introduced
+    // Host memory backing each page, or nullptr if accesses need the slow path
+    std::array<const u8*, PAGE_COUNT> m_readPages {};
+    std::array<u8*, PAGE_COUNT> m_writePages {};
+
+    // Both VRAM banks followed by all 8 WRAM banks. Kept in one cache-aligned block so switching banks is just
+    // re-pointing pages at a different offset
+    alignas(64) std::array<u8, 2 * VRAM_BANK_SIZE + 8 * WRAM_BANK_SIZE> m_ram {};
+    u8 m_vramBank {0};
+    u8 m_wramBank {1};
+
+    TileCache m_tileCache {m_ram.data()};
+
+    std::array<u8, 0x100> m_oam {};   // Includes the unusable area at $FEA0-$FEFF
+    std::array<u8, 0x100> m_high {};  // I/O registers, HRAM and IE register
+
+    std::array<IORegister, 0x80> m_ioRegisters {};
 
     Cartridge& m_cartridge;
+    BankMapping m_mappedBanks {};  // Cartridge memory the page table currently points at
+    bool m_trackRamWrites {false};  // Cartridge RAM is mapped read-only until it's next written
+
+    // Points pages covering [start, start + size) at consecutive chunks of memory. nullptr sends accesses to the slow path
+    void mapPages(u16 start, usize size, const u8* readMemory, u8* writeMemory);
+
+    u8* wram(u8 bank) { return m_ram.data() + 2 * VRAM_BANK_SIZE + bank * WRAM_BANK_SIZE; }
+
+    u8 readSlow(u16 address);
+    void writeSlow(u16 address, u8 value);
+
+    u8 readIO(u16 address);
+    void writeIO(u16 address, u8 value);
 };
 
 // Mock Bus implementation ONLY to be used for CPU testing
-class MockBus : public Bus {
+class MockBus {
 public:
-    u8 read(u16 address) override;
-    void write(u16 address, u8 value) override;
+    static constexpr bool READ_ONLY_ROM {false};
+
+    u8 read(u16 address) { return m_memory[address]; }
+    void write(u16 address, u8 value) { m_memory[address] = value; }
+    u8 peek(u16 address) const { return m_memory[address]; }
+
+    u16 codeBank(u16) const { return 0; }
 
 private:
     std::array<u8, BUS_MEMORY_SIZE> m_memory {};  // Flat 64kb of memory. No registers or mapping
-};
\ No newline at end of file
+};
+
+inline u8 RealBus::read(u16 address) {
+    const u8* page {m_readPages[address / PAGE_SIZE]};
+    if (page != nullptr) [[likely]] return page[address % PAGE_SIZE];
+
+    // HRAM and IE share the $FF page with I/O registers, but are plain memory
+    if (address >= 0xFF80) return m_high[address - 0xFF00];
+    return readSlow(address);
+}
+
+inline void RealBus::write(u16 address, u8 value) {
+    u8* page {m_writePages[address / PAGE_SIZE]};
+    if (page != nullptr) [[likely]] {
+        page[address % PAGE_SIZE] = value;
+        return;
+    }
+    if (address >= 0xFF80) {
+        m_high[address - 0xFF00] = value;
+        return;
+    }
+    writeSlow(address, value);
+}
+
+inline const u8* RealBus::readPointer(u16 address) const {
+    const u8* page {m_readPages[address / PAGE_SIZE]};
+    return page != nullptr ? page + address % PAGE_SIZE : nullptr;
+}
+
+inline u16 RealBus::codeBank(u16 address) const {
+    const BankMapping& banks {m_cartridge.banks()};
+    if (address <= 0x3FFF) return banks.rom0Bank;
+    if (address <= 0x7FFF) return banks.romBank;
+    if (address >= 0xA000 && address <= 0xBFFF) return banks.ram != nullptr ? banks.ramBank : 0xFFFF;  // Disabled RAM reads as $FF
+    if (address <= 0x9FFF) return m_vramBank;
+    if ((address >= 0xD000 && address <= 0xDFFF) || (address >= 0xF000 && address <= 0xFDFF)) return m_wramBank;
+    return 0;
+}
+
+static_assert(Bus<RealBus>);
+static_assert(Bus<MockBus>);
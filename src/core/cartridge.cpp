@@ -1,77 +1,198 @@
 #include "cartridge.h"
 
+#include <algorithm>
+#include <chrono>
 #include <stdexcept>
-#include <fstream>
+#include <type_traits>
+#include <utility>
 
 #include "common/bits.h"
-#include "common/dialog.h"
+#include "common/fs.h"
 #include "common/log.h"
 
-#include "mappers/nombc.h"
+#include "gameboy.h"
+#include "savefile.h"
+
+// Current wall-clock time as a UNIX timestamp
+static int64_t unixTime() {
+    return std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
 
 Cartridge::Cartridge(GameBoy *gb)
     : m_gb(gb)
 {
 }
 
-void Cartridge::init() {
-    loadGBFile();
+// Out of line as SaveFile is incomplete in the header
+Cartridge::~Cartridge() = default;
+
+void Cartridge::init(const std::filesystem::path& romPath) {
+    loadGBFile(romPath);
     verifyCartHeader();
+
+    std::filesystem::path savePath {romPath};
+    savePath.replace_extension(".sav");
+    initRam(savePath);
+
+    setMapper();
+    loadRtc();
+}
+
+void Cartridge::init(std::vector<uint8_t> rom) {
+    m_romFile.reset();
+    m_romBuffer = std::move(rom);
+    m_rom = m_romBuffer;
+    verifyCartHeader();
+    initRam({});
     setMapper();
 }
 
 void Cartridge::initForTests() {
-    m_rom.resize(32 * 1024);
-    m_ram.resize(8 * 1024);
+    m_romBuffer.assign(32 * 1024, 0);
+    m_rom = m_romBuffer;
+    m_saveFile.reset();
+    m_ramBuffer.assign(8 * 1024, 0);
+    m_ram = m_ramBuffer;
 
-    mapper = std::make_unique<NoMBC>(*this);
+    m_mapper.emplace<NoMBC>(*this);
 }
 
-uint8_t Cartridge::romRead(uint16_t address) {
-    return mapper->romRead(address);
+uint8_t Cartridge::romRead(uint16_t address) const {
+    const uint8_t* bank = address < 0x4000 ? m_banks.rom0 : m_banks.romX;
+    if (bank == nullptr) return 0xFF;
+    return bank[address & 0x3FFF];
 }
 
 void Cartridge::romWrite(uint16_t address, uint8_t value) {
-    return mapper->romWrite(address, value);
+    std::visit([&](auto& mapper) {
+        if constexpr (!std::is_same_v<std::decay_t<decltype(mapper)>, std::monostate>) {
+            mapper.romWrite(address, value);
+        }
+    }, m_mapper);
+}
+
+uint8_t Cartridge::ramRead(uint16_t address) {
+    return std::visit([&](auto& mapper) -> uint8_t {
+        if constexpr (requires { mapper.ramRead(address); }) return mapper.ramRead(address);
+        return 0xFF;
+    }, m_mapper);
+}
+
+void Cartridge::ramWrite(uint16_t address, uint8_t value) {
+    std::visit([&](auto& mapper) {
+        if constexpr (requires { mapper.ramWrite(address, value); }) mapper.ramWrite(address, value);
+    }, m_mapper);
 }
 
-void Cartridge::loadGBFile() {
-    auto filepath = Dialog::openFile("Open GB ROM File", {"*.gb"}, "Game Boy ROMs");
-    if (filepath.empty()) throw std::runtime_error("ROM size is too small to properly pass header");
+void Cartridge::setRumbleHandler(RumbleHandler handler, void* context) {
+    m_rumbleHandler = handler;
+    m_rumbleContext = context;
+}
 
-    std::ifstream romFile(filepath, std::ios::binary);
-    if (!romFile) throw std::runtime_error("Failed to open ROM file: " + filepath);
+const RTC* Cartridge::rtc() const {
+    return std::visit([](auto& mapper) -> const RTC* {
+        if constexpr (requires { mapper.rtc(); }) return mapper.rtc();
+        return nullptr;
+    }, m_mapper);
+}
 
-    log::info("{} {}", "Loaded ROM: ", filepath);
+RTC* Cartridge::rtc() {
+    return const_cast<RTC*>(std::as_const(*this).rtc());
+}
 
-    romFile.seekg(0, std::ios::end);
-    auto fileSize = romFile.tellg();
-    romFile.seekg(0, std::ios::beg);
+void Cartridge::flushSave() {
+    if (m_saveFile == nullptr) return;
 
-    m_rom.resize(fileSize);
-    if (!romFile.read(reinterpret_cast<char*>(m_rom.data()), fileSize)) {
-        throw std::runtime_error("Failed to read the ROM file.");
+    saveRtc();
+    m_saveFile->requestFlush();
+    m_ramDirty = false;
+}
+
+void Cartridge::save() {
+    if (m_saveFile == nullptr) return;
+
+    saveRtc();
+    m_saveFile->flush();
+    m_ramDirty = false;
+}
+
+void Cartridge::initRam(const std::filesystem::path& savePath) {
+    const size_t ramSize = (1024 * 8) * cartHeader.ramBanks;
+    const bool hasClock = cartHeader.cartType == 0x0F || cartHeader.cartType == 0x10;
+
+    m_saveFile.reset();
+    m_ramDirty = false;
+
+    if (cartHeader.hasBattery && !savePath.empty() && (ramSize > 0 || hasClock)) {
+        // RAM writes go straight to the file, so there's nothing to load or copy back on exit
+        try {
+            m_saveFile = std::make_unique<SaveFile>(savePath, ramSize + (hasClock ? RTC::FOOTER_SIZE : 0));
+            m_ramBuffer.clear();
+            m_ram = m_saveFile->bytes().first(ramSize);
+            log::info("Mapped save file: {}", savePath);
+            return;
+        } catch (const std::runtime_error& error) {
+            log::err("{} Progress won't be saved", error.what());
+        }
     }
+
+    m_ramBuffer.assign(ramSize, 0);
+    m_ram = m_ramBuffer;
 }
 
-void Cartridge::verifyCartHeader() {
+void Cartridge::loadRtc() {
+    RTC* clock = rtc();
+    if (clock == nullptr || m_saveFile == nullptr) return;
+
+    // New save files are all zero. Loading that footer would run the clock forward to the present from 1970
+    const auto footer = m_saveFile->bytes().last<RTC::FOOTER_SIZE>();
+    if (std::ranges::all_of(footer.last(8), [](uint8_t byte) { return byte == 0; })) return;
+
+    clock->loadFooter(footer, unixTime(), m_gb != nullptr ? m_gb->currentTime() : 0);
+}
+
+void Cartridge::saveRtc() {
+    const RTC* clock = rtc();
+    if (clock == nullptr || m_saveFile == nullptr) return;
+
+    clock->saveFooter(m_saveFile->bytes().last<RTC::FOOTER_SIZE>(), unixTime(), m_gb != nullptr ? m_gb->currentTime() : 0);
+}
+
+void Cartridge::loadGBFile(const std::filesystem::path& romPath) {
+    m_romFile = fs::mapFile(romPath);
+    if (m_romFile == nullptr) throw std::runtime_error("Failed to open ROM file: " + romPath.string());
+
+    m_rom = m_romFile->bytes();
+
+    log::info("{} {}", "Loaded ROM: ", romPath);
+}
+
+CartHeader Cartridge::parseHeader(std::span<const uint8_t> rom) {
     // If ROM size is less than required size for cart header, throw error
-    if (m_rom.size() < 325) throw std::runtime_error("ROM size is too small to properly parse header");
+    if (rom.size() < HEADER_END) throw std::runtime_error("ROM size is too small to properly parse header");
 
     CartHeader cartHeader;
 
     size_t titleIndex { 0x0134 };
 
     for (size_t i = titleIndex; i <= 0x0143; i++) {
-        if (m_rom[i] == 0x00) break;
-        cartHeader.title += m_rom[i];
+        if (rom[i] == 0x00) break;
+        cartHeader.title += rom[i];
     }
 
-    cartHeader.cartType = m_rom[0x0147];
+    cartHeader.cgbSupport = (rom[0x0143] & 0x80) != 0;
 
-    cartHeader.romBanks = 2 * (1 << m_rom[0x0148]);
+    cartHeader.cartType = rom[0x0147];
 
-    switch(m_rom[0x0149]) {
+    // Sizes past 8MiB don't exist and would overflow the shift
+    if (rom[0x0148] <= 0x08) {
+        cartHeader.romBanks = 2 * (1 << rom[0x0148]);
+    } else {
+        cartHeader.romBanks = 0;
+        log::warn("{} 0x{:X}", "Unknown value given for ROM size:", rom[0x0148]);
+    }
+
+    switch(rom[0x0149]) {
         case 0x00:
         case 0x01:
             cartHeader.ramBanks = 0;
@@ -90,22 +211,58 @@ void Cartridge::verifyCartHeader() {
             break;
         default:
             cartHeader.ramBanks = 0;
-            log::warn("{} 0x{:X}", "Unknown value given for number of RAM banks:", m_rom[0x0149]);
+            log::warn("{} 0x{:X}", "Unknown value given for number of RAM banks:", rom[0x0149]);
             break;
     }
 
-    m_ram.resize((1024 * 8) * cartHeader.ramBanks);
+    cartHeader.headerChecksum = rom[0x014D];
+    cartHeader.globalChecksum = bits::concatBytes(rom[0x014E], rom[0x014F]);
 
-    cartHeader.headerChecksum = m_rom[0x014D];
-    cartHeader.globalChecksum = bits::concatBytes(m_rom[0x014E], m_rom[0x014F]);
+    switch (cartHeader.cartType) {
+        case 0x03: case 0x06: case 0x09: case 0x0D: case 0x0F: case 0x10:
+        case 0x13: case 0x1B: case 0x1E: case 0x22: case 0xFF:
+            cartHeader.hasBattery = true;
+            break;
+        default:
+            cartHeader.hasBattery = false;
+            break;
+    }
+
+    return cartHeader;
+}
 
-    this->cartHeader = cartHeader;
+void Cartridge::verifyCartHeader() {
+    cartHeader = parseHeader(m_rom);
 }
 
 void Cartridge::setMapper() {
     switch (cartHeader.cartType) {
         case 0x00:
-            mapper = std::make_unique<NoMBC>(*this);
+            m_mapper.emplace<NoMBC>(*this);
+            break;
+        case 0x01: // MBC1
+        case 0x02: // MBC1 + RAM
+        case 0x03: // MBC1 + RAM + Battery
+            m_mapper.emplace<MBC1>(*this);
+            break;
+        case 0x0F: // MBC3 + Timer + Battery
+        case 0x10: // MBC3 + Timer + RAM + Battery
+            m_mapper.emplace<MBC3>(*this, true);
+            break;
+        case 0x11: // MBC3
+        case 0x12: // MBC3 + RAM
+        case 0x13: // MBC3 + RAM + Battery
+            m_mapper.emplace<MBC3>(*this, false);
+            break;
+        case 0x19: // MBC5
+        case 0x1A: // MBC5 + RAM
+        case 0x1B: // MBC5 + RAM + Battery
+            m_mapper.emplace<MBC5>(*this, false);
+            break;
+        case 0x1C: // MBC5 + Rumble
+        case 0x1D: // MBC5 + Rumble + RAM
+        case 0x1E: // MBC5 + Rumble + RAM + Battery
+            m_mapper.emplace<MBC5>(*this, true);
             break;
         default:
             throw std::runtime_error("Specified cartridge type not supported");
@@ -2,15 +2,25 @@
 
 #include <cstdint>
 #include <expected>
+#include <filesystem>
 #include <memory>
+#include <span>
 #include <string>
+#include <variant>
 #include <vector>
 
 #include "mappers/mapper.h"
+#include "mappers/mbc1.h"
+#include "mappers/mbc3.h"
+#include "mappers/mbc5.h"
+#include "mappers/nombc.h"
 
 class GameBoy;
+class MappedFile;
+class SaveFile;
 
-class NoMBC;
+// Every supported mapper. monostate until a cartridge is loaded
+using MapperVariant = std::variant<std::monostate, NoMBC, MBC1, MBC3, MBC5>;
 
 struct CartHeader {
     std::string title;
@@ -19,40 +29,113 @@ struct CartHeader {
     uint8_t ramBanks;   // Each RAM bank is 8KiB
     uint8_t headerChecksum;
     uint16_t globalChecksum;
+    bool hasBattery;  // RAM and clock keep their contents when powered off
+    bool cgbSupport;  // Game can use GBC features
 };
 
 class Cartridge {
 public:
+    // Called when the rumble motor is switched on or off
+    using RumbleHandler = void (*)(void* context, bool enabled);
+
     CartHeader cartHeader;
 
     Cartridge() = delete;
     Cartridge(GameBoy *gb);
+    ~Cartridge();
+
+    // Loads ROM file and sets up mapper. Battery backed RAM is mapped from the save file next to the ROM
+    void init(const std::filesystem::path& romPath);
 
-    // Loads ROM file and sets up mapper
-    void init();
+    // Takes ROM image already in memory and sets up mapper
+    void init(std::vector<uint8_t> rom);
 
     // Sets up cartridge for use in testing
     void initForTests();
 
-    uint8_t romRead(uint16_t address);
+    // Parses header at $0100-$014F. Only the first HEADER_END bytes of the ROM are needed.
+    // Throws std::runtime_error if the ROM is too small to hold a header
+    static CartHeader parseHeader(std::span<const uint8_t> rom);
+    static constexpr size_t HEADER_END {0x0150};
+
+    // Reads ROM through the current bank mapping. The bus normally reads banks() directly instead
+    uint8_t romRead(uint16_t address) const;
+
+    // Writes to mapper control registers. May change the bank mapping
     void romWrite(uint16_t address, uint8_t value);
 
+    // Accesses $A000-$BFFF while RAM isn't mapped. Goes to mapper registers such as the RTC, or open bus
+    uint8_t ramRead(uint16_t address);
+    void ramWrite(uint16_t address, uint8_t value);
+
+    // Sets function called whenever the rumble motor changes state. Only fires on changes so it's cheap to react to
+    void setRumbleHandler(RumbleHandler handler, void* context);
+
+    // Checks if RAM is backed by a save file. Writes to it only need to be noticed through markRamDirty()
+    bool hasSaveFile() const { return m_saveFile != nullptr; }
+
+    // Records that RAM was written since the last flushSave()
+    void markRamDirty() { m_ramDirty = true; }
+    bool isRamDirty() const { return m_ramDirty; }
+
+    // Updates the RTC footer and has the save file written out in the background. Never blocks
+    void flushSave();
+
+    // Updates the RTC footer and waits for the save file to reach the disk. Used at shutdown
+    void save();
+
+    // Gets ROM bank mapped to $4000-$7FFF
+    uint16_t romBank() const { return m_banks.romBank; }
+
+    // Gets RAM bank mapped to $A000-$BFFF
+    uint16_t ramBank() const { return m_banks.ramBank; }
+
+    // Gets host memory currently mapped into each region. Only changes on writes to ROM
+    const BankMapping& banks() const { return m_banks; }
+
 private:
-    std::unique_ptr<Mapper> mapper;
+    MapperVariant m_mapper {};
+    BankMapping m_banks {};
+
+    // ROM image. Read-only and either mapped from the ROM file, which is shared with every other
+    // cartridge using it, or pointing at m_romBuffer when loaded from memory
+    std::span<const uint8_t> m_rom {};
+    std::shared_ptr<const MappedFile> m_romFile {};
+    std::vector<uint8_t> m_romBuffer {};
+
+    // Cartridge RAM. Points into the save file mapping for battery backed carts, which is followed by the
+    // RTC footer if there's a clock, otherwise at m_ramBuffer
+    std::span<uint8_t> m_ram {};
+    std::vector<uint8_t> m_ramBuffer {};
+    std::unique_ptr<SaveFile> m_saveFile {};
+    bool m_ramDirty {false};
 
-    std::vector<uint8_t> m_rom {};
-    std::vector<uint8_t> m_ram {};
+    RumbleHandler m_rumbleHandler {nullptr};
+    void* m_rumbleContext {nullptr};
 
     GameBoy *m_gb { nullptr };
 
-    friend NoMBC;
+    friend Mapper;
 
-    // Opens and loads .gb file
-    void loadGBFile();
+    // Maps .gb file into memory
+    void loadGBFile(const std::filesystem::path& romPath);
 
     // Grabs all useful cartridge header info. Based on https://gbdev.io/pandocs/The_Cartridge_Header.html
     void verifyCartHeader();
 
+    // Sets up RAM of the size given in the header. Maps it from savePath if the cart has a battery and a path is given
+    void initRam(const std::filesystem::path& savePath);
+
     // Sets the Mapper/MBC based on cartridge type specified in header
     void setMapper();
+
+    // Restores RTC state from the save file footer if there's a clock
+    void loadRtc();
+
+    // Writes RTC state into the save file footer if there's a clock
+    void saveRtc();
+
+    // Gets mapper's clock. nullptr if it doesn't have one
+    const RTC* rtc() const;
+    RTC* rtc();
 };
\ No newline at end of file
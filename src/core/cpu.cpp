@@ -1,5 +1,6 @@
 #include "cpu.h"
 
+#include <algorithm>
 #include <bit>
 #include <sstream>
 #include <utility>
@@ -9,6 +10,13 @@
 #include "common/bits.h"
 
 #include "bus.h"
+#include "opcodes.h"
+
+#ifdef GBBUDDY_JIT
+#include "common/log.h"
+
+#include "jit/x64emitter.h"
+#endif
 
 // Make sure we're running on a little-endian system, CPU won't work properly if not
 static_assert(std::endian::native == std::endian::little,
@@ -46,14 +54,122 @@ bool operator==(CPUState &state1, CPUState &state2) {
     return true;
 }
 
-void CPU::step() {
-    u8 opcode {m_bus.read(m_pc++)};
-    decode(opcode);
+template<Bus BusType>
+CPU<BusType>::CPU(BusType& bus)
+    : m_bus(bus)
+{
+}
+
+template<Bus BusType>
+CPU<BusType>::~CPU() = default;
+
+template<Bus BusType>
+u8 CPU<BusType>::step() {
+    if (m_imePending || m_halted || m_haltBug || m_stallCycles != 0) [[unlikely]] {
+        if (m_stallCycles != 0) {
+            m_stallCycles--;
+            return 1;
+        }
+
+        // EI takes effect after the following instruction. Setting IME before running it lets DI
+        // cancel it, and run() doesn't check interrupts again until the instruction is done
+        if (m_imePending) {
+            m_ime = 1;
+            m_imePending = false;
+        }
+
+        // Halted CPU sits idle until an interrupt is pending
+        if (m_halted) {
+            if (pendingInterrupts() == 0) return 1;
+            m_halted = false;
+        }
+
+        // PC fails to move past the opcode after a bugged HALT, so its byte gets read again
+        if (m_haltBug) {
+            m_haltBug = false;
+            return s_fetchingHandlers[m_bus.read(m_pc)](*this);
+        }
+    }
+
+    const u8 opcode {m_bus.read(m_pc++)};
+    return s_fetchingHandlers[opcode](*this);
+}
+
+template<Bus BusType>
+u64 CPU<BusType>::run(u64 cycleBudget) {
+    u64 cycles {0};
+    m_endRun = false;
+
+    while (cycles < cycleBudget && !m_endRun) {
+        m_runCycles = cycles;
+        m_blockCycles = 0;
+
+        if (m_stallCycles != 0) [[unlikely]] {
+            const u64 idle {std::min(m_stallCycles, cycleBudget - cycles)};
+            m_stallCycles -= idle;
+            cycles += idle;
+            continue;
+        }
+
+        if (m_ime || m_halted) {
+            const u8 interruptCycles {handleInterrupts()};
+
+            // Nothing can wake the CPU before the next event fires and the caller never gives a budget
+            // past that, so skip straight to the end
+            if (m_halted) {
+                m_skippedCycles += cycleBudget - cycles;
+                cycles = cycleBudget;
+                break;
+            }
+
+            if (interruptCycles != 0) {
+                cycles += interruptCycles;
+                continue;
+            }
+        }
+
+        // Instruction after EI has to run on its own so interrupts aren't checked before it,
+        // and the one after a bugged HALT gets fetched differently
+        if (m_imePending || m_haltBug) {
+            cycles += step();
+            continue;
+        }
+
+#ifdef GBBUDDY_JIT
+        flushCodeIfFull();
+#endif
+
+        Block* block {lookupBlock()};
+
+        // Step through anything which can't be cached or might not fit in what's left of the budget
+        if (block == nullptr || block->cycles + block->branchCycles > cycleBudget - cycles) {
+            cycles += stepMany(cycleBudget - cycles);
+            continue;
+        }
+
+#ifdef GBBUDDY_JIT
+        cycles += runJitBlock(*block);
+#else
+        cycles += executeBlock(*block);
+#endif
+
+        // Loop only polls memory so it will keep spinning until an event or interrupt changes something
+        if (block->idleLoop && m_idleLoopSkipping && m_pc == block->start && !(m_ime && pendingInterrupts())) {
+            m_skippedCycles += cycleBudget - cycles;
+            cycles = cycleBudget;
+            break;
+        }
+    }
+
+    m_runCycles = 0;
+    m_blockCycles = 0;
+    return cycles;
 }
 
-void CPU::setState(CPUState state) {
+template<Bus BusType>
+void CPU<BusType>::setState(CPUState state) {
     m_af.hi = state.a;
-    m_af.lo = state.f;
+    writeFlags(state.f);
     m_bc.hi = state.b;
     m_bc.lo = state.c;
     m_de.hi = state.d;
@@ -63,12 +179,33 @@ void CPU::setState(CPUState state) {
     m_sp = state.sp;
     m_pc = state.pc;
     m_ime = state.ime;
+    m_imePending = false;
+    m_halted = false;
+    m_haltBug = false;
+    m_stallCycles = 0;
+}
+
+template<Bus BusType>
+void CPU<BusType>::invalidateCode(u16 address, usize size) {
+    if (size == 0) return;
+
+    const usize lastPage {(address + size - 1) / BlockCache::PAGE_SIZE};
+    for (usize page {address / BlockCache::PAGE_SIZE}; page <= lastPage; page++) {
+        m_blockCache.invalidateWrite(static_cast<u16>(page * BlockCache::PAGE_SIZE));
+    }
+}
+
+template<Bus BusType>
+void CPU<BusType>::setStopHandler(StopHandler handler, void* context) {
+    m_stopHandler = handler;
+    m_stopContext = context;
 }
 
-CPUState CPU::getState() {
+template<Bus BusType>
+CPUState CPU<BusType>::getState() {
     return CPUState{
         .a = m_af.hi,
-        .f = m_af.lo,
+        .f = readFlags(),
         .b = m_bc.hi,
         .c = m_bc.lo,
         .d = m_de.hi,
@@ -81,93 +218,184 @@ CPUState CPU::getState() {
     };
 }
 
-void CPU::printState() {
+template<Bus BusType>
+void CPU<BusType>::printState() {
     fmt::println(
         "A:{:02X} F:{:02X} B:{:02X} C:{:02X} D:{:02X} E:{:02X} H:{:02X} L:{:02X} SP:{:04X} PC:{:04X} PCMEM:{:02X},{:02X},{:02X},{:02X}",
-        m_af.hi, m_af.lo, m_bc.hi, m_bc.lo, m_de.hi, m_de.lo ,m_hl.hi, m_hl.lo, m_sp, m_pc, m_bus.read(m_pc), m_bus.read(m_pc+1), m_bus.read(m_pc+2), m_bus.read(m_pc+3)
+        m_af.hi, readFlags(), m_bc.hi, m_bc.lo, m_de.hi, m_de.lo ,m_hl.hi, m_hl.lo, m_sp, m_pc, m_bus.read(m_pc), m_bus.read(m_pc+1), m_bus.read(m_pc+2), m_bus.read(m_pc+3)
     );
 }
 
-u8 CPU::readReg8(Reg8 reg) const {
+template<Bus BusType>
+template<Reg8 reg>
+u8 CPU<BusType>::readReg8() const {
     using enum Reg8;
 
-    switch (reg) {
-    case A: return m_af.hi;
-    case F: return m_af.lo;
-    case B: return m_bc.hi;
-    case C: return m_bc.lo;
-    case D: return m_de.hi;
-    case E: return m_de.lo;
-    case H: return m_hl.hi;
-    case L: return m_hl.lo;
-    case HLMem: return m_bus.read(m_hl.full);
-    }
-
-    std::unreachable();
+    if constexpr (reg == A) return m_af.hi;
+    else if constexpr (reg == F) return readFlags();
+    else if constexpr (reg == B) return m_bc.hi;
+    else if constexpr (reg == C) return m_bc.lo;
+    else if constexpr (reg == D) return m_de.hi;
+    else if constexpr (reg == E) return m_de.lo;
+    else if constexpr (reg == H) return m_hl.hi;
+    else if constexpr (reg == L) return m_hl.lo;
+    else if constexpr (reg == HLMem) return m_bus.read(m_hl.full);
 }
 
-u16 CPU::readReg16(Reg16 reg) const {
+template<Bus BusType>
+template<Reg16 reg>
+u16 CPU<BusType>::readReg16() const {
     using enum Reg16;
 
-    switch (reg) {
-    case AF: return m_af.full;
-    case BC: return m_bc.full;
-    case DE: return m_de.full;
-    case HL: return m_hl.full;
-    case SP: return m_sp;
-    }
-
-    std::unreachable();
+    if constexpr (reg == AF) return bits::concatBytes(readFlags(), m_af.hi);
+    else if constexpr (reg == BC) return m_bc.full;
+    else if constexpr (reg == DE) return m_de.full;
+    else if constexpr (reg == HL) return m_hl.full;
+    else if constexpr (reg == SP) return m_sp;
 }
 
-void CPU::writeReg8(Reg8 reg, u8 value) {
+template<Bus BusType>
+template<Reg8 reg>
+void CPU<BusType>::writeReg8(u8 value) {
     using enum Reg8;
 
-    switch (reg) {
-    case A: m_af.hi = value; break;
-    case F: m_af.lo = value & 0xF0; break;
-    case B: m_bc.hi = value; break;
-    case C: m_bc.lo = value; break;
-    case D: m_de.hi = value; break;
-    case E: m_de.lo = value; break;
-    case H: m_hl.hi = value; break;
-    case L: m_hl.lo = value; break;
-    case HLMem: m_bus.write(m_hl.full, value); break;
-    default: std::unreachable();
-    }
+    if constexpr (reg == A) m_af.hi = value;
+    else if constexpr (reg == F) writeFlags(value);
+    else if constexpr (reg == B) m_bc.hi = value;
+    else if constexpr (reg == C) m_bc.lo = value;
+    else if constexpr (reg == D) m_de.hi = value;
+    else if constexpr (reg == E) m_de.lo = value;
+    else if constexpr (reg == H) m_hl.hi = value;
+    else if constexpr (reg == L) m_hl.lo = value;
+    else if constexpr (reg == HLMem) writeMemory(m_hl.full, value);
 }
 
-void CPU::writeReg16(Reg16 reg, u16 value) {
+template<Bus BusType>
+template<Reg16 reg>
+void CPU<BusType>::writeReg16(u16 value) {
     using enum Reg16;
 
-    switch (reg) {
-    case AF: m_af.full = value & 0xFFF0; break;
-    case BC: m_bc.full = value; break;
-    case DE: m_de.full = value; break;
-    case HL: m_hl.full = value; break;
-    case SP: m_sp = value; break;
-    default: std::unreachable();
+    if constexpr (reg == AF) { m_af.hi = value >> 8; writeFlags(value & 0xFF); }
+    else if constexpr (reg == BC) m_bc.full = value;
+    else if constexpr (reg == DE) m_de.full = value;
+    else if constexpr (reg == HL) m_hl.full = value;
+    else if constexpr (reg == SP) m_sp = value;
+}
+
+template<Bus BusType>
+template<u8 length>
+u16 CPU<BusType>::fetchOperands() {
+    if constexpr (length == 2) {
+        return m_bus.read(m_pc++);
+    } else if constexpr (length == 3) {
+        u8 lo = m_bus.read(m_pc++);
+        u8 hi = m_bus.read(m_pc++);
+        return bits::concatBytes(lo, hi);
+    } else {
+        return 0;
     }
 }
 
-u8 CPU::getCarry() const     { return bits::getBitInByte(m_af.lo, std::to_underlying(CPUFlags::C)); }
-u8 CPU::getHalfCarry() const { return bits::getBitInByte(m_af.lo, std::to_underlying(CPUFlags::H)); }
-u8 CPU::getSubtract() const  { return bits::getBitInByte(m_af.lo, std::to_underlying(CPUFlags::N)); }
-u8 CPU::getZero() const      { return bits::getBitInByte(m_af.lo, std::to_underlying(CPUFlags::Z)); }
+template<Bus BusType>
+void CPU<BusType>::writeMemory(u16 address, u8 value) {
+    m_bus.write(address, value);
 
-void CPU::setCarry(bool value)     { m_af.lo = bits::modifyBitInByte(m_af.lo, std::to_underlying(CPUFlags::C), value); }
-void CPU::setHalfCarry(bool value) { m_af.lo = bits::modifyBitInByte(m_af.lo, std::to_underlying(CPUFlags::H), value); }
-void CPU::setSubtract(bool value)  { m_af.lo = bits::modifyBitInByte(m_af.lo, std::to_underlying(CPUFlags::N), value); }
-void CPU::setZero(bool value)      { m_af.lo = bits::modifyBitInByte(m_af.lo, std::to_underlying(CPUFlags::Z), value); }
-
-void CPU::pushToStack(u16 value) {
+    // Writes to ROM are mapper control writes and never modify code, but may switch the bank the running
+    // block was decoded from
+    if (BusType::READ_ONLY_ROM && address <= 0x7FFF) {
+        m_mapperWritten = true;
+        return;
+    }
+    m_blockCache.invalidateWrite(address);
+}
+
+#ifdef GBBUDDY_LAZY_FLAGS
+
+template<Bus BusType>
+u8 CPU<BusType>::getCarry() const     { return (m_flagC >> 8) & 0b1; }
+template<Bus BusType>
+u8 CPU<BusType>::getHalfCarry() const { return (m_flagH >> 4) & 0b1; }
+template<Bus BusType>
+u8 CPU<BusType>::getSubtract() const  { return m_flagN & 0b1; }
+template<Bus BusType>
+u8 CPU<BusType>::getZero() const      { return m_flagZ == 0; }
+
+template<Bus BusType>
+void CPU<BusType>::setCarry(bool value)     { m_flagC = value << 8; }
+template<Bus BusType>
+void CPU<BusType>::setHalfCarry(bool value) { m_flagH = value << 4; }
+template<Bus BusType>
+void CPU<BusType>::setSubtract(bool value)  { m_flagN = value; }
+template<Bus BusType>
+void CPU<BusType>::setZero(bool value)      { m_flagZ = !value; }
+
+template<Bus BusType>
+void CPU<BusType>::setCarryFrom(u16 result)     { m_flagC = result; }
+template<Bus BusType>
+void CPU<BusType>::setHalfCarryFrom(u8 carries) { m_flagH = carries; }
+template<Bus BusType>
+void CPU<BusType>::setZeroFrom(u8 result)       { m_flagZ = result; }
+
+template<Bus BusType>
+u8 CPU<BusType>::readFlags() const {
+    return (getZero()      << std::to_underlying(CPUFlags::Z))
+         | (getSubtract()  << std::to_underlying(CPUFlags::N))
+         | (getHalfCarry() << std::to_underlying(CPUFlags::H))
+         | (getCarry()     << std::to_underlying(CPUFlags::C));
+}
+
+template<Bus BusType>
+void CPU<BusType>::writeFlags(u8 value) {
+    setZero(bits::getBitInByte(value, std::to_underlying(CPUFlags::Z)));
+    setSubtract(bits::getBitInByte(value, std::to_underlying(CPUFlags::N)));
+    setHalfCarry(bits::getBitInByte(value, std::to_underlying(CPUFlags::H)));
+    setCarry(bits::getBitInByte(value, std::to_underlying(CPUFlags::C)));
+}
+
+#else
+
+template<Bus BusType>
+u8 CPU<BusType>::getCarry() const     { return bits::getBitInByte(m_af.lo, std::to_underlying(CPUFlags::C)); }
+template<Bus BusType>
+u8 CPU<BusType>::getHalfCarry() const { return bits::getBitInByte(m_af.lo, std::to_underlying(CPUFlags::H)); }
+template<Bus BusType>
+u8 CPU<BusType>::getSubtract() const  { return bits::getBitInByte(m_af.lo, std::to_underlying(CPUFlags::N)); }
+template<Bus BusType>
+u8 CPU<BusType>::getZero() const      { return bits::getBitInByte(m_af.lo, std::to_underlying(CPUFlags::Z)); }
+
+template<Bus BusType>
+void CPU<BusType>::setCarry(bool value)     { m_af.lo = bits::modifyBitInByte(m_af.lo, std::to_underlying(CPUFlags::C), value); }
+template<Bus BusType>
+void CPU<BusType>::setHalfCarry(bool value) { m_af.lo = bits::modifyBitInByte(m_af.lo, std::to_underlying(CPUFlags::H), value); }
+template<Bus BusType>
+void CPU<BusType>::setSubtract(bool value)  { m_af.lo = bits::modifyBitInByte(m_af.lo, std::to_underlying(CPUFlags::N), value); }
+template<Bus BusType>
+void CPU<BusType>::setZero(bool value)      { m_af.lo = bits::modifyBitInByte(m_af.lo, std::to_underlying(CPUFlags::Z), value); }
+
+template<Bus BusType>
+void CPU<BusType>::setCarryFrom(u16 result)     { setCarry((result >> 8) & 0b1); }
+template<Bus BusType>
+void CPU<BusType>::setHalfCarryFrom(u8 carries) { setHalfCarry((carries >> 4) & 0b1); }
+template<Bus BusType>
+void CPU<BusType>::setZeroFrom(u8 result)       { setZero(result == 0); }
+
+template<Bus BusType>
+u8 CPU<BusType>::readFlags() const { return m_af.lo; }
+template<Bus BusType>
+void CPU<BusType>::writeFlags(u8 value) { m_af.lo = value & 0xF0; }
+
+#endif
+
+template<Bus BusType>
+void CPU<BusType>::pushToStack(u16 value) {
     m_sp--;
-    m_bus.write(m_sp, (value >> 8) & 0xFF);
+    writeMemory(m_sp, (value >> 8) & 0xFF);
     m_sp--;
-    m_bus.write(m_sp, value & 0xFF);
+    writeMemory(m_sp, value & 0xFF);
 }
 
-u16 CPU::popStack() {
+template<Bus BusType>
+u16 CPU<BusType>::popStack() {
     u8 lo = m_bus.read(m_sp);
     m_sp++;
     u8 hi = m_bus.read(m_sp);
@@ -179,210 +407,241 @@ u16 CPU::popStack() {
 8-bit Arithmetic and Logic Instructions
  */
 
-void CPU::ADC(u8 value) {
-    u8 originalValue = readReg8(Reg8::A);
-    u8 newValue = originalValue + value + getCarry();
+template<Bus BusType>
+void CPU<BusType>::ADC(u8 value) {
+    u8 originalValue = readReg8<Reg8::A>();
+    u16 result = originalValue + value + getCarry();
 
     // Set flags
-    setZero(newValue == 0);
+    setZeroFrom(result);
     setSubtract(0);
-    setHalfCarry(bits::checkHalfCarryAdd(originalValue, value, getCarry()));
-    setCarry((originalValue + value + getCarry()) > 0xFF);
+    setHalfCarryFrom(originalValue ^ value ^ result);
+    setCarryFrom(result);
 
-    writeReg8(Reg8::A, newValue);
+    writeReg8<Reg8::A>(result);
 }
 
-void CPU::ADD8(u8 value) {
-    u8 originalValue = readReg8(Reg8::A);
-    u8 newValue = originalValue + value;
+template<Bus BusType>
+void CPU<BusType>::ADD8(u8 value) {
+    u8 originalValue = readReg8<Reg8::A>();
+    u16 result = originalValue + value;
 
     // Set flags
-    setZero(newValue == 0);
+    setZeroFrom(result);
     setSubtract(0);
-    setHalfCarry(bits::checkHalfCarryAdd(originalValue, value));
-    setCarry((originalValue + value) > 0xFF);
+    setHalfCarryFrom(originalValue ^ value ^ result);
+    setCarryFrom(result);
 
-    writeReg8(Reg8::A, newValue);
+    writeReg8<Reg8::A>(result);
 }
 
-void CPU::AND(u8 value) {
-    u8 newValue = readReg8(Reg8::A) & value;
+template<Bus BusType>
+void CPU<BusType>::AND(u8 value) {
+    u8 newValue = readReg8<Reg8::A>() & value;
 
     // Set flags
-    setZero(newValue == 0);
+    setZeroFrom(newValue);
     setSubtract(0);
     setHalfCarry(1);
     setCarry(0);
 
-    writeReg8(Reg8::A, newValue);
+    writeReg8<Reg8::A>(newValue);
 }
 
-void CPU::CP(u8 value) {
-    u8 accumulator = readReg8(Reg8::A);
-    u8 result = accumulator - value;
+template<Bus BusType>
+void CPU<BusType>::CP(u8 value) {
+    u8 accumulator = readReg8<Reg8::A>();
+    u16 result = accumulator - value;
 
     // Set flags
-    setZero(result == 0);
+    setZeroFrom(result);
     setSubtract(1);
-    setHalfCarry(bits::checkHalfCarrySub(accumulator, value));
-    setCarry((accumulator - value) < 0);
+    setHalfCarryFrom(accumulator ^ value ^ result);
+    setCarryFrom(result);
 }
 
-void CPU::DEC8(Reg8 reg) {
-    u8 originalValue = readReg8(reg);
+template<Bus BusType>
+template<Reg8 reg>
+void CPU<BusType>::DEC8() {
+    u8 originalValue = readReg8<reg>();
     u8 newValue = originalValue - 1;
 
-    setZero(newValue == 0);
+    setZeroFrom(newValue);
     setSubtract(1);
-    setHalfCarry(bits::checkHalfCarrySub(originalValue, 1));
+    setHalfCarryFrom(originalValue ^ 1 ^ newValue);
 
-    writeReg8(reg, newValue);
+    writeReg8<reg>(newValue);
 }
 
-void CPU::INC8(Reg8 reg) {
-    u8 originalValue = readReg8(reg);
+template<Bus BusType>
+template<Reg8 reg>
+void CPU<BusType>::INC8() {
+    u8 originalValue = readReg8<reg>();
     u8 newValue = originalValue + 1;
 
-    setZero(newValue == 0);
+    setZeroFrom(newValue);
     setSubtract(0);
-    setHalfCarry(bits::checkHalfCarryAdd(originalValue, 1));
+    setHalfCarryFrom(originalValue ^ 1 ^ newValue);
 
-    writeReg8(reg, newValue);
+    writeReg8<reg>(newValue);
 }
 
-void CPU::OR(u8 value) {
-    u8 newValue = readReg8(Reg8::A) | value;
+template<Bus BusType>
+void CPU<BusType>::OR(u8 value) {
+    u8 newValue = readReg8<Reg8::A>() | value;
 
     // Set flags
-    setZero(newValue == 0);
+    setZeroFrom(newValue);
     setSubtract(0);
     setHalfCarry(0);
     setCarry(0);
 
-    writeReg8(Reg8::A, newValue);
+    writeReg8<Reg8::A>(newValue);
 }
 
-void CPU::SBC(u8 value) {
-    u8 originalValue = readReg8(Reg8::A);
-    u8 newValue = originalValue - value - getCarry();
+template<Bus BusType>
+void CPU<BusType>::SBC(u8 value) {
+    u8 originalValue = readReg8<Reg8::A>();
+    u16 result = originalValue - value - getCarry();
 
     // Set flags
-    setZero(newValue == 0);
+    setZeroFrom(result);
     setSubtract(1);
-    setHalfCarry(bits::checkHalfCarrySub(originalValue, value, getCarry()));
-    setCarry((originalValue - value - getCarry()) < 0);
+    setHalfCarryFrom(originalValue ^ value ^ result);
+    setCarryFrom(result);
 
-    writeReg8(Reg8::A, newValue);
+    writeReg8<Reg8::A>(result);
 }
 
-void CPU::SUB(u8 value) {
-    u8 originalValue = readReg8(Reg8::A);
-    u8 newValue = originalValue - value;
+template<Bus BusType>
+void CPU<BusType>::SUB(u8 value) {
+    u8 originalValue = readReg8<Reg8::A>();
+    u16 result = originalValue - value;
 
     // Set flags
-    setZero(newValue == 0);
+    setZeroFrom(result);
     setSubtract(1);
-    setHalfCarry(bits::checkHalfCarrySub(originalValue, value));
-    setCarry((originalValue - value) < 0);
+    setHalfCarryFrom(originalValue ^ value ^ result);
+    setCarryFrom(result);
 
-    writeReg8(Reg8::A, newValue);
+    writeReg8<Reg8::A>(result);
 }
 
-void CPU::XOR(u8 value) {
-    u8 newValue = readReg8(Reg8::A) ^ value;
+template<Bus BusType>
+void CPU<BusType>::XOR(u8 value) {
+    u8 newValue = readReg8<Reg8::A>() ^ value;
 
     // Set flags
-    setZero(newValue == 0);
+    setZeroFrom(newValue);
     setSubtract(0);
     setHalfCarry(0);
     setCarry(0);
 
-    writeReg8(Reg8::A, newValue);
+    writeReg8<Reg8::A>(newValue);
 }
 
 /**
 16-bit Arithmetic Instructions
  */
 
-void CPU::ADD16(Reg16 reg) {
-    u16 originalValue = readReg16(Reg16::HL);
-    u16 newValue = originalValue + readReg16(reg);
+template<Bus BusType>
+template<Reg16 reg>
+void CPU<BusType>::ADD16() {
+    u16 originalValue = readReg16<Reg16::HL>();
+    u16 value = readReg16<reg>();
+    u32 result = originalValue + value;
 
-    // Set flags
+    // Set flags. Carries out of bits 11 and 15 are shifted down to bits 4 and 8
     setSubtract(0);
-    setHalfCarry(bits::checkHalfCarryAdd(originalValue, readReg16(reg)));
-    setCarry((originalValue + readReg16(reg)) > 0xFFFF);
+    setHalfCarryFrom((originalValue ^ value ^ result) >> 8);
+    setCarryFrom(result >> 8);
 
-    writeReg16(Reg16::HL, newValue);
+    writeReg16<Reg16::HL>(result);
 }
 
 // Decrements 16-bit value
-void CPU::DEC16(Reg16 reg) {
-    writeReg16(reg, readReg16(reg)-1);
+template<Bus BusType>
+template<Reg16 reg>
+void CPU<BusType>::DEC16() {
+    writeReg16<reg>(readReg16<reg>()-1);
 }
 
 // Increments 16-bit value
-void CPU::INC16(Reg16 reg) {
-    writeReg16(reg, readReg16(reg)+1);
+template<Bus BusType>
+template<Reg16 reg>
+void CPU<BusType>::INC16() {
+    writeReg16<reg>(readReg16<reg>()+1);
 }
 
 /**
 Bit Operation Instructions
  */
 
-void CPU::BIT(Reg8 reg, u8 bitPos) {
-    setZero(bits::getBitInByte(readReg8(reg), bitPos) == 0);
+template<Bus BusType>
+template<Reg8 reg, u8 bitPos>
+void CPU<BusType>::BIT() {
+    setZeroFrom(readReg8<reg>() & (1 << bitPos));
     setSubtract(0);
     setHalfCarry(1);
 }
 
 // Resets bit in value
-void CPU::RES(Reg8 reg, u8 bitPos) {
-    writeReg8(reg, bits::modifyBitInByte(readReg8(reg), bitPos, 0));
+template<Bus BusType>
+template<Reg8 reg, u8 bitPos>
+void CPU<BusType>::RES() {
+    writeReg8<reg>(bits::modifyBitInByte(readReg8<reg>(), bitPos, 0));
 }
 
 // Sets bit
-void CPU::SET(Reg8 reg, u8 bitPos) {
-    writeReg8(reg, bits::modifyBitInByte(readReg8(reg), bitPos, 1));
+template<Bus BusType>
+template<Reg8 reg, u8 bitPos>
+void CPU<BusType>::SET() {
+    writeReg8<reg>(bits::modifyBitInByte(readReg8<reg>(), bitPos, 1));
 }
 
 // Swaps upper 4 bits and lower 4 bits of value
-void CPU::SWAP(Reg8 reg) {
-    u8 originalValue = readReg8(reg);
+template<Bus BusType>
+template<Reg8 reg>
+void CPU<BusType>::SWAP() {
+    u8 originalValue = readReg8<reg>();
     u8 newValue = bits::swapNibbles(originalValue);
 
     // Set flags
-    setZero(newValue == 0);
+    setZeroFrom(newValue);
     setSubtract(0);
     setHalfCarry(0);
     setCarry(0);
 
-    writeReg8(reg, newValue);
+    writeReg8<reg>(newValue);
 }
 
 /**
 Bit Shift Instructions
  */
 
-u8 CPU::RL(u8 value) {
+template<Bus BusType>
+u8 CPU<BusType>::RL(u8 value) {
     auto carryValue = getCarry();  // Get current carry flag value
     setCarry(bits::getBitInByte(value, 7));  // Set carry flag to leftmost bit
     u8 newValue = std::rotl(value, 1);
     return bits::modifyBitInByte(newValue, 0, carryValue);
 }
 
-void CPU::RL_r8(Reg8 reg) {
-    u8 newValue = RL(readReg8(reg));
-    writeReg8(reg, newValue);
+template<Bus BusType>
+template<Reg8 reg>
+void CPU<BusType>::RL_r8() {
+    u8 newValue = RL(readReg8<reg>());
+    writeReg8<reg>(newValue);
 
     // Set flags
-    setZero(newValue == 0);
+    setZeroFrom(newValue);
     setSubtract(0);
     setHalfCarry(0);
 }
 
-void CPU::RLA() {
-    writeReg8(Reg8::A, RL(readReg8(Reg8::A)));
+template<Bus BusType>
+void CPU<BusType>::RLA() {
+    writeReg8<Reg8::A>(RL(readReg8<Reg8::A>()));
 
     // Set flags
     setZero(0);
@@ -390,23 +649,27 @@ void CPU::RLA() {
     setHalfCarry(0);
 }
 
-u8 CPU::RLC(u8 value) {
+template<Bus BusType>
+u8 CPU<BusType>::RLC(u8 value) {
     setCarry(bits::getBitInByte(value, 7));  // Set carry flag to leftmost bit
     return std::rotl(value, 1);
 }
 
-void CPU::RLC_r8(Reg8 reg) {
-    u8 newValue = RLC(readReg8(reg));
-    writeReg8(reg, newValue);
+template<Bus BusType>
+template<Reg8 reg>
+void CPU<BusType>::RLC_r8() {
+    u8 newValue = RLC(readReg8<reg>());
+    writeReg8<reg>(newValue);
 
     // Set flags
-    setZero(newValue == 0);
+    setZeroFrom(newValue);
     setSubtract(0);
     setHalfCarry(0);
 }
 
-void CPU::RLCA() {
-    writeReg8(Reg8::A, RLC(readReg8(Reg8::A)));
+template<Bus BusType>
+void CPU<BusType>::RLCA() {
+    writeReg8<Reg8::A>(RLC(readReg8<Reg8::A>()));
 
     // Set flags
     setZero(0);
@@ -414,25 +677,29 @@ void CPU::RLCA() {
     setHalfCarry(0);
 }
 
-u8 CPU::RR(u8 value) {
+template<Bus BusType>
+u8 CPU<BusType>::RR(u8 value) {
     auto carryValue = getCarry();  // Get current carry flag value
     setCarry(bits::getBitInByte(value, 0));  // Set carry flag to right-most bit
     u8 newValue = std::rotr(value, 1);
     return bits::modifyBitInByte(newValue, 7, carryValue);
 }
 
-void CPU::RR_r8(Reg8 reg) {
-    u8 newValue = RR(readReg8(reg));
-    writeReg8(reg, newValue);
+template<Bus BusType>
+template<Reg8 reg>
+void CPU<BusType>::RR_r8() {
+    u8 newValue = RR(readReg8<reg>());
+    writeReg8<reg>(newValue);
 
     // Set flags
-    setZero(newValue == 0);
+    setZeroFrom(newValue);
     setSubtract(0);
     setHalfCarry(0);
 }
 
-void CPU::RRA() {
-    writeReg8(Reg8::A, RR(readReg8(Reg8::A)));
+template<Bus BusType>
+void CPU<BusType>::RRA() {
+    writeReg8<Reg8::A>(RR(readReg8<Reg8::A>()));
 
     // Set flags
     setZero(0);
@@ -440,23 +707,27 @@ void CPU::RRA() {
     setHalfCarry(0);
 }
 
-u8 CPU::RRC(u8 value) {
+template<Bus BusType>
+u8 CPU<BusType>::RRC(u8 value) {
     setCarry(bits::getBitInByte(value, 0));  // Set carry flag to right-most bit
     return std::rotr(value, 1);
 }
 
-void CPU::RRC_r8(Reg8 reg) {
-    u8 newValue = RRC(readReg8(reg));
-    writeReg8(reg, newValue);
+template<Bus BusType>
+template<Reg8 reg>
+void CPU<BusType>::RRC_r8() {
+    u8 newValue = RRC(readReg8<reg>());
+    writeReg8<reg>(newValue);
 
     // Set flags
-    setZero(newValue == 0);
+    setZeroFrom(newValue);
     setSubtract(0);
     setHalfCarry(0);
 }
 
-void CPU::RRCA() {
-    writeReg8(Reg8::A, RRC(readReg8(Reg8::A)));
+template<Bus BusType>
+void CPU<BusType>::RRCA() {
+    writeReg8<Reg8::A>(RRC(readReg8<Reg8::A>()));
 
     // Set flags
     setZero(0);
@@ -464,98 +735,118 @@ void CPU::RRCA() {
     setHalfCarry(0);
 }
 
-void CPU::SLA(Reg8 reg) {
-    u8 originalValue = readReg8(reg);
+template<Bus BusType>
+template<Reg8 reg>
+void CPU<BusType>::SLA() {
+    u8 originalValue = readReg8<reg>();
     u8 newValue = originalValue << 1;
 
     // Set flags
-    setZero(newValue == 0);
+    setZeroFrom(newValue);
     setSubtract(0);
     setHalfCarry(0);
     setCarry(bits::getBitInByte(originalValue, 7));
 
-    writeReg8(reg, newValue);
+    writeReg8<reg>(newValue);
 }
 
-void CPU::SRA(Reg8 reg) {
-    u8 originalValue = readReg8(reg);
+template<Bus BusType>
+template<Reg8 reg>
+void CPU<BusType>::SRA() {
+    u8 originalValue = readReg8<reg>();
     u8 bit7 = bits::getBitInByte(originalValue, 7);
     u8 newValue = (originalValue >> 1) | (bit7 << 7);
 
     // Set flags
-    setZero(newValue == 0);
+    setZeroFrom(newValue);
     setSubtract(0);
     setHalfCarry(0);
     setCarry(bits::getBitInByte(originalValue, 0));
 
-    writeReg8(reg, newValue);
+    writeReg8<reg>(newValue);
 }
 
-void CPU::SRL(Reg8 reg) {
-    u8 originalValue = readReg8(reg);
+template<Bus BusType>
+template<Reg8 reg>
+void CPU<BusType>::SRL() {
+    u8 originalValue = readReg8<reg>();
     u8 newValue = originalValue >> 1;
 
-    setZero(newValue == 0);
+    setZeroFrom(newValue);
     setSubtract(0);
     setHalfCarry(0);
     setCarry(bits::getBitInByte(originalValue, 0));
 
-    writeReg8(reg, newValue);
+    writeReg8<reg>(newValue);
 }
 
 //
 // Load Instructions
 //
 
-void CPU::LD8(Reg8 reg, u8 value) {
-    writeReg8(reg, value);
+template<Bus BusType>
+template<Reg8 reg>
+void CPU<BusType>::LD8(u8 value) {
+    writeReg8<reg>(value);
 }
 
-void CPU::LD16(Reg16 reg, u16 value) {
-    writeReg16(reg, value);
+template<Bus BusType>
+template<Reg16 reg>
+void CPU<BusType>::LD16(u16 value) {
+    writeReg16<reg>(value);
 }
 
-void CPU::LD_n16_A(u16 address) {
-    m_bus.write(address, readReg8(Reg8::A));
+template<Bus BusType>
+void CPU<BusType>::LD_n16_A(u16 address) {
+    writeMemory(address, readReg8<Reg8::A>());
 }
 
-void CPU::LD_A_n16(u16 address) {
-    writeReg8(Reg8::A, m_bus.read(address));
+template<Bus BusType>
+void CPU<BusType>::LD_A_n16(u16 address) {
+    writeReg8<Reg8::A>(m_bus.read(address));
 }
 
-void CPU::LDH_n16_A(u8 lowByte) {
-    m_bus.write(0xFF00 | lowByte, readReg8(Reg8::A));
+template<Bus BusType>
+void CPU<BusType>::LDH_n16_A(u8 lowByte) {
+    writeMemory(0xFF00 | lowByte, readReg8<Reg8::A>());
 }
 
-void CPU::LDH_C_A() {
-    m_bus.write(0xFF00 | readReg8(Reg8::C), readReg8(Reg8::A));
+template<Bus BusType>
+void CPU<BusType>::LDH_C_A() {
+    writeMemory(0xFF00 | readReg8<Reg8::C>(), readReg8<Reg8::A>());
 }
 
-void CPU::LDH_A_n16(u8 lowByte) {
-    writeReg8(Reg8::A, m_bus.read(0xFF00 | lowByte));
+template<Bus BusType>
+void CPU<BusType>::LDH_A_n16(u8 lowByte) {
+    writeReg8<Reg8::A>(m_bus.read(0xFF00 | lowByte));
 }
 
-void CPU::LDH_A_C() {
-    writeReg8(Reg8::A, m_bus.read(0xFF00 | readReg8(Reg8::C)));
+template<Bus BusType>
+void CPU<BusType>::LDH_A_C() {
+    writeReg8<Reg8::A>(m_bus.read(0xFF00 | readReg8<Reg8::C>()));
 }
 
-void CPU::LD_HLI_A() {
-    m_bus.write(m_hl.full, readReg8(Reg8::A));
+template<Bus BusType>
+void CPU<BusType>::LD_HLI_A() {
+    writeMemory(m_hl.full, readReg8<Reg8::A>());
     m_hl.full++;
 }
 
-void CPU::LD_HLD_A() {
-    m_bus.write(m_hl.full, readReg8(Reg8::A));
+template<Bus BusType>
+void CPU<BusType>::LD_HLD_A() {
+    writeMemory(m_hl.full, readReg8<Reg8::A>());
     m_hl.full--;
 }
 
-void CPU::LD_A_HLI() {
-    writeReg8(Reg8::A, m_bus.read(m_hl.full));
+template<Bus BusType>
+void CPU<BusType>::LD_A_HLI() {
+    writeReg8<Reg8::A>(m_bus.read(m_hl.full));
     m_hl.full++;
 }
 
-void CPU::LD_A_HLD() {
-    writeReg8(Reg8::A, m_bus.read(m_hl.full));
+template<Bus BusType>
+void CPU<BusType>::LD_A_HLD() {
+    writeReg8<Reg8::A>(m_bus.read(m_hl.full));
     m_hl.full--;
 }
 
@@ -563,46 +854,52 @@ void CPU::LD_A_HLD() {
 Jumps and Subroutines
  */
 
-void CPU::CALL(bool condition) {
-    u16 address = bits::concatBytes(m_bus.read(m_pc), m_bus.read(m_pc+1));
-    m_pc += 2;
+template<Bus BusType>
+void CPU<BusType>::CALL(u16 address, bool condition) {
     if (condition) {
         pushToStack(m_pc);
         m_pc = address;
+        m_branchTaken = true;
     }
 }
 
-void CPU::JP(bool condition) {
-    u16 address = bits::concatBytes(m_bus.read(m_pc), m_bus.read(m_pc+1));
-    m_pc += 2;
+template<Bus BusType>
+void CPU<BusType>::JP(u16 address, bool condition) {
     if (condition) {
         m_pc = address;
+        m_branchTaken = true;
     }
 }
 
-void CPU::JP_HL() {
+template<Bus BusType>
+void CPU<BusType>::JP_HL() {
     m_pc = m_hl.full;
 }
 
-void CPU::JR(bool condition) {
-    i8 offset = m_bus.read(m_pc++);
+template<Bus BusType>
+void CPU<BusType>::JR(i8 offset, bool condition) {
     if (condition) {
         m_pc += offset;
+        m_branchTaken = true;
     }
 }
 
-void CPU::RET(bool condition) {
+template<Bus BusType>
+void CPU<BusType>::RET(bool condition) {
     if (condition) {
         m_pc = popStack();
+        m_branchTaken = true;
     }
 }
 
-void CPU::RETI() {
+template<Bus BusType>
+void CPU<BusType>::RETI() {
     m_pc = popStack();
     m_ime = 1;
 }
 
-void CPU::RST(u8 vec) {
+template<Bus BusType>
+void CPU<BusType>::RST(u8 vec) {
     pushToStack(m_pc);
     m_pc = vec;
 }
@@ -611,78 +908,95 @@ void CPU::RST(u8 vec) {
 Stack Operation Instructions
  */
 
-void CPU::ADD_HL_SP() {
+template<Bus BusType>
+void CPU<BusType>::ADD_HL_SP() {
     u16 originalValue = m_hl.full;
-    m_hl.full += m_sp;
+    u32 result = originalValue + m_sp;
+    m_hl.full = result;
 
-    // Set flags
+    // Set flags. Carries out of bits 11 and 15 are shifted down to bits 4 and 8
     setSubtract(0);
-    setHalfCarry(bits::checkHalfCarryAdd(originalValue, m_sp));
-    setCarry((originalValue + m_sp) > 0xFFFF);
+    setHalfCarryFrom((originalValue ^ m_sp ^ result) >> 8);
+    setCarryFrom(result >> 8);
 }
 
-void CPU::ADD_SP_e8(i8 value) {
-    u16 originalValue = m_sp;
+template<Bus BusType>
+void CPU<BusType>::ADD_SP_e8(i8 value) {
+    u8 lowByte = m_sp & 0xFF;
+    u16 lowResult = lowByte + static_cast<u8>(value);
     m_sp += value;
 
-    // Set flags
+    // Set flags. Carries come from unsigned addition of the low byte
     setZero(0);
     setSubtract(0);
-    setHalfCarry(bits::checkHalfCarryAdd(static_cast<u8>(originalValue), value));
-    setCarry(((originalValue & 0xFF) + static_cast<u8>(value)) > 0xFF);
+    setHalfCarryFrom(lowByte ^ static_cast<u8>(value) ^ lowResult);
+    setCarryFrom(lowResult);
 }
 
-void CPU::LD_SP_n16(u16 value) {
+template<Bus BusType>
+void CPU<BusType>::LD_SP_n16(u16 value) {
     m_sp = value;
 }
 
-void CPU::LD_a16_SP(u16 address) {
-    m_bus.write(address, m_sp & 0xFF);
-    m_bus.write(address + 1, (m_sp >> 8) & 0xFF);
+template<Bus BusType>
+void CPU<BusType>::LD_a16_SP(u16 address) {
+    writeMemory(address, m_sp & 0xFF);
+    writeMemory(address + 1, (m_sp >> 8) & 0xFF);
 }
 
-void CPU::LD_HL_SP(i8 value) {
-    u16 result = m_sp + value;
-    m_hl.full = result;
+template<Bus BusType>
+void CPU<BusType>::LD_HL_SP(i8 value) {
+    u8 lowByte = m_sp & 0xFF;
+    u16 lowResult = lowByte + static_cast<u8>(value);
+    m_hl.full = m_sp + value;
 
+    // Set flags. Carries come from unsigned addition of the low byte
     setZero(0);
     setSubtract(0);
-    setHalfCarry(bits::checkHalfCarryAdd(static_cast<u8>(m_sp), value));
-    setCarry(((m_sp & 0xFF) + static_cast<u8>(value)) > 0xFF);
+    setHalfCarryFrom(lowByte ^ static_cast<u8>(value) ^ lowResult);
+    setCarryFrom(lowResult);
 }
 
-void CPU::LD_SP_HL() {
+template<Bus BusType>
+void CPU<BusType>::LD_SP_HL() {
     m_sp = m_hl.full;
 }
 
-void CPU::POP(Reg16 reg) {
-    writeReg16(reg, popStack());
+template<Bus BusType>
+template<Reg16 reg>
+void CPU<BusType>::POP() {
+    writeReg16<reg>(popStack());
 }
 
-void CPU::PUSH(Reg16 reg) {
-    pushToStack(readReg16(reg));
+template<Bus BusType>
+template<Reg16 reg>
+void CPU<BusType>::PUSH() {
+    pushToStack(readReg16<reg>());
 }
 
 /**
 Miscellaneous Instructions
  */
 
-void CPU::CCF() {
+template<Bus BusType>
+void CPU<BusType>::CCF() {
     setSubtract(0);
     setHalfCarry(0);
     setCarry(!getCarry());
 }
 
-void CPU::CPL() {
-    writeReg8(Reg8::A, ~readReg8(Reg8::A));
+template<Bus BusType>
+void CPU<BusType>::CPL() {
+    writeReg8<Reg8::A>(~readReg8<Reg8::A>());
 
     // Set flags
     setSubtract(1);
     setHalfCarry(1);
 }
 
-void CPU::DAA() {
-    u8 accumulator = readReg8(Reg8::A);
+template<Bus BusType>
+void CPU<BusType>::DAA() {
+    u8 accumulator = readReg8<Reg8::A>();
     u8 adjustment {0};
 
     if ((getSubtract() == 0 && (accumulator & 0xF) > 0x9) || getHalfCarry() == 1) {
@@ -697,596 +1011,895 @@ void CPU::DAA() {
     (getSubtract() == 0) ? accumulator += adjustment : accumulator -= adjustment;
 
     // Set flags
-    setZero(accumulator == 0);
+    setZeroFrom(accumulator);
     setHalfCarry(0);
 
-    writeReg8(Reg8::A, accumulator);
+    writeReg8<Reg8::A>(accumulator);
 }
 
-void CPU::DI() {
+template<Bus BusType>
+void CPU<BusType>::DI() {
     m_ime = 0;
+    m_imePending = false;
 }
 
-void CPU::EI() {
-    // TODO: Add delayed setting of IME flag
+template<Bus BusType>
+void CPU<BusType>::EI() {
+    m_imePending = true;
 }
 
-void CPU::HALT() {
-    // TODO: Implement behaviour
+template<Bus BusType>
+void CPU<BusType>::HALT() {
+    // CPU doesn't halt at all if an interrupt is already pending. With IME clear that triggers the
+    // HALT bug, where the next opcode byte gets read twice
+    if (pendingInterrupts() != 0) {
+        if (!m_ime) m_haltBug = true;
+        return;
+    }
+    m_halted = true;
 }
 
-void CPU::NOP() {
+template<Bus BusType>
+void CPU<BusType>::NOP() {
     return;
 }
 
-void CPU::SCF() {
+template<Bus BusType>
+void CPU<BusType>::SCF() {
     setSubtract(0);
     setHalfCarry(0);
     setCarry(1);
 }
 
-void CPU::STOP() {
-    // TODO: implement behaviour
+template<Bus BusType>
+void CPU<BusType>::STOP() {
+    // Only the GBC speed switch is handled. Low power mode isn't emulated, so otherwise this acts like NOP
+    // and the byte after it isn't skipped
+    if (m_stopHandler != nullptr) m_stopHandler(m_stopContext);
 }
 
-void CPU::decode(u8 opcode) {
-    using enum Reg8;
-    using enum Reg16;
 
-    switch (opcode) {
-    case 0x00: NOP(); break;
-    case 0x01: LD16(BC, bits::concatBytes(m_bus.read(m_pc), m_bus.read(m_pc+1))); m_pc+=2; break;
-    case 0x02: LD_n16_A(readReg16(BC)); break;
-    case 0x03: INC16(BC); break;
-    case 0x04: INC8(B); break;
-    case 0x05: DEC8(B); break;
-    case 0x06: LD8(B, m_bus.read(m_pc++)); break;
-    case 0x07: RLCA(); break;
-    case 0x08: LD_a16_SP(bits::concatBytes(m_bus.read(m_pc), m_bus.read(m_pc+1))); m_pc+=2; break;
-    case 0x09: ADD16(BC); break;
-    case 0x0A: LD_A_n16(readReg16(BC)); break;
-    case 0x0B: DEC16(BC); break;
-    case 0x0C: INC8(C); break;
-    case 0x0D: DEC8(C); break;
-    case 0x0E: LD8(C, m_bus.read(m_pc++)); break;
-    case 0x0F: RRCA(); break;
-
-    case 0x10: STOP(); break;
-    case 0x11: LD16(DE, bits::concatBytes(m_bus.read(m_pc), m_bus.read(m_pc+1))); m_pc+=2; break;
-    case 0x12: LD_n16_A(readReg16(DE)); break;
-    case 0x13: INC16(DE); break;
-    case 0x14: INC8(D); break;
-    case 0x15: DEC8(D); break;
-    case 0x16: LD8(D, m_bus.read(m_pc++)); break;
-    case 0x17: RLA(); break;
-    case 0x18: JR(); break;
-    case 0x19: ADD16(DE); break;
-    case 0x1A: LD_A_n16(readReg16(DE)); break;
-    case 0x1B: DEC16(DE); break;
-    case 0x1C: INC8(E); break;
-    case 0x1D: DEC8(E); break;
-    case 0x1E: LD8(E, m_bus.read(m_pc++)); break;
-    case 0x1F: RRA(); break;
-
-    case 0x20: JR(getZero() == 0); break;
-    case 0x21: LD16(HL, bits::concatBytes(m_bus.read(m_pc), m_bus.read(m_pc+1))); m_pc+=2; break;
-    case 0x22: LD_HLI_A(); break;
-    case 0x23: INC16(HL); break;
-    case 0x24: INC8(H); break;
-    case 0x25: DEC8(H); break;
-    case 0x26: LD8(H, m_bus.read(m_pc++)); break;
-    case 0x27: DAA(); break;
-    case 0x28: JR(getZero() == 1); break;
-    case 0x29: ADD16(HL); break;
-    case 0x2A: LD_A_HLI(); break;
-    case 0x2B: DEC16(HL); break;
-    case 0x2C: INC8(L); break;
-    case 0x2D: DEC8(L); break;
-    case 0x2E: LD8(L, m_bus.read(m_pc++)); break;
-    case 0x2F: CPL(); break;
-
-    case 0x30: JR(getCarry() == 0); break;
-    case 0x31: LD_SP_n16(bits::concatBytes(m_bus.read(m_pc), m_bus.read(m_pc+1))); m_pc+=2; break;
-    case 0x32: LD_HLD_A(); break;
-    case 0x33: INC16(SP); break;
-    case 0x34: INC8(HLMem); break;
-    case 0x35: DEC8(HLMem); break;
-    case 0x36: LD8(HLMem, m_bus.read(m_pc++)); break;
-    case 0x37: SCF(); break;
-    case 0x38: JR(getCarry() == 1); break;
-    case 0x39: ADD_HL_SP(); break;
-    case 0x3A: LD_A_HLD(); break;
-    case 0x3B: DEC16(SP); break;
-    case 0x3C: INC8(A); break;
-    case 0x3D: DEC8(A); break;
-    case 0x3E: LD8(A, m_bus.read(m_pc++)); break;
-    case 0x3F: CCF(); break;
-
-    case 0x40: LD8(B, readReg8(B)); break;
-    case 0x41: LD8(B, readReg8(C)); break;
-    case 0x42: LD8(B, readReg8(D)); break;
-    case 0x43: LD8(B, readReg8(E)); break;
-    case 0x44: LD8(B, readReg8(H)); break;
-    case 0x45: LD8(B, readReg8(L)); break;
-    case 0x46: LD8(B, readReg8(HLMem)); break;
-    case 0x47: LD8(B, readReg8(A)); break;
-    case 0x48: LD8(C, readReg8(B)); break;
-    case 0x49: LD8(C, readReg8(C)); break;
-    case 0x4A: LD8(C, readReg8(D)); break;
-    case 0x4B: LD8(C, readReg8(E)); break;
-    case 0x4C: LD8(C, readReg8(H)); break;
-    case 0x4D: LD8(C, readReg8(L)); break;
-    case 0x4E: LD8(C, readReg8(HLMem)); break;
-    case 0x4F: LD8(C, readReg8(A)); break;
-
-    case 0x50: LD8(D, readReg8(B)); break;
-    case 0x51: LD8(D, readReg8(C)); break;
-    case 0x52: LD8(D, readReg8(D)); break;
-    case 0x53: LD8(D, readReg8(E)); break;
-    case 0x54: LD8(D, readReg8(H)); break;
-    case 0x55: LD8(D, readReg8(L)); break;
-    case 0x56: LD8(D, readReg8(HLMem)); break;
-    case 0x57: LD8(D, readReg8(A)); break;
-    case 0x58: LD8(E, readReg8(B)); break;
-    case 0x59: LD8(E, readReg8(C)); break;
-    case 0x5A: LD8(E, readReg8(D)); break;
-    case 0x5B: LD8(E, readReg8(E)); break;
-    case 0x5C: LD8(E, readReg8(H)); break;
-    case 0x5D: LD8(E, readReg8(L)); break;
-    case 0x5E: LD8(E, readReg8(HLMem)); break;
-    case 0x5F: LD8(E, readReg8(A)); break;
-
-    case 0x60: LD8(H, readReg8(B)); break;
-    case 0x61: LD8(H, readReg8(C)); break;
-    case 0x62: LD8(H, readReg8(D)); break;
-    case 0x63: LD8(H, readReg8(E)); break;
-    case 0x64: LD8(H, readReg8(H)); break;
-    case 0x65: LD8(H, readReg8(L)); break;
-    case 0x66: LD8(H, readReg8(HLMem)); break;
-    case 0x67: LD8(H, readReg8(A)); break;
-    case 0x68: LD8(L, readReg8(B)); break;
-    case 0x69: LD8(L, readReg8(C)); break;
-    case 0x6A: LD8(L, readReg8(D)); break;
-    case 0x6B: LD8(L, readReg8(E)); break;
-    case 0x6C: LD8(L, readReg8(H)); break;
-    case 0x6D: LD8(L, readReg8(L)); break;
-    case 0x6E: LD8(L, readReg8(HLMem)); break;
-    case 0x6F: LD8(L, readReg8(A)); break;
-
-    case 0x70: LD8(HLMem, readReg8(B)); break;
-    case 0x71: LD8(HLMem, readReg8(C)); break;
-    case 0x72: LD8(HLMem, readReg8(D)); break;
-    case 0x73: LD8(HLMem, readReg8(E)); break;
-    case 0x74: LD8(HLMem, readReg8(H)); break;
-    case 0x75: LD8(HLMem, readReg8(L)); break;
-    case 0x76: HALT(); break;
-    case 0x77: LD8(HLMem, readReg8(A)); break;
-    case 0x78: LD8(A, readReg8(B)); break;
-    case 0x79: LD8(A, readReg8(C)); break;
-    case 0x7A: LD8(A, readReg8(D)); break;
-    case 0x7B: LD8(A, readReg8(E)); break;
-    case 0x7C: LD8(A, readReg8(H)); break;
-    case 0x7D: LD8(A, readReg8(L)); break;
-    case 0x7E: LD8(A, readReg8(HLMem)); break;
-    case 0x7F: LD8(A, readReg8(A)); break;
-
-    case 0x80: ADD8(readReg8(B)); break;
-    case 0x81: ADD8(readReg8(C)); break;
-    case 0x82: ADD8(readReg8(D)); break;
-    case 0x83: ADD8(readReg8(E)); break;
-    case 0x84: ADD8(readReg8(H)); break;
-    case 0x85: ADD8(readReg8(L)); break;
-    case 0x86: ADD8(readReg8(HLMem)); break;
-    case 0x87: ADD8(readReg8(A)); break;
-    case 0x88: ADC(readReg8(B)); break;
-    case 0x89: ADC(readReg8(C)); break;
-    case 0x8A: ADC(readReg8(D)); break;
-    case 0x8B: ADC(readReg8(E)); break;
-    case 0x8C: ADC(readReg8(H)); break;
-    case 0x8D: ADC(readReg8(L)); break;
-    case 0x8E: ADC(readReg8(HLMem)); break;
-    case 0x8F: ADC(readReg8(A)); break;
-
-    case 0x90: SUB(readReg8(B)); break;
-    case 0x91: SUB(readReg8(C)); break;
-    case 0x92: SUB(readReg8(D)); break;
-    case 0x93: SUB(readReg8(E)); break;
-    case 0x94: SUB(readReg8(H)); break;
-    case 0x95: SUB(readReg8(L)); break;
-    case 0x96: SUB(readReg8(HLMem)); break;
-    case 0x97: SUB(readReg8(A)); break;
-    case 0x98: SBC(readReg8(B)); break;
-    case 0x99: SBC(readReg8(C)); break;
-    case 0x9A: SBC(readReg8(D)); break;
-    case 0x9B: SBC(readReg8(E)); break;
-    case 0x9C: SBC(readReg8(H)); break;
-    case 0x9D: SBC(readReg8(L)); break;
-    case 0x9E: SBC(readReg8(HLMem)); break;
-    case 0x9F: SBC(readReg8(A)); break;
-
-    case 0xA0: AND(readReg8(B)); break;
-    case 0xA1: AND(readReg8(C)); break;
-    case 0xA2: AND(readReg8(D)); break;
-    case 0xA3: AND(readReg8(E)); break;
-    case 0xA4: AND(readReg8(H)); break;
-    case 0xA5: AND(readReg8(L)); break;
-    case 0xA6: AND(readReg8(HLMem)); break;
-    case 0xA7: AND(readReg8(A)); break;
-    case 0xA8: XOR(readReg8(B)); break;
-    case 0xA9: XOR(readReg8(C)); break;
-    case 0xAA: XOR(readReg8(D)); break;
-    case 0xAB: XOR(readReg8(E)); break;
-    case 0xAC: XOR(readReg8(H)); break;
-    case 0xAD: XOR(readReg8(L)); break;
-    case 0xAE: XOR(readReg8(HLMem)); break;
-    case 0xAF: XOR(readReg8(A)); break;
-
-    case 0xB0: OR(readReg8(B)); break;
-    case 0xB1: OR(readReg8(C)); break;
-    case 0xB2: OR(readReg8(D)); break;
-    case 0xB3: OR(readReg8(E)); break;
-    case 0xB4: OR(readReg8(H)); break;
-    case 0xB5: OR(readReg8(L)); break;
-    case 0xB6: OR(readReg8(HLMem)); break;
-    case 0xB7: OR(readReg8(A)); break;
-    case 0xB8: CP(readReg8(B)); break;
-    case 0xB9: CP(readReg8(C)); break;
-    case 0xBA: CP(readReg8(D)); break;
-    case 0xBB: CP(readReg8(E)); break;
-    case 0xBC: CP(readReg8(H)); break;
-    case 0xBD: CP(readReg8(L)); break;
-    case 0xBE: CP(readReg8(HLMem)); break;
-    case 0xBF: CP(readReg8(A)); break;
-
-    case 0xC0: RET(getZero() == 0); break;
-    case 0xC1: POP(BC); break;
-    case 0xC2: JP(getZero() == 0); break;
-    case 0xC3: JP(); break;
-    case 0xC4: CALL(getZero() == 0); break;
-    case 0xC5: PUSH(BC); break;
-    case 0xC6: ADD8(m_bus.read(m_pc++)); break;
-    case 0xC7: RST(0x00); break;
-    case 0xC8: RET(getZero() == 1); break;
-    case 0xC9: RET(); break;
-    case 0xCA: JP(getZero() == 1); break;
-    case 0xCB: decodeCB(m_bus.read(m_pc++)); break;
-    case 0xCC: CALL(getZero() == 1); break;
-    case 0xCD: CALL(); break;
-    case 0xCE: ADC(m_bus.read(m_pc++)); break;
-    case 0xCF: RST(0x08); break;
-
-    case 0xD0: RET(getCarry() == 0); break;
-    case 0xD1: POP(DE); break;
-    case 0xD2: JP(getCarry() == 0); break;
-    case 0xD3: break;
-    case 0xD4: CALL(getCarry() == 0); break;
-    case 0xD5: PUSH(DE); break;
-    case 0xD6: SUB(m_bus.read(m_pc++)); break;
-    case 0xD7: RST(0x10); break;
-    case 0xD8: RET(getCarry() == 1); break;
-    case 0xD9: RETI(); break;
-    case 0xDA: JP(getCarry() == 1); break;
-    case 0xDB: break;
-    case 0xDC: CALL(getCarry() == 1); break;
-    case 0xDD: break;
-    case 0xDE: SBC(m_bus.read(m_pc++)); break;
-    case 0xDF: RST(0x18); break;
-
-    case 0xE0: LDH_n16_A(m_bus.read(m_pc++)); break;
-    case 0xE1: POP(HL); break;
-    case 0xE2: LDH_C_A(); break;
-    case 0xE3: break;
-    case 0xE4: break;
-    case 0xE5: PUSH(HL); break;
-    case 0xE6: AND(m_bus.read(m_pc++)); break;
-    case 0xE7: RST(0x20); break;
-    case 0xE8: ADD_SP_e8(m_bus.read(m_pc++)); break;
-    case 0xE9: JP_HL(); break;
-    case 0xEA: LD_n16_A(bits::concatBytes(m_bus.read(m_pc), m_bus.read(m_pc+1))); m_pc+=2; break;
-    case 0xEB: break;
-    case 0xEC: break;
-    case 0xED: break;
-    case 0xEE: XOR(m_bus.read(m_pc++)); break;
-    case 0xEF: RST(0x28); break;
-
-    case 0xF0: LDH_A_n16(m_bus.read(m_pc++)); break;
-    case 0xF1: POP(AF); break;
-    case 0xF2: LDH_A_C(); break;
-    case 0xF3: DI(); break;
-    case 0xF4: break;
-    case 0xF5: PUSH(AF); break;
-    case 0xF6: OR(m_bus.read(m_pc++)); break;
-    case 0xF7: RST(0x30); break;
-    case 0xF8: LD_HL_SP(m_bus.read(m_pc++)); break;
-    case 0xF9: LD_SP_HL(); break;
-    case 0xFA: LD_A_n16(bits::concatBytes(m_bus.read(m_pc), m_bus.read(m_pc+1))); m_pc+=2; break;
-    case 0xFB: EI(); break;
-    case 0xFC: break;
-    case 0xFD: break;
-    case 0xFE: CP(m_bus.read(m_pc++)); break;
-    case 0xFF: RST(0x38); break;
-
-    default: std::unreachable();
+/**
+Dispatching
+
+Opcodes are split into x/y/z/p/q fields as described in
+https://gb-archive.github.io/salvage/decoding_gbz80_opcodes/Decoding%20Gamboy%20Z80%20opcodes.htm
+Every field is known at compile time so each table entry is a dedicated handler with no
+operand decoding left to do at runtime.
+ */
+
+namespace {
+    namespace opfield {
+        constexpr u8 x(u8 opcode) { return opcode >> 6; }
+        constexpr u8 y(u8 opcode) { return (opcode >> 3) & 0b111; }
+        constexpr u8 z(u8 opcode) { return opcode & 0b111; }
+        constexpr u8 p(u8 opcode) { return (opcode >> 4) & 0b11; }
+        constexpr u8 q(u8 opcode) { return (opcode >> 3) & 0b1; }
+    }
+
+    // 8-bit register selected by a 3-bit opcode field
+    constexpr std::array<Reg8, 8> R8_TABLE {
+        Reg8::B, Reg8::C, Reg8::D, Reg8::E, Reg8::H, Reg8::L, Reg8::HLMem, Reg8::A
+    };
+
+    // 16-bit register selected by a 2-bit opcode field. Used by loads and arithmetic
+    constexpr std::array<Reg16, 4> RP_TABLE {
+        Reg16::BC, Reg16::DE, Reg16::HL, Reg16::SP
+    };
+
+    // 16-bit register selected by a 2-bit opcode field. Used by PUSH and POP
+    constexpr std::array<Reg16, 4> RP2_TABLE {
+        Reg16::BC, Reg16::DE, Reg16::HL, Reg16::AF
+    };
+}
+
+template<Bus BusType>
+template<u8 operation>
+void CPU<BusType>::alu(u8 value) {
+    if constexpr (operation == 0) ADD8(value);
+    else if constexpr (operation == 1) ADC(value);
+    else if constexpr (operation == 2) SUB(value);
+    else if constexpr (operation == 3) SBC(value);
+    else if constexpr (operation == 4) AND(value);
+    else if constexpr (operation == 5) XOR(value);
+    else if constexpr (operation == 6) OR(value);
+    else if constexpr (operation == 7) CP(value);
+}
+
+template<Bus BusType>
+template<u8 operation, Reg8 reg>
+void CPU<BusType>::rotate() {
+    if constexpr (operation == 0) RLC_r8<reg>();
+    else if constexpr (operation == 1) RRC_r8<reg>();
+    else if constexpr (operation == 2) RL_r8<reg>();
+    else if constexpr (operation == 3) RR_r8<reg>();
+    else if constexpr (operation == 4) SLA<reg>();
+    else if constexpr (operation == 5) SRA<reg>();
+    else if constexpr (operation == 6) SWAP<reg>();
+    else if constexpr (operation == 7) SRL<reg>();
+}
+
+template<Bus BusType>
+template<u8 condition>
+bool CPU<BusType>::checkCondition() const {
+    if constexpr (condition == 0) return getZero() == 0;
+    else if constexpr (condition == 1) return getZero() == 1;
+    else if constexpr (condition == 2) return getCarry() == 0;
+    else if constexpr (condition == 3) return getCarry() == 1;
+}
+
+template<Bus BusType>
+template<u8 opcode>
+void CPU<BusType>::execute(CPU& cpu, [[maybe_unused]] u16 operand) {
+    constexpr u8 x {opfield::x(opcode)};
+    constexpr u8 y {opfield::y(opcode)};
+    constexpr u8 z {opfield::z(opcode)};
+    constexpr u8 p {opfield::p(opcode)};
+    constexpr u8 q {opfield::q(opcode)};
+
+    constexpr Reg8 dst {R8_TABLE[y]};
+    constexpr Reg8 src {R8_TABLE[z]};
+    constexpr Reg16 rp {RP_TABLE[p]};
+    constexpr Reg16 rp2 {RP2_TABLE[p]};
+
+    if constexpr (opcode == 0x76) {
+        cpu.HALT();
+    } else if constexpr (x == 1) {
+        cpu.LD8<dst>(cpu.readReg8<src>());
+    } else if constexpr (x == 2) {
+        cpu.alu<y>(cpu.readReg8<src>());
+    } else if constexpr (x == 0) {
+        if constexpr (z == 0) {
+            if constexpr (y == 0) cpu.NOP();
+            else if constexpr (y == 1) cpu.LD_a16_SP(operand);
+            else if constexpr (y == 2) cpu.STOP();
+            else if constexpr (y == 3) cpu.JR(operand);
+            else cpu.JR(operand, cpu.checkCondition<y - 4>());
+        } else if constexpr (z == 1) {
+            if constexpr (q == 0 && rp == Reg16::SP) cpu.LD_SP_n16(operand);
+            else if constexpr (q == 0) cpu.LD16<rp>(operand);
+            else if constexpr (rp == Reg16::SP) cpu.ADD_HL_SP();
+            else cpu.ADD16<rp>();
+        } else if constexpr (z == 2) {
+            if constexpr (q == 0 && p <= 1) cpu.LD_n16_A(cpu.readReg16<rp>());
+            else if constexpr (q == 0 && p == 2) cpu.LD_HLI_A();
+            else if constexpr (q == 0 && p == 3) cpu.LD_HLD_A();
+            else if constexpr (p <= 1) cpu.LD_A_n16(cpu.readReg16<rp>());
+            else if constexpr (p == 2) cpu.LD_A_HLI();
+            else cpu.LD_A_HLD();
+        } else if constexpr (z == 3) {
+            if constexpr (q == 0) cpu.INC16<rp>();
+            else cpu.DEC16<rp>();
+        } else if constexpr (z == 4) {
+            cpu.INC8<dst>();
+        } else if constexpr (z == 5) {
+            cpu.DEC8<dst>();
+        } else if constexpr (z == 6) {
+            cpu.LD8<dst>(static_cast<u8>(operand));
+        } else {
+            if constexpr (y == 0) cpu.RLCA();
+            else if constexpr (y == 1) cpu.RRCA();
+            else if constexpr (y == 2) cpu.RLA();
+            else if constexpr (y == 3) cpu.RRA();
+            else if constexpr (y == 4) cpu.DAA();
+            else if constexpr (y == 5) cpu.CPL();
+            else if constexpr (y == 6) cpu.SCF();
+            else cpu.CCF();
+        }
+    } else {
+        if constexpr (z == 0) {
+            if constexpr (y <= 3) cpu.RET(cpu.checkCondition<y>());
+            else if constexpr (y == 4) cpu.LDH_n16_A(static_cast<u8>(operand));
+            else if constexpr (y == 5) cpu.ADD_SP_e8(static_cast<u8>(operand));
+            else if constexpr (y == 6) cpu.LDH_A_n16(static_cast<u8>(operand));
+            else cpu.LD_HL_SP(static_cast<u8>(operand));
+        } else if constexpr (z == 1) {
+            if constexpr (q == 0) cpu.POP<rp2>();
+            else if constexpr (p == 0) cpu.RET();
+            else if constexpr (p == 1) cpu.RETI();
+            else if constexpr (p == 2) cpu.JP_HL();
+            else cpu.LD_SP_HL();
+        } else if constexpr (z == 2) {
+            if constexpr (y <= 3) cpu.JP(operand, cpu.checkCondition<y>());
+            else if constexpr (y == 4) cpu.LDH_C_A();
+            else if constexpr (y == 5) cpu.LD_n16_A(operand);
+            else if constexpr (y == 6) cpu.LDH_A_C();
+            else cpu.LD_A_n16(operand);
+        } else if constexpr (z == 3) {
+            if constexpr (y == 0) cpu.JP(operand);
+            else if constexpr (y == 1) s_handlersCB[operand & 0xFF](cpu, 0);
+            else if constexpr (y == 6) cpu.DI();
+            else if constexpr (y == 7) cpu.EI();
+            // Remaining opcodes are illegal and do nothing
+        } else if constexpr (z == 4) {
+            if constexpr (y <= 3) cpu.CALL(operand, cpu.checkCondition<y>());
+            // Remaining opcodes are illegal and do nothing
+        } else if constexpr (z == 5) {
+            if constexpr (q == 0) cpu.PUSH<rp2>();
+            else if constexpr (p == 0) cpu.CALL(operand);
+            // Remaining opcodes are illegal and do nothing
+        } else if constexpr (z == 6) {
+            cpu.alu<y>(static_cast<u8>(operand));
+        } else {
+            cpu.RST(y * 8);
+        }
     }
 }
 
-void CPU::decodeCB(u8 opcode) {
-    using enum Reg8;
-    using enum Reg16;
+template<Bus BusType>
+template<u8 opcode>
+void CPU<BusType>::executeCB(CPU& cpu, [[maybe_unused]] u16 operand) {
+    constexpr u8 x {opfield::x(opcode)};
+    constexpr u8 y {opfield::y(opcode)};
+    constexpr Reg8 reg {R8_TABLE[opfield::z(opcode)]};
+
+    if constexpr (x == 0) cpu.rotate<y, reg>();
+    else if constexpr (x == 1) cpu.BIT<reg, y>();
+    else if constexpr (x == 2) cpu.RES<reg, y>();
+    else cpu.SET<reg, y>();
+}
 
-    switch (opcode) {
-    case 0x00: RLC_r8(B); break;
-    case 0x01: RLC_r8(C); break;
-    case 0x02: RLC_r8(D); break;
-    case 0x03: RLC_r8(E); break;
-    case 0x04: RLC_r8(H); break;
-    case 0x05: RLC_r8(L); break;
-    case 0x06: RLC_r8(HLMem); break;
-    case 0x07: RLC_r8(A); break;
-    case 0x08: RRC_r8(B); break;
-    case 0x09: RRC_r8(C); break;
-    case 0x0A: RRC_r8(D); break;
-    case 0x0B: RRC_r8(E); break;
-    case 0x0C: RRC_r8(H); break;
-    case 0x0D: RRC_r8(L); break;
-    case 0x0E: RRC_r8(HLMem); break;
-    case 0x0F: RRC_r8(A); break;
-
-    case 0x10: RL_r8(B); break;
-    case 0x11: RL_r8(C); break;
-    case 0x12: RL_r8(D); break;
-    case 0x13: RL_r8(E); break;
-    case 0x14: RL_r8(H); break;
-    case 0x15: RL_r8(L); break;
-    case 0x16: RL_r8(HLMem); break;
-    case 0x17: RL_r8(A); break;
-    case 0x18: RR_r8(B); break;
-    case 0x19: RR_r8(C); break;
-    case 0x1A: RR_r8(D); break;
-    case 0x1B: RR_r8(E); break;
-    case 0x1C: RR_r8(H); break;
-    case 0x1D: RR_r8(L); break;
-    case 0x1E: RR_r8(HLMem); break;
-    case 0x1F: RR_r8(A); break;
-
-    case 0x20: SLA(B); break;
-    case 0x21: SLA(C); break;
-    case 0x22: SLA(D); break;
-    case 0x23: SLA(E); break;
-    case 0x24: SLA(H); break;
-    case 0x25: SLA(L); break;
-    case 0x26: SLA(HLMem); break;
-    case 0x27: SLA(A); break;
-    case 0x28: SRA(B); break;
-    case 0x29: SRA(C); break;
-    case 0x2A: SRA(D); break;
-    case 0x2B: SRA(E); break;
-    case 0x2C: SRA(H); break;
-    case 0x2D: SRA(L); break;
-    case 0x2E: SRA(HLMem); break;
-    case 0x2F: SRA(A); break;
-
-    case 0x30: SWAP(B); break;
-    case 0x31: SWAP(C); break;
-    case 0x32: SWAP(D); break;
-    case 0x33: SWAP(E); break;
-    case 0x34: SWAP(H); break;
-    case 0x35: SWAP(L); break;
-    case 0x36: SWAP(HLMem); break;
-    case 0x37: SWAP(A); break;
-    case 0x38: SRL(B); break;
-    case 0x39: SRL(C); break;
-    case 0x3A: SRL(D); break;
-    case 0x3B: SRL(E); break;
-    case 0x3C: SRL(H); break;
-    case 0x3D: SRL(L); break;
-    case 0x3E: SRL(HLMem); break;
-    case 0x3F: SRL(A); break;
-
-    case 0x40: BIT(B, 0); break;
-    case 0x41: BIT(C, 0); break;
-    case 0x42: BIT(D, 0); break;
-    case 0x43: BIT(E, 0); break;
-    case 0x44: BIT(H, 0); break;
-    case 0x45: BIT(L, 0); break;
-    case 0x46: BIT(HLMem, 0); break;
-    case 0x47: BIT(A, 0); break;
-    case 0x48: BIT(B, 1); break;
-    case 0x49: BIT(C, 1); break;
-    case 0x4A: BIT(D, 1); break;
-    case 0x4B: BIT(E, 1); break;
-    case 0x4C: BIT(H, 1); break;
-    case 0x4D: BIT(L, 1); break;
-    case 0x4E: BIT(HLMem, 1); break;
-    case 0x4F: BIT(A, 1); break;
-
-    case 0x50: BIT(B, 2); break;
-    case 0x51: BIT(C, 2); break;
-    case 0x52: BIT(D, 2); break;
-    case 0x53: BIT(E, 2); break;
-    case 0x54: BIT(H, 2); break;
-    case 0x55: BIT(L, 2); break;
-    case 0x56: BIT(HLMem, 2); break;
-    case 0x57: BIT(A, 2); break;
-    case 0x58: BIT(B, 3); break;
-    case 0x59: BIT(C, 3); break;
-    case 0x5A: BIT(D, 3); break;
-    case 0x5B: BIT(E, 3); break;
-    case 0x5C: BIT(H, 3); break;
-    case 0x5D: BIT(L, 3); break;
-    case 0x5E: BIT(HLMem, 3); break;
-    case 0x5F: BIT(A, 3); break;
-
-    case 0x60: BIT(B, 4); break;
-    case 0x61: BIT(C, 4); break;
-    case 0x62: BIT(D, 4); break;
-    case 0x63: BIT(E, 4); break;
-    case 0x64: BIT(H, 4); break;
-    case 0x65: BIT(L, 4); break;
-    case 0x66: BIT(HLMem, 4); break;
-    case 0x67: BIT(A, 4); break;
-    case 0x68: BIT(B, 5); break;
-    case 0x69: BIT(C, 5); break;
-    case 0x6A: BIT(D, 5); break;
-    case 0x6B: BIT(E, 5); break;
-    case 0x6C: BIT(H, 5); break;
-    case 0x6D: BIT(L, 5); break;
-    case 0x6E: BIT(HLMem, 5); break;
-    case 0x6F: BIT(A, 5); break;
-
-    case 0x70: BIT(B, 6); break;
-    case 0x71: BIT(C, 6); break;
-    case 0x72: BIT(D, 6); break;
-    case 0x73: BIT(E, 6); break;
-    case 0x74: BIT(H, 6); break;
-    case 0x75: BIT(L, 6); break;
-    case 0x76: BIT(HLMem, 6); break;
-    case 0x77: BIT(A, 6); break;
-    case 0x78: BIT(B, 7); break;
-    case 0x79: BIT(C, 7); break;
-    case 0x7A: BIT(D, 7); break;
-    case 0x7B: BIT(E, 7); break;
-    case 0x7C: BIT(H, 7); break;
-    case 0x7D: BIT(L, 7); break;
-    case 0x7E: BIT(HLMem, 7); break;
-    case 0x7F: BIT(A, 7); break;
-
-    case 0x80: RES(B, 0); break;
-    case 0x81: RES(C, 0); break;
-    case 0x82: RES(D, 0); break;
-    case 0x83: RES(E, 0); break;
-    case 0x84: RES(H, 0); break;
-    case 0x85: RES(L, 0); break;
-    case 0x86: RES(HLMem, 0); break;
-    case 0x87: RES(A, 0); break;
-    case 0x88: RES(B, 1); break;
-    case 0x89: RES(C, 1); break;
-    case 0x8A: RES(D, 1); break;
-    case 0x8B: RES(E, 1); break;
-    case 0x8C: RES(H, 1); break;
-    case 0x8D: RES(L, 1); break;
-    case 0x8E: RES(HLMem, 1); break;
-    case 0x8F: RES(A, 1); break;
-
-    case 0x90: RES(B, 2); break;
-    case 0x91: RES(C, 2); break;
-    case 0x92: RES(D, 2); break;
-    case 0x93: RES(E, 2); break;
-    case 0x94: RES(H, 2); break;
-    case 0x95: RES(L, 2); break;
-    case 0x96: RES(HLMem, 2); break;
-    case 0x97: RES(A, 2); break;
-    case 0x98: RES(B, 3); break;
-    case 0x99: RES(C, 3); break;
-    case 0x9A: RES(D, 3); break;
-    case 0x9B: RES(E, 3); break;
-    case 0x9C: RES(H, 3); break;
-    case 0x9D: RES(L, 3); break;
-    case 0x9E: RES(HLMem, 3); break;
-    case 0x9F: RES(A, 3); break;
-
-    case 0xA0: RES(B, 4); break;
-    case 0xA1: RES(C, 4); break;
-    case 0xA2: RES(D, 4); break;
-    case 0xA3: RES(E, 4); break;
-    case 0xA4: RES(H, 4); break;
-    case 0xA5: RES(L, 4); break;
-    case 0xA6: RES(HLMem, 4); break;
-    case 0xA7: RES(A, 4); break;
-    case 0xA8: RES(B, 5); break;
-    case 0xA9: RES(C, 5); break;
-    case 0xAA: RES(D, 5); break;
-    case 0xAB: RES(E, 5); break;
-    case 0xAC: RES(H, 5); break;
-    case 0xAD: RES(L, 5); break;
-    case 0xAE: RES(HLMem, 5); break;
-    case 0xAF: RES(A, 5); break;
-
-    case 0xB0: RES(B, 6); break;
-    case 0xB1: RES(C, 6); break;
-    case 0xB2: RES(D, 6); break;
-    case 0xB3: RES(E, 6); break;
-    case 0xB4: RES(H, 6); break;
-    case 0xB5: RES(L, 6); break;
-    case 0xB6: RES(HLMem, 6); break;
-    case 0xB7: RES(A, 6); break;
-    case 0xB8: RES(B, 7); break;
-    case 0xB9: RES(C, 7); break;
-    case 0xBA: RES(D, 7); break;
-    case 0xBB: RES(E, 7); break;
-    case 0xBC: RES(H, 7); break;
-    case 0xBD: RES(L, 7); break;
-    case 0xBE: RES(HLMem, 7); break;
-    case 0xBF: RES(A, 7); break;
-
-    case 0xC0: SET(B, 0); break;
-    case 0xC1: SET(C, 0); break;
-    case 0xC2: SET(D, 0); break;
-    case 0xC3: SET(E, 0); break;
-    case 0xC4: SET(H, 0); break;
-    case 0xC5: SET(L, 0); break;
-    case 0xC6: SET(HLMem, 0); break;
-    case 0xC7: SET(A, 0); break;
-    case 0xC8: SET(B, 1); break;
-    case 0xC9: SET(C, 1); break;
-    case 0xCA: SET(D, 1); break;
-    case 0xCB: SET(E, 1); break;
-    case 0xCC: SET(H, 1); break;
-    case 0xCD: SET(L, 1); break;
-    case 0xCE: SET(HLMem, 1); break;
-    case 0xCF: SET(A, 1); break;
-
-    case 0xD0: SET(B, 2); break;
-    case 0xD1: SET(C, 2); break;
-    case 0xD2: SET(D, 2); break;
-    case 0xD3: SET(E, 2); break;
-    case 0xD4: SET(H, 2); break;
-    case 0xD5: SET(L, 2); break;
-    case 0xD6: SET(HLMem, 2); break;
-    case 0xD7: SET(A, 2); break;
-    case 0xD8: SET(B, 3); break;
-    case 0xD9: SET(C, 3); break;
-    case 0xDA: SET(D, 3); break;
-    case 0xDB: SET(E, 3); break;
-    case 0xDC: SET(H, 3); break;
-    case 0xDD: SET(L, 3); break;
-    case 0xDE: SET(HLMem, 3); break;
-    case 0xDF: SET(A, 3); break;
-
-    case 0xE0: SET(B, 4); break;
-    case 0xE1: SET(C, 4); break;
-    case 0xE2: SET(D, 4); break;
-    case 0xE3: SET(E, 4); break;
-    case 0xE4: SET(H, 4); break;
-    case 0xE5: SET(L, 4); break;
-    case 0xE6: SET(HLMem, 4); break;
-    case 0xE7: SET(A, 4); break;
-    case 0xE8: SET(B, 5); break;
-    case 0xE9: SET(C, 5); break;
-    case 0xEA: SET(D, 5); break;
-    case 0xEB: SET(E, 5); break;
-    case 0xEC: SET(H, 5); break;
-    case 0xED: SET(L, 5); break;
-    case 0xEE: SET(HLMem, 5); break;
-    case 0xEF: SET(A, 5); break;
-
-    case 0xF0: SET(B, 6); break;
-    case 0xF1: SET(C, 6); break;
-    case 0xF2: SET(D, 6); break;
-    case 0xF3: SET(E, 6); break;
-    case 0xF4: SET(H, 6); break;
-    case 0xF5: SET(L, 6); break;
-    case 0xF6: SET(HLMem, 6); break;
-    case 0xF7: SET(A, 6); break;
-    case 0xF8: SET(B, 7); break;
-    case 0xF9: SET(C, 7); break;
-    case 0xFA: SET(D, 7); break;
-    case 0xFB: SET(E, 7); break;
-    case 0xFC: SET(H, 7); break;
-    case 0xFD: SET(L, 7); break;
-    case 0xFE: SET(HLMem, 7); break;
-    case 0xFF: SET(A, 7); break;
-
-    default: std::unreachable();
+template<Bus BusType>
+template<u8 opcode>
+u8 CPU<BusType>::fetchAndExecute(CPU& cpu) {
+    const u16 operand {cpu.fetchOperands<opcodes::length(opcode)>()};
+
+    if constexpr (opcodes::BRANCH_CYCLES[opcode] != 0) {
+        cpu.m_branchTaken = false;
+        execute<opcode>(cpu, operand);
+        return opcodes::cycles(opcode, operand, cpu.m_branchTaken);
+    } else {
+        execute<opcode>(cpu, operand);
+        return opcodes::cycles(opcode, operand, false);
+    }
+}
+
+template<Bus BusType>
+template<usize... opcodes>
+constexpr std::array<typename CPU<BusType>::FetchingHandler, 256> CPU<BusType>::makeFetchingHandlerTable(std::index_sequence<opcodes...>) {
+    return {&CPU::fetchAndExecute<static_cast<u8>(opcodes)>...};
+}
+
+template<Bus BusType>
+template<usize... opcodes>
+constexpr std::array<typename CPU<BusType>::Handler, 256> CPU<BusType>::makeHandlerTable(std::index_sequence<opcodes...>) {
+    return {&CPU::execute<static_cast<u8>(opcodes)>...};
+}
+
+template<Bus BusType>
+template<usize... opcodes>
+constexpr std::array<typename CPU<BusType>::Handler, 256> CPU<BusType>::makeHandlerTableCB(std::index_sequence<opcodes...>) {
+    return {&CPU::executeCB<static_cast<u8>(opcodes)>...};
+}
+
+template<Bus BusType>
+constinit const std::array<typename CPU<BusType>::Handler, 256> CPU<BusType>::s_handlers {makeHandlerTable(std::make_index_sequence<256>{})};
+
+template<Bus BusType>
+constinit const std::array<typename CPU<BusType>::Handler, 256> CPU<BusType>::s_handlersCB {makeHandlerTableCB(std::make_index_sequence<256>{})};
+
+template<Bus BusType>
+constinit const std::array<typename CPU<BusType>::FetchingHandler, 256> CPU<BusType>::s_fetchingHandlers {makeFetchingHandlerTable(std::make_index_sequence<256>{})};
+
+/**
+Interrupts
+ */
+
+template<Bus BusType>
+u8 CPU<BusType>::pendingInterrupts() {
+    return m_bus.read(IE_ADDRESS) & m_bus.read(IF_ADDRESS) & 0x1F;
+}
+
+template<Bus BusType>
+u8 CPU<BusType>::handleInterrupts() {
+    const u8 pending {pendingInterrupts()};
+    if (pending == 0) return 0;
+
+    // Any pending interrupt wakes the CPU, even when IME is clear
+    m_halted = false;
+    if (!m_ime) return 0;
+
+    // Lowest bit has the highest priority. Handlers start at $40 and are 8 bytes apart
+    const u8 interrupt {static_cast<u8>(std::countr_zero(pending))};
+    m_ime = 0;
+    writeMemory(IF_ADDRESS, bits::modifyBitInByte(m_bus.read(IF_ADDRESS), interrupt, 0));
+    pushToStack(m_pc);
+    m_pc = 0x40 + interrupt * 8;
+
+    return 5;
+}
+
+/**
+Block Caching
+ */
+
+namespace {
+    // Checks if block is a loop which only polls memory, e.g. waiting for LY to reach a line or for an
+    // interrupt handler to set a flag. Running it again can't change anything until memory does
+    bool isIdleLoop(const Block& block) {
+        const DecodedInstruction& last {block.instructions.back()};
+
+        u16 target {};
+        switch (last.opcode) {
+        case 0x18: case 0x20: case 0x28: case 0x30: case 0x38: // JR
+            target = block.end + static_cast<i8>(last.operand);
+            break;
+        case 0xC2: case 0xC3: case 0xCA: case 0xD2: case 0xDA: // JP
+            target = last.operand;
+            break;
+        default:
+            return false;
+        }
+        if (target != block.start) return false;
+
+        // Body may only load A from memory and test it. A has to be loaded before it's used so
+        // nothing carries over between iterations. DIV and TIMA count on their own so polling them isn't idle.
+        // Reads through register pairs are left out as they could point at either
+        bool loadedA {false};
+        for (usize i {0}; i + 1 < block.instructions.size(); i++) {
+            const DecodedInstruction& instruction {block.instructions[i]};
+            const u8 opcode {instruction.opcode};
+
+            switch (opcode) {
+            case 0xF0: // LDH A, (a8)
+            case 0xFA: // LD A, (a16)
+            {
+                const u16 address = opcode == 0xF0 ? 0xFF00 + instruction.operand : instruction.operand;
+                if (address == 0xFF04 || address == 0xFF05) return false;
+                loadedA = true;
+                break;
+            }
+            case 0xE6: case 0xEE: case 0xF6: case 0xFE: // AND/XOR/OR/CP n
+                if (!loadedA) return false;
+                break;
+            case 0xCB: // BIT b, r
+                if ((instruction.operand & 0xC0) != 0x40 || (instruction.operand & 0b111) == 6) return false;
+                if ((instruction.operand & 0b111) == 7 && !loadedA) return false;
+                break;
+            default:
+                // AND/XOR/OR/CP r
+                if (opcode >= 0xA0 && opcode <= 0xBF && (opcode & 0b111) != 6 && loadedA) break;
+                return false;
+            }
+        }
+
+        return true;
+    }
+}
+
+template<Bus BusType>
+bool CPU<BusType>::isCacheable(u16 address) {
+    if (address <= 0x7FFF) return true;                      // ROM
+    if (address >= 0xA000 && address <= 0xFDFF) return true; // External RAM, WRAM, Echo RAM
+    if (address >= 0xFF80 && address <= 0xFFFE) return true; // HRAM
+    return false;
+}
+
+template<Bus BusType>
+Block CPU<BusType>::decodeBlock(u16 address) {
+    static constexpr u16 REGION_SIZE {0x1000};  // Smallest bank size. Blocks never span two regions
+
+    Block block {.start = address};
+    u16 pc {address};
+
+    while (block.instructions.size() < BlockCache::MAX_BLOCK_LENGTH) {
+        const u8 opcode {m_bus.read(pc)};
+        const u8 length {opcodes::length(opcode)};
+
+        // Stop if the instruction runs into a different region as it could be banked separately
+        const u16 last = pc + length - 1;
+        if (last < pc || last / REGION_SIZE != address / REGION_SIZE) break;
+
+        u16 operand {0};
+        if (length == 2) operand = m_bus.read(pc + 1);
+        if (length == 3) operand = bits::concatBytes(m_bus.read(pc + 1), m_bus.read(pc + 2));
+
+        block.instructions.push_back({.opcode = opcode, .length = length, .operand = operand, .offset = static_cast<u16>(block.cycles)});
+        block.cycles += opcodes::cycles(opcode, operand, false);
+        block.branchCycles = opcodes::BRANCH_CYCLES[opcode];
+        pc += length;
+
+        if (opcodes::endsBlock(opcode) || !isCacheable(pc)) break;
     }
+
+    block.end = pc;
+    if (!block.instructions.empty()) block.idleLoop = isIdleLoop(block);
+    return block;
 }
+
+template<Bus BusType>
+Block* CPU<BusType>::lookupBlock() {
+    if (!isCacheable(m_pc)) return nullptr;
+
+    const u16 bank {m_bus.codeBank(m_pc)};
+
+    Block* block {m_blockCache.find(m_pc, bank)};
+    if (block != nullptr) return block;
+
+    Block decoded {decodeBlock(m_pc)};
+    if (decoded.instructions.empty()) return nullptr;  // First instruction straddles a region boundary
+
+    return &m_blockCache.insert(bank, std::move(decoded));
+}
+
+template<Bus BusType>
+u32 CPU<BusType>::executeBlock(const Block& block) {
+    // Only the last instruction of a block can branch
+    m_branchTaken = false;
+    m_mapperWritten = false;
+
+    for (const auto& instruction : block.instructions) {
+        m_pc += instruction.length;
+        m_blockCycles = instruction.offset;
+        s_handlers[instruction.opcode](*this, instruction.operand);
+
+        // Stop if the block overwrote its own code or switched banks so the rest of it may be stale,
+        // or if an I/O handler scheduled an event before the end of the block
+        if (!block.valid || m_mapperWritten || m_endRun) [[unlikely]] {
+            const u8 branchCycles {m_branchTaken ? block.branchCycles : u8 {0}};
+            return instruction.offset + opcodes::cycles(instruction.opcode, instruction.operand, false) + branchCycles;
+        }
+    }
+
+    return block.cycles + (m_branchTaken ? block.branchCycles : 0);
+}
+
+template<Bus BusType>
+u32 CPU<BusType>::runBlock() {
+    m_endRun = false;  // Only applies to run()
+    if (m_imePending || m_halted || m_haltBug || m_stallCycles != 0) return step();
+
+    const Block* block {lookupBlock()};
+    if (block == nullptr) return step();
+
+    return executeBlock(*block);
+}
+
+#ifdef GBBUDDY_JIT
+
+/**
+JIT
+
+Hot blocks get translated into x86-64 code. Register loads, 16-bit increments and, with lazy flags,
+register ALU operations are done inline. Everything else calls the same handlers the interpreter
+uses so the interpreter stays the reference.
+PC is only written back before handler calls and when leaving a block. Handler calls also store the
+instruction's cycle offset in the block so I/O handlers see the current time.
+
+Registers used by translated code:
+  RBX - CPU
+  R12 - Set before an instruction which may touch I/O or mapper registers through a register pair
+  R13 - Address of the block's valid flag, cleared when the block overwrites its own code
+
+Interrupts are only checked between blocks, which is fine as blocks end at DI/EI/RETI/HALT.
+ */
+
+namespace {
+    // Checks if accessing address could have effects beyond plain memory, i.e. I/O and mapper registers
+    constexpr bool hasSideEffects(u16 address, bool write) {
+        if (write && address <= 0x7FFF) return true;
+        return address >= 0xFF00 && (address <= 0xFF7F || address == 0xFFFF);
+    }
+
+    constexpr u64 packResult(u32 instructions, u32 cycles) {
+        return (static_cast<u64>(instructions) << 32) | cycles;
+    }
+}
+
+template<Bus BusType>
+struct CPU<BusType>::JitShadow {
+    MockBus bus {};
+    CPU<MockBus> cpu {bus};
+};
+
+template<Bus BusType>
+void CPU<BusType>::compileBlock(Block& block) {
+    if (!m_codeBuffer) m_codeBuffer = std::make_unique<CodeBuffer>(CODE_BUFFER_SIZE);
+
+    const auto field = [this](const void* member) {
+        return X64Mem{X64Reg::RBX, static_cast<i32>(static_cast<const u8*>(member) - reinterpret_cast<const u8*>(this))};
+    };
+
+    const X64Mem pc {field(&m_pc)};
+    const X64Mem branchTaken {field(&m_branchTaken)};
+    const X64Mem blockCycles {field(&m_blockCycles)};
+    const X64Mem valid {X64Reg::R13, 0};
+
+    // Indexed the same as R8_TABLE/RP_TABLE. (HL) never gets accessed inline
+    const std::array<X64Mem, 8> r8 {
+        field(&m_bc.hi), field(&m_bc.lo), field(&m_de.hi), field(&m_de.lo),
+        field(&m_hl.hi), field(&m_hl.lo), X64Mem{}, field(&m_af.hi)
+    };
+    const std::array<X64Mem, 4> rp {field(&m_bc.full), field(&m_de.full), field(&m_hl.full), field(&m_sp)};
+
+    X64Emitter emit {m_codeBuffer->current()};
+
+#ifdef GBBUDDY_LAZY_FLAGS
+    const X64Mem flagZ {field(&m_flagZ)};
+    const X64Mem flagN {field(&m_flagN)};
+    const X64Mem flagH {field(&m_flagH)};
+    const X64Mem flagC {field(&m_flagC)};
+
+    // Performs ALU operation on A and ECX. Mirrors ADD8/ADC/SUB/SBC/AND/XOR/OR/CP
+    const auto compileAlu = [&](u8 operation) {
+        emit.movzx8(X64Reg::RAX, r8[7]);
+        emit.mov32(X64Reg::RDX, X64Reg::RAX);
+
+        if (operation >= 4 && operation <= 6) {
+            if (operation == 4) emit.and32(X64Reg::RDX, X64Reg::RCX);
+            else if (operation == 5) emit.xor32(X64Reg::RDX, X64Reg::RCX);
+            else emit.or32(X64Reg::RDX, X64Reg::RCX);
+
+            emit.mov8(r8[7], X64Reg::RDX);
+            emit.mov8(flagZ, X64Reg::RDX);
+            emit.mov8(flagN, 0);
+            emit.mov8(flagH, operation == 4 ? 0x10 : 0);
+            emit.mov16(flagC, 0);
+            return;
+        }
+
+        const bool subtract {operation >= 2};
+        if (subtract) emit.sub32(X64Reg::RDX, X64Reg::RCX);
+        else emit.add32(X64Reg::RDX, X64Reg::RCX);
+
+        if (operation == 1 || operation == 3) {
+            // Carry is bit 8 of the lazy carry
+            emit.movzx16(X64Reg::R8, flagC);
+            emit.shr32(X64Reg::R8, 8);
+            emit.and32(X64Reg::R8, 1);
+            if (subtract) emit.sub32(X64Reg::RDX, X64Reg::R8);
+            else emit.add32(X64Reg::RDX, X64Reg::R8);
+        }
+
+        if (operation != 7) emit.mov8(r8[7], X64Reg::RDX);
+        emit.mov8(flagZ, X64Reg::RDX);
+        emit.mov8(flagN, subtract);
+        emit.mov16(flagC, X64Reg::RDX);
+        emit.xor32(X64Reg::RAX, X64Reg::RCX);
+        emit.xor32(X64Reg::RAX, X64Reg::RDX);
+        emit.mov8(flagH, X64Reg::RAX);
+    };
+#endif
+
+    // Epilogue goes first so every exit can jump back to it
+    const u8* epilogue {emit.current()};
+    if (X64Emitter::SHADOW_SPACE > 0) emit.addRsp(X64Emitter::SHADOW_SPACE);
+    emit.pop(X64Reg::R13);
+    emit.pop(X64Reg::R12);
+    emit.pop(X64Reg::RBX);
+    emit.ret();
+
+    const u8* entry {emit.current()};
+    emit.push(X64Reg::RBX);
+    emit.push(X64Reg::R12);
+    emit.push(X64Reg::R13);
+    if (X64Emitter::SHADOW_SPACE > 0) emit.subRsp(X64Emitter::SHADOW_SPACE);
+    emit.mov64(X64Reg::RBX, X64Emitter::ARG0);
+    emit.mov64(X64Reg::R13, reinterpret_cast<u64>(&block.valid));
+    emit.xor32(X64Reg::R12, X64Reg::R12);
+
+    const auto exit = [&](u32 instructions, u32 cycles) {
+        emit.mov64(X64Reg::RAX, packResult(instructions, cycles));
+        emit.jmp(epilogue);
+    };
+
+    const auto exitIf = [&](X64Cond skipCondition, u32 instructions, u32 cycles) {
+        u8* skip {emit.jccForward(skipCondition)};
+        exit(instructions, cycles);
+        emit.bind(skip);
+    };
+
+    u16 address {block.start};
+    u32 instructions {0};
+    u32 cycles {0};
+
+    for (const auto& instruction : block.instructions) {
+        const u8 opcode {instruction.opcode};
+        const u16 operand {instruction.operand};
+        const bool last {instructions + 1 == block.instructions.size()};
+
+        address += instruction.length;
+        instructions++;
+        cycles += opcodes::cycles(opcode, operand, false);
+
+        const u8 x {opfield::x(opcode)};
+        const u8 y {opfield::y(opcode)};
+        const u8 z {opfield::z(opcode)};
+        const u8 p {opfield::p(opcode)};
+        const u8 q {opfield::q(opcode)};
+
+        // Unconditional relative and absolute jumps always end a block
+        if (opcode == 0x18 || opcode == 0xC3) {
+            emit.mov16(pc, opcode == 0x18 ? static_cast<u16>(address + static_cast<i8>(operand)) : operand);
+            exit(instructions, cycles);
+            break;
+        }
+
+        bool inlined {true};
+        if (opcode == 0x00) {
+            // NOP
+        } else if (x == 1 && y != 6 && z != 6) {
+            emit.movzx8(X64Reg::RAX, r8[z]);
+            emit.mov8(r8[y], X64Reg::RAX);
+        } else if (x == 0 && z == 6 && y != 6) {
+            emit.mov8(r8[y], static_cast<u8>(operand));
+        } else if (x == 0 && z == 1 && q == 0) {
+            emit.mov16(rp[p], operand);
+        } else if (x == 0 && z == 3) {
+            if (q == 0) emit.inc16(rp[p]);
+            else emit.dec16(rp[p]);
+#ifdef GBBUDDY_LAZY_FLAGS
+        } else if ((x == 2 && z != 6) || (x == 3 && z == 6)) {
+            if (x == 2) emit.movzx8(X64Reg::RCX, r8[z]);
+            else emit.mov32(X64Reg::RCX, static_cast<u8>(operand));
+            compileAlu(y);
+        } else if (x == 0 && (z == 4 || z == 5) && y != 6) {
+            // INC/DEC r8. Carry is left alone
+            emit.movzx8(X64Reg::RAX, r8[y]);
+            emit.mov32(X64Reg::RDX, X64Reg::RAX);
+            emit.mov32(X64Reg::RCX, 1);
+            if (z == 4) emit.add32(X64Reg::RDX, X64Reg::RCX);
+            else emit.sub32(X64Reg::RDX, X64Reg::RCX);
+            emit.mov8(r8[y], X64Reg::RDX);
+            emit.mov8(flagZ, X64Reg::RDX);
+            emit.mov8(flagN, z == 5);
+            emit.xor32(X64Reg::RAX, X64Reg::RCX);
+            emit.xor32(X64Reg::RAX, X64Reg::RDX);
+            emit.mov8(flagH, X64Reg::RAX);
+#endif
+        } else {
+            inlined = false;
+        }
+
+        if (inlined) {
+            if (last) {
+                emit.mov16(pc, address);
+                exit(instructions, cycles);
+            }
+            continue;
+        }
+
+        const bool prefixed {opcode == 0xCB};
+        const u8 opcodeCB {static_cast<u8>(operand)};
+        const bool usesHL {prefixed && opfield::z(opcodeCB) == 6};
+        const bool writes {prefixed ? usesHL && opfield::x(opcodeCB) != 1 : opcodes::writesMemory(opcode)};
+        const auto source {usesHL ? opcodes::AddressSource::HL : opcodes::addressSource(opcode)};
+
+        // Work out if the instruction could touch I/O or mapper registers, after which the block must exit
+        bool exitAfter {false};
+        bool checkAddress {false};
+        switch (source) {
+        case opcodes::AddressSource::BC:
+        case opcodes::AddressSource::DE:
+        case opcodes::AddressSource::HL:
+            // Address isn't known until runtime. Checked before the handler as it may change the register.
+            // Anything at $FF00 and up counts, HRAM accesses through registers are rare
+            emit.movzx16(X64Reg::RAX, rp[static_cast<usize>(source) - static_cast<usize>(opcodes::AddressSource::BC)]);
+            if (writes) {
+                emit.sub32(X64Reg::RAX, 0x8000);
+                emit.cmp32(X64Reg::RAX, 0xFF00 - 0x8000);
+            } else {
+                emit.cmp32(X64Reg::RAX, 0xFF00);
+            }
+            emit.setcc(X64Cond::AE, X64Reg::R12);
+            checkAddress = true;
+            break;
+        case opcodes::AddressSource::Immediate:
+            exitAfter = hasSideEffects(operand, writes) || (opcode == 0x08 && hasSideEffects(operand + 1, writes));
+            break;
+        case opcodes::AddressSource::HighImmediate:
+            exitAfter = hasSideEffects(0xFF00 + (operand & 0xFF), writes);
+            break;
+        case opcodes::AddressSource::HighC:
+            exitAfter = true;
+            break;
+        case opcodes::AddressSource::None:
+            break;
+        }
+
+        const bool branch {opcodes::BRANCH_CYCLES[opcode] != 0};
+
+        emit.mov16(pc, address);
+        emit.mov16(blockCycles, instruction.offset);
+        if (branch) emit.mov8(branchTaken, 0);
+
+        emit.mov64(X64Emitter::ARG0, X64Reg::RBX);
+        emit.mov32(X64Emitter::ARG1, prefixed ? 0 : operand);
+        emit.mov64(X64Reg::RAX, reinterpret_cast<u64>(prefixed ? s_handlersCB[opcodeCB] : s_handlers[opcode]));
+        emit.call(X64Reg::RAX);
+
+        if (branch) {
+            // Conditional branches are always last. Pick cycle count based on whether it was taken
+            emit.mov64(X64Reg::RAX, packResult(instructions, cycles));
+            emit.mov64(X64Reg::RCX, packResult(instructions, cycles + opcodes::BRANCH_CYCLES[opcode]));
+            emit.cmp8(branchTaken, 0);
+            emit.cmov64(X64Cond::NE, X64Reg::RAX, X64Reg::RCX);
+            emit.jmp(epilogue);
+            break;
+        }
+
+        if (last || exitAfter) {
+            exit(instructions, cycles);
+            break;
+        }
+
+        if (checkAddress) {
+            emit.test8(X64Reg::R12, X64Reg::R12);
+            exitIf(X64Cond::E, instructions, cycles);
+        }
+
+        if (writes) {
+            emit.cmp8(valid, 0);
+            exitIf(X64Cond::NE, instructions, cycles);
+        }
+    }
+
+    m_codeBuffer->commit(emit.current());
+    block.compiled = entry;
+    m_jitStats.compiledBlocks++;
+}
+
+template<Bus BusType>
+u32 CPU<BusType>::runCompiledChecked(Block& block) {
+    if (!m_jitShadow) m_jitShadow = std::make_unique<JitShadow>();
+    auto& shadow {*m_jitShadow};
+
+    // Give interpreter a copy of everything the block starts with. Peeking keeps I/O hooks from firing
+    for (u32 address {0}; address <= 0xFFFF; address++) {
+        shadow.bus.write(address, m_bus.peek(address));
+    }
+    CPUState start {getState()};
+    shadow.cpu.setState(start);
+
+    const u64 result {reinterpret_cast<CompiledBlock>(block.compiled)(this)};
+    const u32 instructions {static_cast<u32>(result >> 32)};
+    const u32 cycles {static_cast<u32>(result)};
+
+    u32 expectedCycles {0};
+    for (u32 i {0}; i < instructions; i++) {
+        expectedCycles += shadow.cpu.step();
+    }
+
+    CPUState state {getState()};
+    CPUState expectedState {shadow.cpu.getState()};
+    bool matches {state == expectedState && cycles == expectedCycles};
+
+    // ROM is skipped as the shadow bus stores mapper writes instead of ignoring them. On the real bus OAM and
+    // I/O registers are too, as masks, hooks and OAM DMA make them differ from the shadow's plain memory
+    for (u32 address {0x8000}; matches && address <= 0xFFFF; address++) {
+        if constexpr (std::same_as<BusType, RealBus>) {
+            if ((address >= 0xFE00 && address <= 0xFE9F) || (address >= 0xFF00 && address <= 0xFF7F)) continue;
+        }
+        matches = m_bus.peek(static_cast<u16>(address)) == shadow.bus.peek(static_cast<u16>(address));
+    }
+
+    if (!matches) {
+        m_jitStats.mismatches++;
+        log::err("JIT mismatch in block at {:04X} after {} instructions", block.start, instructions);
+        log::err("Start:       {}", start.toString());
+        log::err("JIT:         {} ({} cycles)", state.toString(), cycles);
+        log::err("Interpreter: {} ({} cycles)", expectedState.toString(), expectedCycles);
+    }
+
+    return cycles;
+}
+
+template<Bus BusType>
+void CPU<BusType>::flushCodeIfFull() {
+    if (m_codeBuffer && m_codeBuffer->remaining() < MAX_COMPILED_BLOCK_SIZE) {
+        m_blockCache.clear();
+        m_codeBuffer->reset();
+        m_jitStats.flushes++;
+    }
+}
+
+template<Bus BusType>
+u32 CPU<BusType>::runJitBlock(Block& block) {
+    if (block.compiled == nullptr) {
+        if (++block.executions < JIT_THRESHOLD) return executeBlock(block);
+        compileBlock(block);
+    }
+
+    if (m_jitDiffMode) return runCompiledChecked(block);
+    return static_cast<u32>(reinterpret_cast<CompiledBlock>(block.compiled)(this));
+}
+
+template<Bus BusType>
+u32 CPU<BusType>::runJit() {
+    m_endRun = false;  // Only applies to run()
+    if (m_imePending || m_halted || m_haltBug || m_stallCycles != 0) return step();
+
+    flushCodeIfFull();
+
+    Block* block {lookupBlock()};
+    if (block == nullptr) return step();
+
+    return runJitBlock(*block);
+}
+
+#endif
+
+template<Bus BusType>
+bool CPU<BusType>::stopStepping(u64 cyclesLeft) {
+    if (cyclesLeft == 0 || m_endRun) return true;
+    if (m_imePending || m_halted || m_haltBug || m_stallCycles != 0) return true;
+    if (m_ime && pendingInterrupts() != 0) return true;
+    if (!isCacheable(m_pc)) return false;
+
+    const Block* block {lookupBlock()};
+    return block != nullptr && block->cycles + block->branchCycles <= cyclesLeft;
+}
+
+#if defined(GBBUDDY_THREADED_DISPATCH) && (defined(__GNUC__) || defined(__clang__))
+
+// Expands X once per opcode as two hex digits, i.e. X(00) X(01) ... X(FF)
+#define GB_OPCODE_ROW(X, hi) \
+    X(hi##0) X(hi##1) X(hi##2) X(hi##3) X(hi##4) X(hi##5) X(hi##6) X(hi##7) \
+    X(hi##8) X(hi##9) X(hi##A) X(hi##B) X(hi##C) X(hi##D) X(hi##E) X(hi##F)
+#define GB_OPCODES(X) \
+    GB_OPCODE_ROW(X, 0) GB_OPCODE_ROW(X, 1) GB_OPCODE_ROW(X, 2) GB_OPCODE_ROW(X, 3) \
+    GB_OPCODE_ROW(X, 4) GB_OPCODE_ROW(X, 5) GB_OPCODE_ROW(X, 6) GB_OPCODE_ROW(X, 7) \
+    GB_OPCODE_ROW(X, 8) GB_OPCODE_ROW(X, 9) GB_OPCODE_ROW(X, A) GB_OPCODE_ROW(X, B) \
+    GB_OPCODE_ROW(X, C) GB_OPCODE_ROW(X, D) GB_OPCODE_ROW(X, E) GB_OPCODE_ROW(X, F)
+
+#define GB_OPCODE_LABEL_ADDRESS(n) &&op_##n,
+#define GB_OPCODE_LABEL(n) op_##n: cycles += fetchAndExecute<0x##n>(*this); GB_DISPATCH();
+
+// Computed gotos are a GNU extension
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+
+template<Bus BusType>
+u64 CPU<BusType>::stepMany(u64 cycleBudget) {
+    if (m_imePending || m_halted || m_haltBug || m_stallCycles != 0) return step();
+
+    // Each opcode gets its own indirect jump at the end of its handler which gives the
+    // host branch predictor a much better chance than a single shared dispatch point
+    static const void* const labels[256] { GB_OPCODES(GB_OPCODE_LABEL_ADDRESS) };
+
+    // Keeps the current time right for I/O handlers, like run() does between blocks
+    const u64 start {m_runCycles};
+    u64 cycles {0};
+
+#define GB_DISPATCH() \
+    do { \
+        if (stopStepping(cycleBudget > cycles ? cycleBudget - cycles : 0)) { m_runCycles = start; return cycles; } \
+        m_runCycles = start + cycles; \
+        goto *labels[m_bus.read(m_pc++)]; \
+    } while (0)
+
+    goto *labels[m_bus.read(m_pc++)];
+    GB_OPCODES(GB_OPCODE_LABEL)
+
+#undef GB_DISPATCH
+}
+
+#pragma GCC diagnostic pop
+
+#undef GB_OPCODE_LABEL
+#undef GB_OPCODE_LABEL_ADDRESS
+#undef GB_OPCODES
+#undef GB_OPCODE_ROW
+
+#else
+
+template<Bus BusType>
+u64 CPU<BusType>::stepMany(u64 cycleBudget) {
+    if (m_imePending || m_halted || m_haltBug || m_stallCycles != 0) return step();
+
+    const u64 start {m_runCycles};
+    u64 cycles {0};
+    do {
+        m_runCycles = start + cycles;
+        cycles += step();
+    } while (!stopStepping(cycleBudget > cycles ? cycleBudget - cycles : 0));
+
+    m_runCycles = start;
+    return cycles;
+}
+
+#endif
+
+// The only bus types the CPU gets used with. Keeps template definitions out of the header
+template class CPU<RealBus>;
+template class CPU<MockBus>;
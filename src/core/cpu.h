@@ -1,10 +1,18 @@
 #pragma once
 
+#include <array>
+#include <memory>
 #include <string>
+#include <utility>
 
 #include "common/types.h"
 
-class GameBoy;
+#include "blockcache.h"
+#include "bus.h"
+
+#ifdef GBBUDDY_JIT
+#include "jit/codebuffer.h"
+#endif
 
 
 struct CPUState {
@@ -35,17 +43,79 @@ union RegisterPair {
 enum class Reg8  { A, F, B, C, D, E, H, L, HLMem };
 enum class Reg16 { AF, BC, DE, HL, SP };
 
-class Bus;
+struct JitStats {
+    u64 compiledBlocks {};
+    u64 flushes {};     // Number of times code buffer filled up and everything was thrown away
+    u64 mismatches {};  // Blocks which didn't match the interpreter in differential mode
+};
 
+// Templated on the concrete bus type so memory accesses can be inlined.
+// Instantiated for RealBus and MockBus in cpu.cpp
+template<Bus BusType>
 class CPU {
 public:
-    int cycleDelay {0};
+    // Defined in cpu.cpp along with the destructor as some members are only complete there
+    CPU(BusType& bus);
+    ~CPU();
+
+    // Executes a single opcode. Returns number of M-cycles taken
+    u8 step();
+
+    // Executes instructions until cycleBudget M-cycles have passed. Returns number of M-cycles taken,
+    // which only goes over the budget by what's left of the last instruction.
+    // Runs cached blocks (translated ones when built with GBBUDDY_JIT) whenever they fit in the budget
+    u64 run(u64 cycleBudget);
+
+    // Executes instructions one at a time until cycleBudget M-cycles have passed or run() has something to handle
+    // between instructions, like a pending interrupt or a cached block which fits what's left. Always runs at least
+    // one instruction and returns number of M-cycles taken. Falls back to step() while halted, stalled or after EI.
+    // Uses computed-goto threaded dispatch when built with GCC/Clang and GBBUDDY_THREADED_DISPATCH
+    u64 stepMany(u64 cycleBudget);
+
+    // Executes the pre-decoded block at PC, decoding and caching it first if needed.
+    // Falls back to a single step() if code at PC can't be cached. Returns number of M-cycles taken
+    u32 runBlock();
+
+    // Throws away cached code in [address, address + size). Needed when something other than the CPU writes memory
+    void invalidateCode(u16 address, usize size);
+
+    // Gets hit/miss/invalidation counters for the block cache
+    const BlockCacheStats& blockCacheStats() const { return m_blockCache.stats(); }
+
+    // Lets run() skip to the end of its budget when it finds a loop which only polls memory,
+    // such as waiting on LY or a flag set by an interrupt handler. Off by default
+    void setIdleLoopSkipping(bool enabled) { m_idleLoopSkipping = enabled; }
+
+    // Number of M-cycles run() skipped over while halted or stuck in an idle loop
+    u64 skippedCycles() const { return m_skippedCycles; }
+
+    bool isHalted() const { return m_halted; }
+
+    // M-cycles taken so far by the run() in progress, or 0 outside of run(). Counts every instruction
+    // before the one running. Lets I/O handlers work out the current time so their component can catch up
+    u64 runCycles() const { return m_runCycles + m_blockCycles; }
+
+    // Makes the run() in progress return once the current instruction is done. Used by I/O handlers which
+    // schedule an event earlier than the deadline run() was given
+    void endRun() { m_endRun = true; }
 
-    CPU(Bus& bus)
-        : m_bus(bus) {};
+    // Keeps CPU idle for the given number of M-cycles, such as while a GBC general purpose DMA copies
+    void stall(u32 cycles) { m_stallCycles += cycles; }
 
-    // Executes a single opcode. Returns number of cycles
-    void step();
+    // Called by STOP. GBC uses it to switch speed
+    using StopHandler = void (*)(void* context);
+    void setStopHandler(StopHandler handler, void* context);
+
+#ifdef GBBUDDY_JIT
+    // Same as runBlock() but translates blocks to native x86-64 code once they've run often enough.
+    // Translated blocks return early after accessing I/O or mapper registers and after writes to their own code
+    u32 runJit();
+
+    // Runs every translated block against the interpreter and logs any differences. Very slow
+    void setJitDiffMode(bool enabled) { m_jitDiffMode = enabled; }
+
+    const JitStats& jitStats() const { return m_jitStats; }
+#endif
 
     // Sets CPU state
     void setState(CPUState state);
@@ -66,16 +136,69 @@ private:
     u16 m_pc {}; // Stack pointer
     u16 m_sp {}; // Program counter
 
-    u8 m_ime;  // Interrupt master enable flag
+    u8 m_ime {};  // Interrupt master enable flag
+
+    bool m_imePending {false};  // Set by EI. IME gets set once the next instruction has run
+    bool m_halted {false};      // Set by HALT until an interrupt is pending
+    bool m_haltBug {false};     // Set by HALT when it gets skipped with IME clear. Next fetch doesn't move PC
+
+    bool m_idleLoopSkipping {false};
+    u64 m_skippedCycles {};
+    u64 m_runCycles {};
+    u16 m_blockCycles {};  // M-cycles taken by instructions before the current one in the running block
+    bool m_endRun {false};
+    u64 m_stallCycles {};  // M-cycles left to sit idle before fetching again
+
+    StopHandler m_stopHandler {nullptr};
+    void* m_stopContext {nullptr};
+
+    static constexpr u16 IF_ADDRESS {0xFF0F};  // Interrupt flag register
+    static constexpr u16 IE_ADDRESS {0xFFFF};  // Interrupt enable register
+
+#ifdef GBBUDDY_LAZY_FLAGS
+    // Lazily evaluated flags. Each holds the raw value the flag is derived from and is only
+    // turned into a bit in F when something reads it. m_af.lo is unused in this mode
+    u8 m_flagZ {1};   // Zero flag is set when this is 0
+    u8 m_flagN {0};   // Subtract flag is bit 0
+    u8 m_flagH {0};   // Half carry flag is bit 4 (i.e. operand1 ^ operand2 ^ result)
+    u16 m_flagC {0};  // Carry flag is bit 8 (i.e. the untruncated result)
+#endif
+
+    BusType& m_bus;
+
+    BlockCache m_blockCache {};
+
+    bool m_branchTaken {false};    // Set when a branch instruction takes its branch. Used for cycle counts
+    bool m_mapperWritten {false};  // Set by writes to mapper registers, which ends the running block
+
+#ifdef GBBUDDY_JIT
+    // Translated block. Returns (number of instructions run << 32) | M-cycles taken
+    using CompiledBlock = u64 (*)(CPU* cpu);
+
+    static constexpr u32 JIT_THRESHOLD {16};                  // Runs before a block gets translated
+    static constexpr usize CODE_BUFFER_SIZE {8 * 1024 * 1024};
+    static constexpr usize MAX_COMPILED_BLOCK_SIZE {16 * 1024};  // Worst case size of a translated block
 
-    Bus& m_bus;
+    std::unique_ptr<CodeBuffer> m_codeBuffer {};
+    JitStats m_jitStats {};
 
-    usize m_cycleDelay {0};
+    // Interpreter which translated blocks are compared against in differential mode
+    struct JitShadow;
+    std::unique_ptr<JitShadow> m_jitShadow {};
+    bool m_jitDiffMode {false};
+#endif
 
-    u8 readReg8(Reg8 reg) const;
-    u16 readReg16(Reg16 reg) const;
-    void writeReg8(Reg8 reg, u8 value);
-    void writeReg16(Reg16 reg, u16 value);
+    // Register accessors. Register is a template argument so it gets resolved at compile time
+    template<Reg8 reg> u8 readReg8() const;
+    template<Reg16 reg> u16 readReg16() const;
+    template<Reg8 reg> void writeReg8(u8 value);
+    template<Reg16 reg> void writeReg16(u16 value);
+
+    // Grabs the immediate operands of an opcode with the given length and advances PC past them
+    template<u8 length> u16 fetchOperands();
+
+    // Writes to memory, invalidating any cached code at the address
+    void writeMemory(u16 address, u8 value);
 
     // Flag getters
     u8 getCarry() const;
@@ -89,15 +212,97 @@ private:
     void setSubtract(bool value);
     void setZero(bool value);
 
+    // Flag setters which take the raw value the flag is derived from.
+    // Evaluation is deferred until the flag is read when GBBUDDY_LAZY_FLAGS is defined
+    void setCarryFrom(u16 result);      // Bit 8 of untruncated result
+    void setHalfCarryFrom(u8 carries);  // Bit 4 of operand1 ^ operand2 ^ result
+    void setZeroFrom(u8 result);        // Set if result is 0
+
+    // Builds or unpacks the F register
+    u8 readFlags() const;
+    void writeFlags(u8 value);
+
+    // Gets interrupts which are both requested and enabled
+    u8 pendingInterrupts();
+
+    // Wakes the CPU from HALT if an interrupt is pending and jumps to its handler if IME is set.
+    // Returns number of M-cycles taken
+    u8 handleInterrupts();
+
+    // Decodes straight-line code starting at address into a block
+    Block decodeBlock(u16 address);
+
+    // Gets cached block at PC, decoding it if needed. Returns nullptr if code at PC can't be cached
+    Block* lookupBlock();
+
+    // Runs instructions of block with the interpreter. Returns number of M-cycles taken
+    u32 executeBlock(const Block& block);
+
+    // Checks if stepMany() has to hand back to run() with the given M-cycles left in its budget
+    bool stopStepping(u64 cyclesLeft);
+
+    // Checks if code at address lives in memory which can be cached.
+    // Covers ROM, external RAM, WRAM and HRAM
+    static bool isCacheable(u16 address);
+
+#ifdef GBBUDDY_JIT
+    // Throws away all translated code if the code buffer can't fit another block.
+    // Must be called before looking up a block as it also clears the block cache
+    void flushCodeIfFull();
+
+    // Runs block with the JIT, translating it first if it has become hot. Returns number of M-cycles taken
+    u32 runJitBlock(Block& block);
+
+    // Translates block into native code
+    void compileBlock(Block& block);
+
+    // Runs translated block, then replays it with the interpreter and compares the results
+    u32 runCompiledChecked(Block& block);
+#endif
+
     // Stack helpers
     void pushToStack(u16 value);
     u16 popStack();
 
-    // Decodes a short 8-bit opcode.
-    void decode(u8 opcode);
+    // -----------
+    // DISPATCHING
+    // -----------
+
+    // Handlers take their immediate operands (or the $CB opcode) already fetched
+    using Handler = void (*)(CPU&, u16 operand);
+
+    // Executes a short 8-bit opcode. Operands are baked in at compile time
+    template<u8 opcode> static void execute(CPU& cpu, u16 operand);
+
+    // Executes a long 16-bit (prefixed with $CB) opcode. Operands are baked in at compile time
+    template<u8 opcode> static void executeCB(CPU& cpu, u16 operand);
+
+    // Fetches immediate operands from memory at PC then executes opcode. Returns number of M-cycles taken
+    using FetchingHandler = u8 (*)(CPU&);
+    template<u8 opcode> static u8 fetchAndExecute(CPU& cpu);
+
+    // Performs the ALU operation selected by bits 3-5 of an opcode
+    template<u8 operation> void alu(u8 value);
+
+    // Performs the rotate/shift operation selected by bits 3-5 of a $CB opcode
+    template<u8 operation, Reg8 reg> void rotate();
+
+    // Checks the branch condition selected by bits 3-4 of an opcode
+    template<u8 condition> bool checkCondition() const;
+
+    template<usize... opcodes>
+    static constexpr std::array<Handler, 256> makeHandlerTable(std::index_sequence<opcodes...>);
+
+    template<usize... opcodes>
+    static constexpr std::array<Handler, 256> makeHandlerTableCB(std::index_sequence<opcodes...>);
+
+    template<usize... opcodes>
+    static constexpr std::array<FetchingHandler, 256> makeFetchingHandlerTable(std::index_sequence<opcodes...>);
 
-    // Decodes a long 16-bit (prefixed with $CB) opcode.
-    void decodeCB(u8 opcode);
+    // Handler tables indexed by opcode. Generated at compile time
+    static const std::array<Handler, 256> s_handlers;
+    static const std::array<Handler, 256> s_handlersCB;
+    static const std::array<FetchingHandler, 256> s_fetchingHandlers;
 
     // ------------
     // INSTRUCTIONS
@@ -118,10 +323,10 @@ private:
     void CP(uint8_t value);
 
     // Decrements 8-bit value
-    void DEC8(Reg8 reg);
+    template<Reg8 reg> void DEC8();
 
     // Increments 8-bit value
-    void INC8(Reg8 reg);
+    template<Reg8 reg> void INC8();
 
     // ORs value with accumulator
     void OR(uint8_t value);
@@ -138,27 +343,27 @@ private:
     // - 16-bit Arithmetic Instructions
 
     // Adds value to HL
-    void ADD16(Reg16 reg);
+    template<Reg16 reg> void ADD16();
 
     // Decrements 16-bit value
-    void DEC16(Reg16 reg);
+    template<Reg16 reg> void DEC16();
 
     // Increments 16-bit value
-    void INC16(Reg16 reg);
+    template<Reg16 reg> void INC16();
 
     // - Bit Operation Instructions
 
     // Checks if bit is set
-    void BIT(Reg8 reg, u8 bitPos);
+    template<Reg8 reg, u8 bitPos> void BIT();
 
     // Resets bit in value
-    void RES(Reg8 reg, u8 bitPos);
+    template<Reg8 reg, u8 bitPos> void RES();
 
     // Sets bit
-    void SET(Reg8 reg, u8 bitPos);
+    template<Reg8 reg, u8 bitPos> void SET();
 
     // Swaps upper 4 bits and lower 4 bits of value
-    void SWAP(Reg8 reg);
+    template<Reg8 reg> void SWAP();
 
     // - Bit Shift Instructions
 
@@ -166,7 +371,7 @@ private:
     u8 RL(u8 value);
 
     // Rotates carry flag + register left
-    void RL_r8(Reg8 reg);
+    template<Reg8 reg> void RL_r8();
 
     // Rotates carry flag + accumulator left
     void RLA();
@@ -175,7 +380,7 @@ private:
     u8 RLC(u8 value);
 
     // Rotates register left
-    void RLC_r8(Reg8 reg);
+    template<Reg8 reg> void RLC_r8();
 
     // Rotates accumulator left
     void RLCA();
@@ -184,7 +389,7 @@ private:
     u8 RR(u8 value);
 
     // Rotates carry flag + register right
-    void RR_r8(Reg8 reg);
+    template<Reg8 reg> void RR_r8();
 
     // Rotates carry flag + accumulator right
     void RRA();
@@ -193,27 +398,27 @@ private:
     u8 RRC(u8 value);
 
     // Rotates register right
-    void RRC_r8(Reg8 reg);
+    template<Reg8 reg> void RRC_r8();
 
     // Rotates accumulator right
     void RRCA();
 
     // Shifts left arithmetically. Bit 0 is zeroed
-    void SLA(Reg8 reg);
+    template<Reg8 reg> void SLA();
 
     // Shifts right arithmetically. Bit 7 remains the same
-    void SRA(Reg8 reg);
+    template<Reg8 reg> void SRA();
 
     // Shifts right logically. Bit 7 is zeroed
-    void SRL(Reg8 reg);
+    template<Reg8 reg> void SRL();
 
     // - Load Instructions
 
     // Loads 8-bit value into 8-bit register
-    void LD8(Reg8 reg, u8 value);
+    template<Reg8 reg> void LD8(u8 value);
 
     // Loads 16-bit value into 16-bit register
-    void LD16(Reg16 reg, u16 value);
+    template<Reg16 reg> void LD16(u16 value);
 
     // Gets value from accumulator and writes to memory at provided address
     void LD_n16_A(u16 address);
@@ -250,16 +455,16 @@ private:
     // - Jumps and Subroutines
 
     // Calls address
-    void CALL(bool condition = true);
+    void CALL(u16 address, bool condition = true);
 
     // Jumps to an address
-    void JP(bool condition = true);
+    void JP(u16 address, bool condition = true);
 
     // Jumps to the address stored in HL
     void JP_HL();
 
     // Performs a relative jump to an address
-    void JR(bool condition = true);
+    void JR(i8 offset, bool condition = true);
 
     // Returns from a subroutine
     void RET(bool condition = true);
@@ -291,10 +496,10 @@ private:
     void LD_SP_HL();
 
     // Gets 16-bit register from stack
-    void POP(Reg16 reg);
+    template<Reg16 reg> void POP();
 
     // Writes 16-bit register to stack
-    void PUSH(Reg16 reg);
+    template<Reg16 reg> void PUSH();
 
     // - Miscellaneous Instructions
 
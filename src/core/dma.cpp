@@ -0,0 +1,162 @@
+#include "dma.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "gameboy.h"
+
+DMA::DMA(GameBoy& gb)
+    : m_gb(gb)
+{
+    m_gb.scheduler.setHandler(EventType::DMAComplete, [](void* context, u64) {
+        static_cast<DMA*>(context)->finishOamDma();
+    }, this);
+
+    m_gb.bus.setIORegister(OAM_DMA_ADDRESS, {
+        .context = this,
+        .write = [](void* context, u16, u8 value) { static_cast<DMA*>(context)->startOamDma(value); },
+    });
+}
+
+void DMA::setCgbMode(bool enabled) {
+    m_hdmaSource = 0;
+    m_hdmaDestination = 0;
+    m_hdmaControl = 0xFF;
+    m_hblankBlocks = 0;
+
+    if (!enabled) {
+        for (u16 address {HDMA1_ADDRESS}; address <= HDMA5_ADDRESS; address++) m_gb.bus.setIORegister(address, {});
+        return;
+    }
+
+    // Source and destination are write-only and read as $FF
+    m_gb.bus.setIORegister(HDMA1_ADDRESS, {
+        .context = this,
+        .write = [](void* context, u16, u8 value) {
+            auto* dma {static_cast<DMA*>(context)};
+            dma->m_hdmaSource = static_cast<u16>((dma->m_hdmaSource & 0x00FF) | (value << 8));
+        },
+        .readMask = 0x00,
+    });
+    m_gb.bus.setIORegister(HDMA2_ADDRESS, {
+        .context = this,
+        .write = [](void* context, u16, u8 value) {
+            auto* dma {static_cast<DMA*>(context)};
+            dma->m_hdmaSource = static_cast<u16>((dma->m_hdmaSource & 0xFF00) | (value & 0xF0));
+        },
+        .readMask = 0x00,
+    });
+    m_gb.bus.setIORegister(HDMA3_ADDRESS, {
+        .context = this,
+        .write = [](void* context, u16, u8 value) {
+            auto* dma {static_cast<DMA*>(context)};
+            dma->m_hdmaDestination = static_cast<u16>((dma->m_hdmaDestination & 0x00FF) | ((value & 0x1F) << 8));
+        },
+        .readMask = 0x00,
+    });
+    m_gb.bus.setIORegister(HDMA4_ADDRESS, {
+        .context = this,
+        .write = [](void* context, u16, u8 value) {
+            auto* dma {static_cast<DMA*>(context)};
+            dma->m_hdmaDestination = static_cast<u16>((dma->m_hdmaDestination & 0xFF00) | (value & 0xF0));
+        },
+        .readMask = 0x00,
+    });
+    m_gb.bus.setIORegister(HDMA5_ADDRESS, {
+        .context = this,
+        .read = [](void* context, u16) { return static_cast<DMA*>(context)->m_hdmaControl; },
+        .write = [](void* context, u16, u8 value) { static_cast<DMA*>(context)->writeHdmaControl(value); },
+    });
+}
+
+void DMA::hblank() {
+    if (m_hblankBlocks == 0) return;
+
+    copyHdmaBlocks(1);
+    m_hblankBlocks--;
+    m_hdmaControl = m_hblankBlocks != 0 ? m_hblankBlocks - 1 : 0xFF;
+}
+
+void DMA::startOamDma(u8 value) {
+    // Sources past $DFFF read from WRAM through the echo
+    u16 source {static_cast<u16>(value << 8)};
+    if (source >= 0xE000) source -= 0x2000;
+
+    copy(source, m_gb.bus.oam(), OAM_SIZE);
+    m_gb.cpu.invalidateCode(0xFE00, OAM_SIZE);
+
+    m_oamDmaActive = true;
+    m_gb.bus.setOamAccessible(false);
+
+    // Restarting a transfer in progress just pushes back the end. CPU has to stop at the new deadline
+    m_gb.scheduler.scheduleAt(EventType::DMAComplete, m_gb.currentTime() + (OAM_DMA_CYCLES >> m_gb.speedShift()));
+    m_gb.cpu.endRun();
+}
+
+void DMA::finishOamDma() {
+    m_oamDmaActive = false;
+    m_gb.bus.setOamAccessible(true);
+}
+
+void DMA::writeHdmaControl(u8 value) {
+    const u8 blocks {static_cast<u8>((value & 0x7F) + 1)};
+
+    if (m_hblankBlocks != 0 && (value & 0x80) == 0) {
+        // Cancels H-blank DMA. Remaining length can still be read back
+        m_hdmaControl = 0x80 | (m_hblankBlocks - 1);
+        m_hblankBlocks = 0;
+        return;
+    }
+
+    if ((value & 0x80) != 0) {
+        m_hblankBlocks = blocks;
+        m_hdmaControl = value & 0x7F;
+
+        // Doesn't wait for the next H-blank if already in one, which includes the LCD being off
+        if (m_gb.ppu.mode() == PPU::Mode::HBlank) hblank();
+        return;
+    }
+
+    // General purpose DMA copies everything at once while the CPU waits
+    copyHdmaBlocks(blocks);
+    m_hdmaControl = 0xFF;
+}
+
+void DMA::copyHdmaBlocks(u32 blocks) {
+    RealBus& bus {m_gb.bus};
+    u8* vram {bus.vram(bus.vramBank())};
+
+    usize remaining {blocks * HDMA_BLOCK_SIZE};
+    while (remaining > 0) {
+        // Destination wraps around within VRAM
+        const usize size {std::min(remaining, RealBus::VRAM_BANK_SIZE - m_hdmaDestination)};
+        copy(m_hdmaSource, vram + m_hdmaDestination, size);
+        m_gb.cpu.invalidateCode(0x8000 + m_hdmaDestination, size);
+        bus.tiles().invalidate(bus.vramBank(), m_hdmaDestination, size);
+
+        m_hdmaSource = static_cast<u16>(m_hdmaSource + size);
+        m_hdmaDestination = static_cast<u16>((m_hdmaDestination + size) % RealBus::VRAM_BANK_SIZE);
+        remaining -= size;
+    }
+
+    // Transfers take the same time at both speeds, so twice as many M-cycles in double speed
+    m_gb.cpu.stall((blocks * HDMA_BLOCK_CYCLES) << m_gb.speedShift());
+}
+
+void DMA::copy(u16 source, u8* destination, usize size) {
+    RealBus& bus {m_gb.bus};
+
+    while (size > 0) {
+        const usize chunk {std::min(size, RealBus::PAGE_SIZE - source % RealBus::PAGE_SIZE)};
+
+        if (const u8* memory {bus.readPointer(source)}) {
+            std::memcpy(destination, memory, chunk);
+        } else {
+            for (usize i {0}; i < chunk; i++) destination[i] = bus.read(static_cast<u16>(source + i));
+        }
+
+        source = static_cast<u16>(source + chunk);
+        destination += chunk;
+        size -= chunk;
+    }
+}
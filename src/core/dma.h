@@ -0,0 +1,58 @@
+#pragma once
+
+#include "common/types.h"
+
+class GameBoy;
+
+// OAM DMA and the GBC VRAM DMA (HDMA). Transfers copy straight between host memory whenever the source
+// pages are plain memory, and only fall back to bus reads for sources with side effects.
+// OAM DMA copies every byte at the start of the transfer and only locks the CPU out of OAM until it would have
+// finished. On hardware the CPU can only reach HRAM in that window, and source bytes it changes still land in OAM.
+// Neither is emulated, as games wait in HRAM without touching the source anyway
+class DMA {
+public:
+    static constexpr u16 OAM_DMA_ADDRESS {0xFF46};
+    static constexpr u16 HDMA1_ADDRESS {0xFF51};  // Source high
+    static constexpr u16 HDMA2_ADDRESS {0xFF52};  // Source low
+    static constexpr u16 HDMA3_ADDRESS {0xFF53};  // Destination high
+    static constexpr u16 HDMA4_ADDRESS {0xFF54};  // Destination low
+    static constexpr u16 HDMA5_ADDRESS {0xFF55};  // Length, mode and start
+
+    static constexpr usize OAM_SIZE {0xA0};
+    static constexpr u32 OAM_DMA_CYCLES {OAM_SIZE};  // M-cycles at CPU speed, 1 per byte
+
+    static constexpr usize HDMA_BLOCK_SIZE {0x10};
+    static constexpr u32 HDMA_BLOCK_CYCLES {8};  // M-cycles at normal speed the CPU is stalled for per block
+
+    explicit DMA(GameBoy& gb);
+
+    // Enables the GBC HDMA registers. Without them they act as plain storage
+    void setCgbMode(bool enabled);
+
+    // Copies the next block of an H-blank DMA. Called by the PPU whenever it enters H-blank
+    void hblank();
+
+    bool isOamDmaActive() const { return m_oamDmaActive; }
+    bool isHblankDmaActive() const { return m_hblankBlocks != 0; }
+
+private:
+    GameBoy& m_gb;
+
+    bool m_oamDmaActive {false};
+
+    u16 m_hdmaSource {0};
+    u16 m_hdmaDestination {0};  // Offset into VRAM
+    u8 m_hdmaControl {0xFF};    // Value read from HDMA5
+    u8 m_hblankBlocks {0};      // Blocks left to copy in H-blank DMA. 0 when inactive
+
+    void startOamDma(u8 value);
+    void finishOamDma();
+
+    void writeHdmaControl(u8 value);
+
+    // Copies blocks from source to VRAM destination, stalling the CPU like the hardware does
+    void copyHdmaBlocks(u32 blocks);
+
+    // Copies bytes from bus address to host memory. Uses memcpy for every source page backed by plain memory
+    void copy(u16 source, u8* destination, usize size);
+};
@@ -1,34 +1,113 @@
 #include "gameboy.h"
 
+#include <algorithm>
+#include <utility>
+
 GameBoy::GameBoy()
     : cartridge(this)
-    , cpu(this)
+    , bus(cartridge)
+    , cpu(bus)
+    , dma(*this)
+    , ppu(*this)
 {
+    cpu.setStopHandler([](void* context) {
+        auto* gb {static_cast<GameBoy*>(context)};
+        if (!gb->m_speedSwitchArmed) return;
+
+        // Cycles up to here were run at the old speed, so the CPU has to hand back before they get converted
+        gb->m_speedSwitchPending = true;
+        gb->cpu.endRun();
+    }, this);
+}
+
+GameBoy::~GameBoy() {
+    cartridge.save();
+}
+
+void GameBoy::init(const std::filesystem::path& romPath) {
+    cartridge.init(romPath);
+    reset();
+}
+
+void GameBoy::init(std::vector<u8> rom) {
+    cartridge.init(std::move(rom));
+    reset();
+}
+
+void GameBoy::initForTests() {
+    cartridge.initForTests();
+    bus.mapCartridge();
 }
 
-void GameBoy::init() {
+void GameBoy::reset() {
     cpu.setState({
         .a = 0x01,
+        .f = 0xB0,
         .b = 0x00,
         .c = 0x13,
         .d = 0x00,
         .e = 0xD8,
-        .f = 0xB0,
         .h = 0x01,
         .l = 0x4D,
         .sp = 0xFFFE,
         .pc = 0x0100,
+        .ime = 0,
     });
-    cartridge.init();
-    mmu = std::make_unique<RealMMU>(this);
-}
+    const bool cgb {cartridge.cartHeader.cgbSupport};
+    bus.setCgbMode(cgb);
+    dma.setCgbMode(cgb);
+    ppu.reset();
 
-void GameBoy::initForTests() {
-    cartridge.initForTests();
-    mmu = std::make_unique<MockMMU>();
+    m_speedShift = 0;
+    m_speedSwitchArmed = false;
+    m_speedSwitchPending = false;
+    m_cpuCycleCarry = 0;
+    if (cgb) {
+        bus.setIORegister(KEY1_ADDRESS, {
+            .context = this,
+            .read = [](void* context, u16) {
+                const auto* gb {static_cast<GameBoy*>(context)};
+                return static_cast<u8>((gb->m_speedShift << 7) | (gb->m_speedSwitchArmed ? 0x01 : 0x00));
+            },
+            .write = [](void* context, u16, u8 value) { static_cast<GameBoy*>(context)->m_speedSwitchArmed = (value & 0x01) != 0; },
+            .readMask = 0x81,
+            .writeMask = 0x01,
+        });
+    } else {
+        bus.setIORegister(KEY1_ADDRESS, {});
+    }
+
+    bus.mapCartridge();
+    if (cartridge.hasSaveFile()) bus.trackCartridgeWrites();
 }
 
-void GameBoy::run() {
-    cpu.step();
-    cpu.printState();
+u64 GameBoy::run(u64 cycles) {
+    const u64 start {scheduler.now()};
+    const u64 end {start + cycles};
+
+    while (true) {
+        scheduler.runDueEvents();
+        if (scheduler.now() >= end) break;
+
+        // CPU only needs to stop at the next deadline rather than checking for events every instruction
+        const u64 target {std::min(end, scheduler.nextDeadline())};
+        const u64 cpuCycles {cpu.run((target - scheduler.now()) << m_speedShift) + m_cpuCycleCarry};
+        m_cpuCycleCarry = cpuCycles & ((1 << m_speedShift) - 1);
+        scheduler.advance(cpuCycles >> m_speedShift);
+
+        if (m_speedSwitchPending) {
+            m_speedShift ^= 1;
+            m_speedSwitchArmed = false;
+            m_speedSwitchPending = false;
+            cpu.stall(SPEED_SWITCH_CYCLES);
+        }
+    }
+
+    // Checked once per run so games hammering RAM still only pay for one slow write per flush
+    if (cartridge.isRamDirty()) {
+        cartridge.flushSave();
+        bus.trackCartridgeWrites();
+    }
+
+    return scheduler.now() - start;
 }
\ No newline at end of file
@@ -1,22 +1,66 @@
 #pragma once
 
+#include <filesystem>
+#include <vector>
+
+#include "common/types.h"
+
+#include "bus.h"
 #include "cartridge.h"
 #include "cpu.h"
-#include "mmu.h"
+#include "dma.h"
+#include "ppu.h"
+#include "scheduler.h"
 
+// Owns all emulated components. Uses the concrete RealBus so CPU memory accesses are resolved statically
 class GameBoy {
 public:
+    static constexpr u64 CYCLES_PER_SECOND {1'048'576};  // M-cycles
+    static constexpr u64 CYCLES_PER_FRAME {17'556};      // M-cycles taken by PPU to draw a frame
+
+    static constexpr u16 KEY1_ADDRESS {0xFF4D};      // GBC speed switch
+    static constexpr u32 SPEED_SWITCH_CYCLES {2050};  // M-cycles the CPU stops for while switching speed
+
+    Scheduler scheduler;
     Cartridge cartridge;
-    CPU cpu;
-    std::unique_ptr<MMU> mmu;
+    RealBus bus;
+    CPU<RealBus> cpu;
+    DMA dma;
+    PPU ppu;
 
     GameBoy();
 
-    // Sets up emulator and components
-    void init();
+    // Makes sure battery backed cartridge RAM has reached the disk
+    ~GameBoy();
+
+    // Sets up emulator and components, loading the ROM at romPath
+    void init(const std::filesystem::path& romPath);
+
+    // Sets up emulator and components with a ROM image already in memory
+    void init(std::vector<u8> rom);
 
     // Sets up emulator for use in testing
     void initForTests();
 
-    void run();
-};
\ No newline at end of file
+    // Gets current timestamp in M-cycles, including what the CPU has run since the scheduler last advanced.
+    // Used by I/O register hooks to catch up the component which owns the register
+    u64 currentTime() const { return scheduler.now() + ((cpu.runCycles() + m_cpuCycleCarry) >> m_speedShift); }
+
+    // Number of CPU M-cycles per M-cycle of time, as a shift. 1 in GBC double speed mode, otherwise 0.
+    // Timestamps always count normal speed M-cycles
+    u8 speedShift() const { return m_speedShift; }
+
+    // Runs emulator for the given number of M-cycles, firing scheduled events as they come due.
+    // Battery saves written during the run are flushed in the background afterwards.
+    // Returns number of M-cycles actually run
+    u64 run(u64 cycles);
+
+private:
+    u8 m_speedShift {0};
+    bool m_speedSwitchArmed {false};    // Set through KEY1. Next STOP switches speed
+    bool m_speedSwitchPending {false};  // STOP ran. Speed changes once the CPU has returned
+    u64 m_cpuCycleCarry {0};            // CPU M-cycles run in double speed which didn't make up a whole M-cycle of time
+
+    // Puts components into the state the boot ROM leaves them in. Cartridge must be loaded first
+    void reset();
+};
@@ -0,0 +1,32 @@
+#include "codebuffer.h"
+
+#include <stdexcept>
+
+#ifdef _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+#else
+    #include <sys/mman.h>
+#endif
+
+CodeBuffer::CodeBuffer(usize size)
+    : m_size(size)
+{
+#ifdef _WIN32
+    void* memory = VirtualAlloc(nullptr, size, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE);
+    if (memory == nullptr) throw std::runtime_error("Failed to allocate executable memory for JIT");
+#else
+    void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) throw std::runtime_error("Failed to allocate executable memory for JIT");
+#endif
+
+    m_memory = static_cast<u8*>(memory);
+}
+
+CodeBuffer::~CodeBuffer() {
+#ifdef _WIN32
+    VirtualFree(m_memory, 0, MEM_RELEASE);
+#else
+    munmap(m_memory, m_size);
+#endif
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "common/types.h"
+
+// Region of memory which is writable and executable. Translated code gets written into it
+// sequentially and is only thrown away all at once
+class CodeBuffer {
+public:
+    explicit CodeBuffer(usize size);
+    ~CodeBuffer();
+
+    CodeBuffer(const CodeBuffer&) = delete;
+    CodeBuffer& operator=(const CodeBuffer&) = delete;
+
+    // Gets address the next piece of code should be written to
+    u8* current() { return m_memory + m_used; }
+
+    // Marks code up to end as used
+    void commit(const u8* end) { m_used = static_cast<usize>(end - m_memory); }
+
+    // Gets number of bytes left
+    usize remaining() const { return m_size - m_used; }
+
+    // Discards all code. Anything pointing into the buffer must be thrown away first
+    void reset() { m_used = 0; }
+
+private:
+    u8* m_memory {nullptr};
+    usize m_size {0};
+    usize m_used {0};
+};
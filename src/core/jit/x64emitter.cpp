@@ -0,0 +1,231 @@
+#include "x64emitter.h"
+
+#include <cstring>
+
+namespace {
+    constexpr u8 low3(X64Reg reg) { return static_cast<u8>(reg) & 0b111; }
+    constexpr bool extended(X64Reg reg) { return static_cast<u8>(reg) >= 8; }
+}
+
+void X64Emitter::emit16(u16 value) {
+    std::memcpy(m_code, &value, sizeof(value));
+    m_code += sizeof(value);
+}
+
+void X64Emitter::emit32(u32 value) {
+    std::memcpy(m_code, &value, sizeof(value));
+    m_code += sizeof(value);
+}
+
+void X64Emitter::emit64(u64 value) {
+    std::memcpy(m_code, &value, sizeof(value));
+    m_code += sizeof(value);
+}
+
+void X64Emitter::rex(bool w, X64Reg reg, X64Reg rm, bool force) {
+    const u8 prefix = 0x40 | (w << 3) | (extended(reg) << 2) | extended(rm);
+    if (prefix != 0x40 || force) emit8(prefix);
+}
+
+void X64Emitter::modrm(u8 reg, X64Reg rm) {
+    emit8(0xC0 | ((reg & 0b111) << 3) | low3(rm));
+}
+
+void X64Emitter::modrm(u8 reg, X64Mem rm) {
+    // Always uses a 32-bit displacement. RSP/R12 bases need a SIB byte
+    emit8(0x80 | ((reg & 0b111) << 3) | low3(rm.base));
+    if (low3(rm.base) == 0b100) emit8(0x24);
+    emit32(static_cast<u32>(rm.disp));
+}
+
+void X64Emitter::push(X64Reg reg) {
+    rex(false, X64Reg::RAX, reg);
+    emit8(0x50 + low3(reg));
+}
+
+void X64Emitter::pop(X64Reg reg) {
+    rex(false, X64Reg::RAX, reg);
+    emit8(0x58 + low3(reg));
+}
+
+void X64Emitter::ret() {
+    emit8(0xC3);
+}
+
+void X64Emitter::addRsp(u8 value) {
+    emit8(0x48); emit8(0x83); emit8(0xC4); emit8(value);
+}
+
+void X64Emitter::subRsp(u8 value) {
+    emit8(0x48); emit8(0x83); emit8(0xEC); emit8(value);
+}
+
+void X64Emitter::call(X64Reg target) {
+    rex(false, X64Reg::RAX, target);
+    emit8(0xFF);
+    modrm(2, target);
+}
+
+void X64Emitter::jmp(const u8* target) {
+    emit8(0xE9);
+    emit32(static_cast<u32>(target - (m_code + 4)));
+}
+
+u8* X64Emitter::jccForward(X64Cond condition) {
+    emit8(0x70 + static_cast<u8>(condition));
+    emit8(0);
+    return m_code - 1;
+}
+
+void X64Emitter::bind(u8* jump) {
+    *jump = static_cast<u8>(m_code - (jump + 1));
+}
+
+void X64Emitter::mov64(X64Reg dst, X64Reg src) {
+    rex(true, src, dst);
+    emit8(0x89);
+    modrm(static_cast<u8>(src), dst);
+}
+
+void X64Emitter::mov64(X64Reg dst, u64 value) {
+    rex(true, X64Reg::RAX, dst);
+    emit8(0xB8 + low3(dst));
+    emit64(value);
+}
+
+void X64Emitter::mov32(X64Reg dst, u32 value) {
+    rex(false, X64Reg::RAX, dst);
+    emit8(0xB8 + low3(dst));
+    emit32(value);
+}
+
+void X64Emitter::mov32(X64Reg dst, X64Reg src) {
+    alu32(0x89, dst, src);
+}
+
+void X64Emitter::alu32(u8 opcode, X64Reg dst, X64Reg src) {
+    rex(false, src, dst);
+    emit8(opcode);
+    modrm(static_cast<u8>(src), dst);
+}
+
+void X64Emitter::add32(X64Reg dst, X64Reg src) { alu32(0x01, dst, src); }
+void X64Emitter::sub32(X64Reg dst, X64Reg src) { alu32(0x29, dst, src); }
+void X64Emitter::and32(X64Reg dst, X64Reg src) { alu32(0x21, dst, src); }
+void X64Emitter::or32(X64Reg dst, X64Reg src)  { alu32(0x09, dst, src); }
+void X64Emitter::xor32(X64Reg dst, X64Reg src) { alu32(0x31, dst, src); }
+
+void X64Emitter::and32(X64Reg dst, u32 value) {
+    rex(false, X64Reg::RAX, dst);
+    emit8(0x81);
+    modrm(4, dst);
+    emit32(value);
+}
+
+void X64Emitter::shr32(X64Reg dst, u8 amount) {
+    rex(false, X64Reg::RAX, dst);
+    emit8(0xC1);
+    modrm(5, dst);
+    emit8(amount);
+}
+
+void X64Emitter::mov8(X64Mem dst, u8 value) {
+    rex(false, X64Reg::RAX, dst.base);
+    emit8(0xC6);
+    modrm(0, dst);
+    emit8(value);
+}
+
+void X64Emitter::mov8(X64Mem dst, X64Reg src) {
+    rex(false, src, dst.base, static_cast<u8>(src) >= 4);
+    emit8(0x88);
+    modrm(static_cast<u8>(src), dst);
+}
+
+void X64Emitter::mov16(X64Mem dst, u16 value) {
+    emit8(0x66);
+    rex(false, X64Reg::RAX, dst.base);
+    emit8(0xC7);
+    modrm(0, dst);
+    emit16(value);
+}
+
+void X64Emitter::mov16(X64Mem dst, X64Reg src) {
+    emit8(0x66);
+    rex(false, src, dst.base);
+    emit8(0x89);
+    modrm(static_cast<u8>(src), dst);
+}
+
+void X64Emitter::movzx8(X64Reg dst, X64Mem src) {
+    rex(false, dst, src.base);
+    emit8(0x0F); emit8(0xB6);
+    modrm(static_cast<u8>(dst), src);
+}
+
+void X64Emitter::movzx16(X64Reg dst, X64Mem src) {
+    rex(false, dst, src.base);
+    emit8(0x0F); emit8(0xB7);
+    modrm(static_cast<u8>(dst), src);
+}
+
+void X64Emitter::inc16(X64Mem dst) {
+    emit8(0x66);
+    rex(false, X64Reg::RAX, dst.base);
+    emit8(0xFF);
+    modrm(0, dst);
+}
+
+void X64Emitter::dec16(X64Mem dst) {
+    emit8(0x66);
+    rex(false, X64Reg::RAX, dst.base);
+    emit8(0xFF);
+    modrm(1, dst);
+}
+
+void X64Emitter::cmp8(X64Mem lhs, u8 value) {
+    rex(false, X64Reg::RAX, lhs.base);
+    emit8(0x80);
+    modrm(7, lhs);
+    emit8(value);
+}
+
+void X64Emitter::cmp16(X64Mem lhs, u16 value) {
+    emit8(0x66);
+    rex(false, X64Reg::RAX, lhs.base);
+    emit8(0x81);
+    modrm(7, lhs);
+    emit16(value);
+}
+
+void X64Emitter::cmp32(X64Reg lhs, u32 value) {
+    rex(false, X64Reg::RAX, lhs);
+    emit8(0x81);
+    modrm(7, lhs);
+    emit32(value);
+}
+
+void X64Emitter::sub32(X64Reg dst, u32 value) {
+    rex(false, X64Reg::RAX, dst);
+    emit8(0x81);
+    modrm(5, dst);
+    emit32(value);
+}
+
+void X64Emitter::test8(X64Reg lhs, X64Reg rhs) {
+    rex(false, rhs, lhs, static_cast<u8>(lhs) >= 4 || static_cast<u8>(rhs) >= 4);
+    emit8(0x84);
+    modrm(static_cast<u8>(rhs), lhs);
+}
+
+void X64Emitter::setcc(X64Cond condition, X64Reg dst) {
+    rex(false, X64Reg::RAX, dst, static_cast<u8>(dst) >= 4);
+    emit8(0x0F); emit8(0x90 + static_cast<u8>(condition));
+    modrm(0, dst);
+}
+
+void X64Emitter::cmov64(X64Cond condition, X64Reg dst, X64Reg src) {
+    rex(true, dst, src);
+    emit8(0x0F); emit8(0x40 + static_cast<u8>(condition));
+    modrm(static_cast<u8>(dst), src);
+}
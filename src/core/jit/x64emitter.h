@@ -0,0 +1,110 @@
+#pragma once
+
+#include "common/types.h"
+
+enum class X64Reg : u8 {
+    RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+    R8, R9, R10, R11, R12, R13, R14, R15
+};
+
+// Condition codes as encoded in Jcc/SETcc/CMOVcc
+enum class X64Cond : u8 {
+    O, NO, B, AE, E, NE, BE, A,
+    S, NS, P, NP, L, GE, LE, G
+};
+
+// Memory operand of the form [base + disp]
+struct X64Mem {
+    X64Reg base;
+    i32 disp;
+};
+
+// Writes x86-64 machine code into memory. Only covers the handful of instructions the JIT needs.
+// Register operands of 8/16/32-bit instructions use the low part of the given register
+class X64Emitter {
+public:
+    // Registers used to pass the first two integer arguments to functions
+#ifdef _WIN32
+    static constexpr X64Reg ARG0 {X64Reg::RCX};
+    static constexpr X64Reg ARG1 {X64Reg::RDX};
+    static constexpr u8 SHADOW_SPACE {32};  // Space callers must reserve on stack for callee
+#else
+    static constexpr X64Reg ARG0 {X64Reg::RDI};
+    static constexpr X64Reg ARG1 {X64Reg::RSI};
+    static constexpr u8 SHADOW_SPACE {0};
+#endif
+
+    explicit X64Emitter(u8* code)
+        : m_code(code) {};
+
+    // Gets address the next instruction will be written to
+    u8* current() const { return m_code; }
+
+    void push(X64Reg reg);
+    void pop(X64Reg reg);
+    void ret();
+
+    void addRsp(u8 value);
+    void subRsp(u8 value);
+
+    void call(X64Reg target);
+    void jmp(const u8* target);
+
+    // Emits a short conditional jump whose target is set later through bind()
+    u8* jccForward(X64Cond condition);
+
+    // Points a forward jump at the current address
+    void bind(u8* jump);
+
+    void mov64(X64Reg dst, X64Reg src);
+    void mov64(X64Reg dst, u64 value);
+    void mov32(X64Reg dst, X64Reg src);
+    void mov32(X64Reg dst, u32 value);
+
+    void add32(X64Reg dst, X64Reg src);
+    void sub32(X64Reg dst, X64Reg src);
+    void and32(X64Reg dst, X64Reg src);
+    void or32(X64Reg dst, X64Reg src);
+    void xor32(X64Reg dst, X64Reg src);
+    void and32(X64Reg dst, u32 value);
+    void shr32(X64Reg dst, u8 amount);
+
+    void mov8(X64Mem dst, u8 value);
+    void mov8(X64Mem dst, X64Reg src);
+    void mov16(X64Mem dst, u16 value);
+    void mov16(X64Mem dst, X64Reg src);
+    void movzx8(X64Reg dst, X64Mem src);
+    void movzx16(X64Reg dst, X64Mem src);
+
+    void inc16(X64Mem dst);
+    void dec16(X64Mem dst);
+
+    void cmp8(X64Mem lhs, u8 value);
+    void cmp16(X64Mem lhs, u16 value);
+    void cmp32(X64Reg lhs, u32 value);
+    void sub32(X64Reg dst, u32 value);
+    void test8(X64Reg lhs, X64Reg rhs);
+
+    void setcc(X64Cond condition, X64Reg dst);
+    void cmov64(X64Cond condition, X64Reg dst, X64Reg src);
+
+private:
+    u8* m_code;
+
+    void emit8(u8 value) { *m_code++ = value; }
+    void emit16(u16 value);
+    void emit32(u32 value);
+    void emit64(u64 value);
+
+    // Emits REX prefix if any of its bits are needed. force is for byte access to SPL/BPL/SIL/DIL
+    void rex(bool w, X64Reg reg, X64Reg rm, bool force = false);
+
+    // Emits a two register ALU instruction, i.e. op dst, src
+    void alu32(u8 opcode, X64Reg dst, X64Reg src);
+
+    // Emits ModRM byte for a register operand
+    void modrm(u8 reg, X64Reg rm);
+
+    // Emits ModRM/SIB/displacement for a memory operand
+    void modrm(u8 reg, X64Mem rm);
+};
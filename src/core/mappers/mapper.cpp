@@ -1,8 +1,57 @@
 #include "mapper.h"
 
 #include "../cartridge.h"
+#include "../gameboy.h"
+
+static constexpr size_t ROM_BANK_SIZE {16 * 1024};
+static constexpr size_t RAM_BANK_SIZE {8 * 1024};
 
 Mapper::Mapper(Cartridge &cart)
     : m_cartridge(cart)
 {
-}
\ No newline at end of file
+}
+
+std::span<const uint8_t> Mapper::rom() const {
+    return m_cartridge.m_rom;
+}
+
+uint64_t Mapper::now() const {
+    return m_cartridge.m_gb != nullptr ? m_cartridge.m_gb->currentTime() : 0;
+}
+
+void Mapper::setRumble(bool enabled) {
+    if (m_cartridge.m_rumbleHandler != nullptr) m_cartridge.m_rumbleHandler(m_cartridge.m_rumbleContext, enabled);
+}
+
+void Mapper::mapRom(uint16_t bank0, uint16_t bankX) {
+    BankMapping& banks = m_cartridge.m_banks;
+    const size_t bankCount = m_cartridge.m_rom.size() / ROM_BANK_SIZE;
+
+    // ROMs too small to fill a bank are left unmapped and read as open bus
+    if (bankCount == 0) {
+        banks.rom0 = nullptr;
+        banks.romX = nullptr;
+        banks.rom0Bank = bank0;
+        banks.romBank = bankX;
+        return;
+    }
+
+    banks.rom0 = m_cartridge.m_rom.data() + (bank0 % bankCount) * ROM_BANK_SIZE;
+    banks.romX = m_cartridge.m_rom.data() + (bankX % bankCount) * ROM_BANK_SIZE;
+    banks.rom0Bank = bank0 % bankCount;
+    banks.romBank = bankX % bankCount;
+}
+
+void Mapper::mapRam(uint16_t bank, bool enabled) {
+    BankMapping& banks = m_cartridge.m_banks;
+    const size_t bankCount = m_cartridge.m_ram.size() / RAM_BANK_SIZE;
+
+    if (!enabled || bankCount == 0) {
+        banks.ram = nullptr;
+        banks.ramBank = 0;
+        return;
+    }
+
+    banks.ram = m_cartridge.m_ram.data() + (bank % bankCount) * RAM_BANK_SIZE;
+    banks.ramBank = bank % bankCount;
+}
@@ -1,17 +1,44 @@
 #pragma once
 
 #include <cstdint>
+#include <span>
 
 class Cartridge;
 
+// Host memory currently mapped into each cartridge region. Mappers update it on bank switches
+// so the bus can read banked memory directly without going through the mapper
+struct BankMapping {
+    const uint8_t* rom0 {nullptr};  // $0000-$3FFF
+    const uint8_t* romX {nullptr};  // $4000-$7FFF
+    uint8_t* ram {nullptr};         // $A000-$BFFF. nullptr if RAM is missing or disabled
+
+    uint16_t rom0Bank {0};  // ROM bank mapped to $0000-$3FFF
+    uint16_t romBank {0};   // ROM bank mapped to $4000-$7FFF
+    uint16_t ramBank {0};  // RAM bank mapped to $A000-$BFFF
+};
+
+// Base for all mappers. Mappers aren't virtual as Cartridge keeps them in a closed std::variant.
+// Each one implements romWrite() for its control registers and remaps banks through the helpers here.
+// Mappers with registers in the RAM area also implement ramRead()/ramWrite(), which get called whenever RAM isn't mapped
 class Mapper {
 public:
     Mapper(Cartridge &cart);
-    virtual ~Mapper() = default;
-
-    virtual uint8_t romRead(uint16_t address) = 0;
-    virtual void romWrite(uint16_t address, uint8_t value) = 0;
 
 protected:
     Cartridge &m_cartridge;
-};
\ No newline at end of file
+
+    // Gets whole ROM image
+    std::span<const uint8_t> rom() const;
+
+    // Gets current emulated time in M-cycles. Used by clocks on the cartridge
+    uint64_t now() const;
+
+    // Tells the frontend the rumble motor was switched on or off
+    void setRumble(bool enabled);
+
+    // Maps ROM banks into $0000-$3FFF and $4000-$7FFF. Bank numbers wrap around to the ROM size
+    void mapRom(uint16_t bank0, uint16_t bankX);
+
+    // Maps RAM bank into $A000-$BFFF. Bank number wraps around to the RAM size
+    void mapRam(uint16_t bank, bool enabled);
+};
@@ -0,0 +1,57 @@
+#include "mbc1.h"
+
+#include <algorithm>
+#include <array>
+
+#include "../cartridge.h"
+
+MBC1::MBC1(Cartridge &cart)
+    : Mapper(cart)
+{
+    m_multicart = isMulticart();
+    updateBanks();
+}
+
+void MBC1::romWrite(uint16_t address, uint8_t value) {
+    switch (address >> 13) {
+        case 0: // $0000-$1FFF
+            m_ramEnabled = (value & 0x0F) == 0x0A;
+            break;
+        case 1: // $2000-$3FFF. Bank 0 is treated as 1 before the multicart wiring drops bit 4
+            m_romBank = value & 0x1F;
+            if (m_romBank == 0) m_romBank = 1;
+            break;
+        case 2: // $4000-$5FFF
+            m_upperBits = value & 0b11;
+            break;
+        case 3: // $6000-$7FFF
+            m_advancedMode = value & 0b1;
+            break;
+    }
+
+    updateBanks();
+}
+
+void MBC1::updateBanks() {
+    const uint8_t shift = m_multicart ? 4 : 5;
+    const uint8_t lowBits = m_multicart ? (m_romBank & 0x0F) : m_romBank;
+    const uint16_t upperBank = m_upperBits << shift;
+
+    mapRom(m_advancedMode ? upperBank : 0, upperBank | lowBits);
+    mapRam(m_advancedMode ? m_upperBits : 0, m_ramEnabled);
+}
+
+bool MBC1::isMulticart() const {
+    static constexpr std::array<uint8_t, 48> NINTENDO_LOGO {
+        0xCE, 0xED, 0x66, 0x66, 0xCC, 0x0D, 0x00, 0x0B, 0x03, 0x73, 0x00, 0x83, 0x00, 0x0C, 0x00, 0x0D,
+        0x00, 0x08, 0x11, 0x1F, 0x88, 0x89, 0x00, 0x0E, 0xDC, 0xCC, 0x6E, 0xE6, 0xDD, 0xDD, 0xD9, 0x99,
+        0xBB, 0xBB, 0x67, 0x63, 0x6E, 0x0E, 0xEC, 0xCC, 0xDD, 0xDC, 0x99, 0x9F, 0xBB, 0xB9, 0x33, 0x3E,
+    };
+    static constexpr size_t MULTICART_SIZE {1024 * 1024};
+    static constexpr size_t SECOND_GAME_LOGO {0x10 * 16 * 1024 + 0x0104};  // Bank $10
+
+    const auto rom = this->rom();
+    if (rom.size() != MULTICART_SIZE) return false;
+
+    return std::ranges::equal(rom.subspan(SECOND_GAME_LOGO, NINTENDO_LOGO.size()), NINTENDO_LOGO);
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+
+#include "mapper.h"
+
+// MBC1. Up to 2MiB of ROM and 32KiB of RAM. Also covers MBC1M multicarts, which wire the
+// upper bank register one bit lower so four 256KiB games fit in 1MiB
+class MBC1 : public Mapper {
+public:
+    MBC1(Cartridge &cart);
+
+    void romWrite(uint16_t address, uint8_t value);
+
+private:
+    bool m_ramEnabled {false};
+    uint8_t m_romBank {1};        // 5-bit register at $2000-$3FFF. Never 0
+    uint8_t m_upperBits {0};      // 2-bit register at $4000-$5FFF. RAM bank or upper ROM bank bits
+    bool m_advancedMode {false};  // Mode register at $6000-$7FFF. Lets the upper bits apply to $0000-$3FFF and RAM
+    bool m_multicart {false};
+
+    // Recomputes mapped banks from the registers
+    void updateBanks();
+
+    // Checks for MBC1M by looking for a second Nintendo logo where the second game would start
+    bool isMulticart() const;
+};
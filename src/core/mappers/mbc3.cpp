@@ -0,0 +1,48 @@
+#include "mbc3.h"
+
+#include "../cartridge.h"
+
+MBC3::MBC3(Cartridge &cart, bool hasRtc)
+    : Mapper(cart)
+    , m_hasRtc(hasRtc)
+{
+    updateBanks();
+}
+
+void MBC3::romWrite(uint16_t address, uint8_t value) {
+    switch (address >> 13) {
+        case 0: // $0000-$1FFF
+            m_ramEnabled = (value & 0x0F) == 0x0A;
+            break;
+        case 1: // $2000-$3FFF
+            m_romBank = value & 0x7F;
+            if (m_romBank == 0) m_romBank = 1;
+            break;
+        case 2: // $4000-$5FFF
+            m_ramSelect = value & 0x0F;
+            break;
+        case 3: // $6000-$7FFF
+            if (m_hasRtc && m_lastLatchWrite == 0x00 && value == 0x01) m_rtc.latch(now());
+            m_lastLatchWrite = value;
+            break;
+    }
+
+    updateBanks();
+}
+
+uint8_t MBC3::ramRead(uint16_t) {
+    if (!m_ramEnabled || !isRtcSelected()) return 0xFF;
+    return m_rtc.read(m_ramSelect);
+}
+
+void MBC3::ramWrite(uint16_t, uint8_t value) {
+    if (!m_ramEnabled || !isRtcSelected()) return;
+    m_rtc.write(m_ramSelect, value, now());
+}
+
+void MBC3::updateBanks() {
+    mapRom(0, m_romBank);
+
+    // RTC registers go through ramRead()/ramWrite() so RAM gets unmapped while one is selected
+    mapRam(m_ramSelect & 0b111, m_ramEnabled && m_ramSelect <= 0x07);
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+
+#include "mapper.h"
+#include "rtc.h"
+
+// MBC3. Up to 2MiB of ROM, 32KiB of RAM and an optional real time clock mapped over the RAM area
+class MBC3 : public Mapper {
+public:
+    MBC3(Cartridge &cart, bool hasRtc);
+
+    void romWrite(uint16_t address, uint8_t value);
+
+    // Only reached when RAM isn't mapped, i.e. it's disabled or an RTC register is selected
+    uint8_t ramRead(uint16_t address);
+    void ramWrite(uint16_t address, uint8_t value);
+
+    // Gets clock or nullptr if the cartridge doesn't have one
+    RTC* rtc() { return m_hasRtc ? &m_rtc : nullptr; }
+    const RTC* rtc() const { return m_hasRtc ? &m_rtc : nullptr; }
+
+private:
+    bool m_ramEnabled {false};  // Also enables the RTC registers
+    uint8_t m_romBank {1};      // 7-bit register at $2000-$3FFF. Never 0
+    uint8_t m_ramSelect {0};    // Register at $4000-$5FFF. RAM bank for $00-$07, RTC register for $08-$0C
+    uint8_t m_lastLatchWrite {0xFF};  // Latching happens when $00 then $01 are written to $6000-$7FFF
+
+    bool m_hasRtc {false};
+    RTC m_rtc {};
+
+    // Recomputes mapped banks from the registers
+    void updateBanks();
+
+    bool isRtcSelected() const { return m_hasRtc && m_ramSelect >= RTC::SECONDS && m_ramSelect <= RTC::DAYS_HIGH; }
+};
@@ -0,0 +1,45 @@
+#include "mbc5.h"
+
+#include "../cartridge.h"
+
+MBC5::MBC5(Cartridge &cart, bool hasRumble)
+    : Mapper(cart)
+    , m_hasRumble(hasRumble)
+{
+    updateBanks();
+}
+
+void MBC5::romWrite(uint16_t address, uint8_t value) {
+    switch (address >> 12) {
+        case 0x0: case 0x1: // $0000-$1FFF
+            m_ramEnabled = value == 0x0A;
+            break;
+        case 0x2: // $2000-$2FFF
+            m_romBank = (m_romBank & 0x100) | value;
+            break;
+        case 0x3: // $3000-$3FFF
+            m_romBank = (m_romBank & 0xFF) | ((value & 0b1) << 8);
+            break;
+        case 0x4: case 0x5: // $4000-$5FFF
+            m_ramBank = value & 0x0F;
+            if (m_hasRumble) {
+                // Motor takes the place of bank bit 3
+                const bool rumbling = m_ramBank & 0b1000;
+                m_ramBank &= 0b0111;
+                if (rumbling != m_rumbling) {
+                    m_rumbling = rumbling;
+                    setRumble(rumbling);
+                }
+            }
+            break;
+        default: // $6000-$7FFF isn't used
+            return;
+    }
+
+    updateBanks();
+}
+
+void MBC5::updateBanks() {
+    mapRom(0, m_romBank);
+    mapRam(m_ramBank, m_ramEnabled);
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdint>
+
+#include "mapper.h"
+
+// MBC5. Up to 8MiB of ROM and 128KiB of RAM. Rumble cartridges drive the motor with bit 3 of the RAM bank register
+class MBC5 : public Mapper {
+public:
+    MBC5(Cartridge &cart, bool hasRumble);
+
+    void romWrite(uint16_t address, uint8_t value);
+
+private:
+    bool m_ramEnabled {false};
+    uint16_t m_romBank {1};  // 9-bit. Low 8 bits at $2000-$2FFF, bit 8 at $3000-$3FFF. Bank 0 can be selected
+    uint8_t m_ramBank {0};   // Register at $4000-$5FFF
+
+    bool m_hasRumble {false};
+    bool m_rumbling {false};
+
+    // Recomputes mapped banks from the registers
+    void updateBanks();
+};
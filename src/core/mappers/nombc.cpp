@@ -5,12 +5,10 @@
 NoMBC::NoMBC(Cartridge &cart)
     : Mapper(cart)
 {
+    mapRom(0, 1);
+    mapRam(0, true);
 }
 
-uint8_t NoMBC::romRead(uint16_t address) {
-    return m_cartridge.m_rom[address];
+void NoMBC::romWrite(uint16_t, uint8_t) {
+    // No registers to write to and ROM is read-only
 }
-
-void NoMBC::romWrite(uint16_t address, uint8_t value) {
-    m_cartridge.m_rom[address] = value;
-}
\ No newline at end of file
@@ -4,10 +4,10 @@
 
 #include "mapper.h"
 
+// Plain 32KiB ROM with optional 8KiB of RAM and no banking
 class NoMBC : public Mapper {
 public:
     NoMBC(Cartridge &cart);
 
-    uint8_t romRead(uint16_t address) override;
-    void romWrite(uint16_t address, uint8_t value) override;
-};
\ No newline at end of file
+    void romWrite(uint16_t address, uint8_t value);
+};
@@ -0,0 +1,130 @@
+#include "rtc.h"
+
+#include "../gameboy.h"
+
+static constexpr uint64_t SECONDS_PER_DAY {24 * 60 * 60};
+
+void RTC::latch(uint64_t timestamp) {
+    update(timestamp);
+    m_latched = m_counters;
+}
+
+uint8_t RTC::read(uint8_t reg) const {
+    return readRegister(m_latched, reg);
+}
+
+void RTC::write(uint8_t reg, uint8_t value, uint64_t timestamp) {
+    update(timestamp);
+    writeRegister(m_counters, reg, value);
+
+    // Writing seconds resets the sub-second divider
+    if (reg == SECONDS) m_lastUpdate = timestamp;
+}
+
+void RTC::update(uint64_t timestamp) {
+    if (timestamp <= m_lastUpdate) return;
+
+    if (m_counters.halted) {
+        m_lastUpdate = timestamp;
+        return;
+    }
+
+    const uint64_t seconds = (timestamp - m_lastUpdate) / GameBoy::CYCLES_PER_SECOND;
+    m_lastUpdate += seconds * GameBoy::CYCLES_PER_SECOND;
+    advance(seconds);
+}
+
+void RTC::advance(uint64_t seconds) {
+    Registers& counters = m_counters;
+
+    // Counters set out of range by the game tick up to their bit width and wrap without carrying.
+    // Step one second at a time until they're back in range
+    while (seconds > 0 && (counters.seconds >= 60 || counters.minutes >= 60 || counters.hours >= 24)) {
+        seconds--;
+
+        counters.seconds = (counters.seconds + 1) & 0x3F;
+        if (counters.seconds != 60) continue;
+        counters.seconds = 0;
+
+        counters.minutes = (counters.minutes + 1) & 0x3F;
+        if (counters.minutes != 60) continue;
+        counters.minutes = 0;
+
+        counters.hours = (counters.hours + 1) & 0x1F;
+        if (counters.hours != 24) continue;
+        counters.hours = 0;
+
+        if (++counters.days == 512) {
+            counters.days = 0;
+            counters.dayCarry = true;
+        }
+    }
+    if (seconds == 0) return;
+
+    const uint64_t total = counters.days * SECONDS_PER_DAY + counters.hours * 3600 + counters.minutes * 60 + counters.seconds + seconds;
+    const uint64_t days = total / SECONDS_PER_DAY;
+
+    counters.seconds = total % 60;
+    counters.minutes = (total / 60) % 60;
+    counters.hours = (total / 3600) % 24;
+    counters.days = days % 512;
+    if (days >= 512) counters.dayCarry = true;
+}
+
+uint8_t RTC::readRegister(const Registers& registers, uint8_t reg) {
+    switch (reg) {
+        case SECONDS:   return registers.seconds;
+        case MINUTES:   return registers.minutes;
+        case HOURS:     return registers.hours;
+        case DAYS_LOW:  return registers.days & 0xFF;
+        case DAYS_HIGH: return (registers.days >> 8) | (registers.halted << 6) | (registers.dayCarry << 7);
+        default:        return 0xFF;
+    }
+}
+
+void RTC::writeRegister(Registers& registers, uint8_t reg, uint8_t value) {
+    switch (reg) {
+        case SECONDS:   registers.seconds = value & 0x3F; break;
+        case MINUTES:   registers.minutes = value & 0x3F; break;
+        case HOURS:     registers.hours = value & 0x1F; break;
+        case DAYS_LOW:  registers.days = (registers.days & 0x100) | value; break;
+        case DAYS_HIGH:
+            registers.days = (registers.days & 0xFF) | ((value & 0b1) << 8);
+            registers.halted = value & 0x40;
+            registers.dayCarry = value & 0x80;
+            break;
+    }
+}
+
+void RTC::saveFooter(std::span<uint8_t, FOOTER_SIZE> footer, int64_t unixTime, uint64_t timestamp) const {
+    RTC current {*this};
+    current.update(timestamp);
+
+    auto writeValue = [&](size_t offset, uint64_t value, size_t size) {
+        for (size_t i = 0; i < size; i++) footer[offset + i] = (value >> (i * 8)) & 0xFF;
+    };
+
+    for (uint8_t reg = SECONDS; reg <= DAYS_HIGH; reg++) {
+        writeValue((reg - SECONDS) * 4, readRegister(current.m_counters, reg), 4);
+        writeValue(20 + (reg - SECONDS) * 4, readRegister(current.m_latched, reg), 4);
+    }
+    writeValue(40, static_cast<uint64_t>(unixTime), 8);
+}
+
+void RTC::loadFooter(std::span<const uint8_t, FOOTER_SIZE> footer, int64_t unixTime, uint64_t timestamp) {
+    auto readValue = [&](size_t offset, size_t size) {
+        uint64_t value = 0;
+        for (size_t i = 0; i < size; i++) value |= static_cast<uint64_t>(footer[offset + i]) << (i * 8);
+        return value;
+    };
+
+    for (uint8_t reg = SECONDS; reg <= DAYS_HIGH; reg++) {
+        writeRegister(m_counters, reg, static_cast<uint8_t>(readValue((reg - SECONDS) * 4, 4)));
+        writeRegister(m_latched, reg, static_cast<uint8_t>(readValue(20 + (reg - SECONDS) * 4, 4)));
+    }
+    m_lastUpdate = timestamp;
+
+    // Clock kept running while the emulator was closed
+    const int64_t savedAt = static_cast<int64_t>(readValue(40, 8));
+    if (!m_counters.halted && unixTime > savedAt) advance(static_cast<uint64_t>(unixTime - savedAt));
+}
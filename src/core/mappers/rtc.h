@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+// MBC3 real time clock. Counts emulated M-cycles rather than wall-clock time, so fast-forwarded and batch runs
+// stay deterministic. Counters are only brought up to date when the game latches or writes them
+class RTC {
+public:
+    // Size of the footer appended to save files. Same layout as other emulators use:
+    // current S/M/H/DL/DH, latched S/M/H/DL/DH as little-endian u32s, then a little-endian u64 UNIX timestamp
+    static constexpr size_t FOOTER_SIZE {48};
+
+    // Register numbers as selected through $4000-$5FFF
+    static constexpr uint8_t SECONDS {0x08};
+    static constexpr uint8_t MINUTES {0x09};
+    static constexpr uint8_t HOURS {0x0A};
+    static constexpr uint8_t DAYS_LOW {0x0B};
+    static constexpr uint8_t DAYS_HIGH {0x0C};  // Bit 0 is day bit 8, bit 6 halts the clock, bit 7 is day overflow
+
+    // Brings counters up to date then copies them into the latched registers games read from
+    void latch(uint64_t timestamp);
+
+    // Reads latched register
+    uint8_t read(uint8_t reg) const;
+
+    // Writes counter register. Takes effect from timestamp
+    void write(uint8_t reg, uint8_t value, uint64_t timestamp);
+
+    // Serialises state at timestamp into save file footer. unixTime is the wall-clock time the save is written
+    void saveFooter(std::span<uint8_t, FOOTER_SIZE> footer, int64_t unixTime, uint64_t timestamp) const;
+
+    // Restores state from save file footer, moving the clock forward by the wall-clock time since it was saved.
+    // Timestamp is the current emulated time
+    void loadFooter(std::span<const uint8_t, FOOTER_SIZE> footer, int64_t unixTime, uint64_t timestamp);
+
+private:
+    struct Registers {
+        uint8_t seconds {};
+        uint8_t minutes {};
+        uint8_t hours {};
+        uint16_t days {};  // 9-bit
+        bool halted {false};
+        bool dayCarry {false};
+    };
+
+    Registers m_counters {};
+    Registers m_latched {};
+
+    uint64_t m_lastUpdate {0};  // Timestamp counters were last brought up to date at. Sub-second cycles carry over
+
+    // Brings counters up to timestamp
+    void update(uint64_t timestamp);
+
+    // Moves counters forward, matching hardware for out of range values
+    void advance(uint64_t seconds);
+
+    static uint8_t readRegister(const Registers& registers, uint8_t reg);
+    static void writeRegister(Registers& registers, uint8_t reg, uint8_t value);
+};
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <array>
+
+#include "common/types.h"
+
+// Static information about SM83 opcodes. Based on https://izik1.github.io/gbops/
+namespace opcodes {
+    // Number of bytes taken up by each opcode including immediate operands.
+    // STOP is treated as a single byte as its low power mode isn't emulated
+    inline constexpr std::array<u8, 256> LENGTHS {
+    //  0  1  2  3  4  5  6  7  8  9  A  B  C  D  E  F
+        1, 3, 1, 1, 1, 1, 2, 1, 3, 1, 1, 1, 1, 1, 2, 1, // 0
+        1, 3, 1, 1, 1, 1, 2, 1, 2, 1, 1, 1, 1, 1, 2, 1, // 1
+        2, 3, 1, 1, 1, 1, 2, 1, 2, 1, 1, 1, 1, 1, 2, 1, // 2
+        2, 3, 1, 1, 1, 1, 2, 1, 2, 1, 1, 1, 1, 1, 2, 1, // 3
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 4
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 5
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 6
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 7
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 8
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 9
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // A
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // B
+        1, 1, 3, 3, 3, 1, 2, 1, 1, 1, 3, 2, 3, 3, 2, 1, // C
+        1, 1, 3, 1, 3, 1, 2, 1, 1, 1, 3, 1, 3, 1, 2, 1, // D
+        2, 1, 1, 1, 1, 1, 2, 1, 2, 1, 3, 1, 1, 1, 2, 1, // E
+        2, 1, 1, 1, 1, 1, 2, 1, 2, 1, 3, 1, 1, 1, 2, 1, // F
+    };
+
+    // Number of M-cycles taken by each opcode. Conditional branches are counted as not taken.
+    // $CB is 0 as prefixed opcodes are covered by cyclesCB()
+    inline constexpr std::array<u8, 256> CYCLES {
+    //  0  1  2  3  4  5  6  7  8  9  A  B  C  D  E  F
+        1, 3, 2, 2, 1, 1, 2, 1, 5, 2, 2, 2, 1, 1, 2, 1, // 0
+        1, 3, 2, 2, 1, 1, 2, 1, 3, 2, 2, 2, 1, 1, 2, 1, // 1
+        2, 3, 2, 2, 1, 1, 2, 1, 2, 2, 2, 2, 1, 1, 2, 1, // 2
+        2, 3, 2, 2, 3, 3, 3, 1, 2, 2, 2, 2, 1, 1, 2, 1, // 3
+        1, 1, 1, 1, 1, 1, 2, 1, 1, 1, 1, 1, 1, 1, 2, 1, // 4
+        1, 1, 1, 1, 1, 1, 2, 1, 1, 1, 1, 1, 1, 1, 2, 1, // 5
+        1, 1, 1, 1, 1, 1, 2, 1, 1, 1, 1, 1, 1, 1, 2, 1, // 6
+        2, 2, 2, 2, 2, 2, 1, 2, 1, 1, 1, 1, 1, 1, 2, 1, // 7
+        1, 1, 1, 1, 1, 1, 2, 1, 1, 1, 1, 1, 1, 1, 2, 1, // 8
+        1, 1, 1, 1, 1, 1, 2, 1, 1, 1, 1, 1, 1, 1, 2, 1, // 9
+        1, 1, 1, 1, 1, 1, 2, 1, 1, 1, 1, 1, 1, 1, 2, 1, // A
+        1, 1, 1, 1, 1, 1, 2, 1, 1, 1, 1, 1, 1, 1, 2, 1, // B
+        2, 3, 3, 4, 3, 4, 2, 4, 2, 4, 3, 0, 3, 6, 2, 4, // C
+        2, 3, 3, 1, 3, 4, 2, 4, 2, 4, 3, 1, 3, 1, 2, 4, // D
+        3, 3, 2, 1, 1, 4, 2, 4, 4, 1, 4, 1, 1, 1, 2, 4, // E
+        3, 3, 2, 1, 1, 4, 2, 4, 3, 2, 4, 1, 1, 1, 2, 4, // F
+    };
+
+    // Extra M-cycles taken by conditional branches when the branch is taken
+    inline constexpr std::array<u8, 256> BRANCH_CYCLES = [] {
+        std::array<u8, 256> cycles {};
+        for (u8 opcode : {0x20, 0x28, 0x30, 0x38}) cycles[opcode] = 1;  // JR cc
+        for (u8 opcode : {0xC2, 0xCA, 0xD2, 0xDA}) cycles[opcode] = 1;  // JP cc
+        for (u8 opcode : {0xC4, 0xCC, 0xD4, 0xDC}) cycles[opcode] = 3;  // CALL cc
+        for (u8 opcode : {0xC0, 0xC8, 0xD0, 0xD8}) cycles[opcode] = 3;  // RET cc
+        return cycles;
+    }();
+
+    // Gets number of bytes taken up by an opcode and its immediate operands
+    constexpr u8 length(u8 opcode) {
+        return LENGTHS[opcode];
+    }
+
+    // Gets number of M-cycles taken by a $CB prefixed opcode, including the prefix
+    constexpr u8 cyclesCB(u8 opcode) {
+        if ((opcode & 0b111) != 6) return 2;             // Register operand
+        if (opcode >= 0x40 && opcode <= 0x7F) return 3;  // BIT n, (HL)
+        return 4;                                        // Read-modify-write of (HL)
+    }
+
+    // Gets number of M-cycles taken by an opcode. Operand is only used for $CB opcodes
+    constexpr u8 cycles(u8 opcode, u16 operand, bool branchTaken) {
+        if (opcode == 0xCB) return cyclesCB(static_cast<u8>(operand));
+        return CYCLES[opcode] + (branchTaken ? BRANCH_CYCLES[opcode] : 0);
+    }
+
+    // Where an opcode gets the address of memory it accesses. Stack accesses aren't counted
+    enum class AddressSource : u8 {
+        None,
+        BC,
+        DE,
+        HL,
+        Immediate,      // 16-bit immediate operand
+        HighImmediate,  // $FF00 + 8-bit immediate operand
+        HighC,          // $FF00 + C
+    };
+
+    // Gets where an opcode's memory address comes from. $CB opcodes use HL when bits 0-2 are 6
+    constexpr AddressSource addressSource(u8 opcode) {
+        switch (opcode) {
+        case 0x02: case 0x0A:
+            return AddressSource::BC;
+        case 0x12: case 0x1A:
+            return AddressSource::DE;
+        case 0x22: case 0x2A: case 0x32: case 0x3A: case 0x34: case 0x35: case 0x36:
+            return AddressSource::HL;
+        case 0x08: case 0xEA: case 0xFA:
+            return AddressSource::Immediate;
+        case 0xE0: case 0xF0:
+            return AddressSource::HighImmediate;
+        case 0xE2: case 0xF2:
+            return AddressSource::HighC;
+        default:
+            break;
+        }
+
+        // LD r, (HL) / LD (HL), r / ALU A, (HL). $76 is HALT
+        if (opcode >= 0x40 && opcode <= 0xBF && opcode != 0x76) {
+            if ((opcode & 0b111) == 6 || (opcode >= 0x70 && opcode <= 0x77)) return AddressSource::HL;
+        }
+        return AddressSource::None;
+    }
+
+    // Checks if an opcode writes to memory, including pushes onto the stack.
+    // $CB opcodes write whenever they use (HL) and aren't BIT
+    constexpr bool writesMemory(u8 opcode) {
+        switch (opcode) {
+        case 0x02: case 0x12: case 0x22: case 0x32: case 0x34: case 0x35: case 0x36: // (BC), (DE), (HL)
+        case 0x70: case 0x71: case 0x72: case 0x73: case 0x74: case 0x75: case 0x77:
+        case 0x08: case 0xE0: case 0xE2: case 0xEA:                                   // Immediate and high addresses
+        case 0xC5: case 0xD5: case 0xE5: case 0xF5:                                   // PUSH
+        case 0xC4: case 0xCC: case 0xCD: case 0xD4: case 0xDC:                        // CALL
+        case 0xC7: case 0xCF: case 0xD7: case 0xDF: case 0xE7: case 0xEF: case 0xF7: case 0xFF: // RST
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    // Checks if an opcode ends a straight-line run of code.
+    // This covers anything which can modify PC, alter interrupt handling or halt the CPU
+    constexpr bool endsBlock(u8 opcode) {
+        switch (opcode) {
+        case 0x10: case 0x76: case 0xF3: case 0xFB:                       // STOP, HALT, DI, EI
+        case 0x18: case 0x20: case 0x28: case 0x30: case 0x38:            // JR
+        case 0xC2: case 0xC3: case 0xCA: case 0xD2: case 0xDA: case 0xE9: // JP
+        case 0xC4: case 0xCC: case 0xCD: case 0xD4: case 0xDC:            // CALL
+        case 0xC0: case 0xC8: case 0xC9: case 0xD0: case 0xD8: case 0xD9: // RET, RETI
+        case 0xC7: case 0xCF: case 0xD7: case 0xDF:                       // RST
+        case 0xE7: case 0xEF: case 0xF7: case 0xFF:
+        case 0xD3: case 0xDB: case 0xDD: case 0xE3: case 0xE4: case 0xEB: // Illegal opcodes
+        case 0xEC: case 0xED: case 0xF4: case 0xFC: case 0xFD:
+            return true;
+        default:
+            return false;
+        }
+    }
+}
@@ -0,0 +1,340 @@
+#include "pixels.h"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef GBBUDDY_SIMD
+#include <immintrin.h>
+
+// MSVC allows any intrinsic without flags. GCC and Clang need AVX2 enabled per function
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define AVX2_TARGET
+#else
+#define AVX2_TARGET __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace {
+    using namespace pixels;
+
+    // Decodes pairs of planar bytes starting at pair
+    void decodeScalar(const u8* planar, u8* indices, usize pair, usize pairs) {
+        for (; pair < pairs; pair++) {
+            const u8 low {planar[pair * 2]};
+            const u8 high {planar[pair * 2 + 1]};
+            for (usize x {0}; x < 8; x++) {
+                const usize bit {7 - x};
+                indices[pair * 8 + x] = static_cast<u8>((((high >> bit) & 1) << 1) | ((low >> bit) & 1));
+            }
+        }
+    }
+
+    void applyPaletteScalar(const u8* indices, const Palette& palette, u32* colours, usize start, usize count) {
+        for (usize i {start}; i < count; i++) colours[i] = palette[indices[i]];
+    }
+
+    // Pointers to the start of each line given to composite()
+    struct CompositeLines {
+        const u8* bg;
+        const u8* sprites;
+        const u8* attributes;
+    };
+
+    // Reference version the vector kernels have to match
+    void compositeScalar(const CompositeLines& lines, const LinePalettes& palettes, bool bgPriority, u32* colours, usize start, usize count) {
+        for (usize i {start}; i < count; i++) {
+            colours[i] = palettes[compositeIndex(lines.bg[i], lines.sprites[i], lines.attributes[i], bgPriority)];
+        }
+    }
+
+#ifdef GBBUDDY_SIMD
+    // Each byte holds the bit of its bitplane byte for its pixel, leftmost pixel in bit 7
+    constexpr std::array<u8, 8> PIXEL_BITS {0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01};
+
+    // Turns bytes broadcast from bitplanes into colour indices. Each byte of low and high holds a whole bitplane
+    // byte, and the mask picks out the bit for that pixel
+    __m128i combinePlanes(__m128i low, __m128i high, __m128i mask) {
+        const __m128i lowBits {_mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(low, mask), mask), _mm_set1_epi8(1))};
+        const __m128i highBits {_mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(high, mask), mask), _mm_set1_epi8(2))};
+        return _mm_or_si128(lowBits, highBits);
+    }
+
+    // 16 pixels per iteration from 4 planar bytes
+    void decodeSSE2(const u8* planar, u8* indices, usize pairs) {
+        u64 maskBits {};
+        std::memcpy(&maskBits, PIXEL_BITS.data(), sizeof(maskBits));
+        const __m128i mask {_mm_set1_epi64x(static_cast<i64>(maskBits))};
+
+        usize pair {0};
+        for (; pair + 2 <= pairs; pair += 2) {
+            i32 bytes {};
+            std::memcpy(&bytes, planar + pair * 2, sizeof(bytes));
+
+            // Spread L0 H0 L1 H1 out until each byte fills 8 lanes, then gather the low and high bitplanes
+            __m128i spread {_mm_cvtsi32_si128(bytes)};
+            spread = _mm_unpacklo_epi8(spread, spread);
+            spread = _mm_unpacklo_epi16(spread, spread);
+            const __m128i first {_mm_unpacklo_epi32(spread, spread)};   // L0 x8, H0 x8
+            const __m128i second {_mm_unpackhi_epi32(spread, spread)};  // L1 x8, H1 x8
+
+            const __m128i result {combinePlanes(_mm_unpacklo_epi64(first, second), _mm_unpackhi_epi64(first, second), mask)};
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(indices + pair * 8), result);
+        }
+
+        decodeScalar(planar, indices, pair, pairs);
+    }
+
+    // 32 pixels per iteration from 8 planar bytes. A shuffle broadcasts each bitplane byte to the 8 lanes it covers
+    AVX2_TARGET void decodeAVX2(const u8* planar, u8* indices, usize pairs) {
+        u64 maskBits {};
+        std::memcpy(&maskBits, PIXEL_BITS.data(), sizeof(maskBits));
+        const __m256i mask {_mm256_set1_epi64x(static_cast<i64>(maskBits))};
+
+        // Shuffles work within 128-bit lanes, and both lanes get all 8 bytes
+        const __m256i lowShuffle {_mm256_setr_epi8(
+            0, 0, 0, 0, 0, 0, 0, 0, 2, 2, 2, 2, 2, 2, 2, 2,
+            4, 4, 4, 4, 4, 4, 4, 4, 6, 6, 6, 6, 6, 6, 6, 6)};
+        const __m256i highShuffle {_mm256_add_epi8(lowShuffle, _mm256_set1_epi8(1))};
+
+        usize pair {0};
+        for (; pair + 4 <= pairs; pair += 4) {
+            i64 bytes {};
+            std::memcpy(&bytes, planar + pair * 2, sizeof(bytes));
+            const __m256i broadcast {_mm256_set1_epi64x(bytes)};
+
+            const __m256i low {_mm256_shuffle_epi8(broadcast, lowShuffle)};
+            const __m256i high {_mm256_shuffle_epi8(broadcast, highShuffle)};
+            const __m256i lowBits {_mm256_and_si256(_mm256_cmpeq_epi8(_mm256_and_si256(low, mask), mask), _mm256_set1_epi8(1))};
+            const __m256i highBits {_mm256_and_si256(_mm256_cmpeq_epi8(_mm256_and_si256(high, mask), mask), _mm256_set1_epi8(2))};
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(indices + pair * 8), _mm256_or_si256(lowBits, highBits));
+        }
+
+        // Leftover pairs still get the SSE2 path before falling back to scalar
+        decodeSSE2(planar + pair * 2, indices + pair * 8, pairs - pair);
+    }
+
+    // 16 pixels per iteration. SSE2 has no byte shuffle, so each colour is selected by comparing against each index
+    void applyPaletteSSE2(const u8* indices, const Palette& palette, u32* colours, usize count) {
+        const __m128i colour0 {_mm_set1_epi32(static_cast<i32>(palette[0]))};
+        const __m128i colour1 {_mm_set1_epi32(static_cast<i32>(palette[1]))};
+        const __m128i colour2 {_mm_set1_epi32(static_cast<i32>(palette[2]))};
+        const __m128i colour3 {_mm_set1_epi32(static_cast<i32>(palette[3]))};
+        const __m128i zero {_mm_setzero_si128()};
+
+        // Looks up 4 indices which have been widened to 32 bits
+        const auto lookup = [&](__m128i index) {
+            const __m128i result {_mm_and_si128(_mm_cmpeq_epi32(index, zero), colour0)};
+            const __m128i result1 {_mm_and_si128(_mm_cmpeq_epi32(index, _mm_set1_epi32(1)), colour1)};
+            const __m128i result2 {_mm_and_si128(_mm_cmpeq_epi32(index, _mm_set1_epi32(2)), colour2)};
+            const __m128i result3 {_mm_and_si128(_mm_cmpeq_epi32(index, _mm_set1_epi32(3)), colour3)};
+            return _mm_or_si128(_mm_or_si128(result, result1), _mm_or_si128(result2, result3));
+        };
+
+        usize i {0};
+        for (; i + 16 <= count; i += 16) {
+            const __m128i bytes {_mm_loadu_si128(reinterpret_cast<const __m128i*>(indices + i))};
+            const __m128i low {_mm_unpacklo_epi8(bytes, zero)};
+            const __m128i high {_mm_unpackhi_epi8(bytes, zero)};
+
+            auto* out {reinterpret_cast<__m128i*>(colours + i)};
+            _mm_storeu_si128(out, lookup(_mm_unpacklo_epi16(low, zero)));
+            _mm_storeu_si128(out + 1, lookup(_mm_unpackhi_epi16(low, zero)));
+            _mm_storeu_si128(out + 2, lookup(_mm_unpacklo_epi16(high, zero)));
+            _mm_storeu_si128(out + 3, lookup(_mm_unpackhi_epi16(high, zero)));
+        }
+
+        applyPaletteScalar(indices, palette, colours, i, count);
+    }
+
+    // Up to 16 colours split into one table per byte, so each byte can be looked up with a shuffle.
+    // Tables are copied into both 128-bit lanes as shuffles can't cross them
+    struct ColourTableAVX2 {
+        __m256i byte0;
+        __m256i byte1;
+        __m256i byte2;
+        __m256i byte3;
+    };
+
+    AVX2_TARGET ColourTableAVX2 makeColourTable(std::span<const u32> colours) {
+        alignas(16) std::array<std::array<u8, 16>, 4> planes {};
+        for (usize entry {0}; entry < std::min<usize>(colours.size(), 16); entry++) {
+            for (usize plane {0}; plane < planes.size(); plane++) planes[plane][entry] = static_cast<u8>(colours[entry] >> (plane * 8));
+        }
+
+        const auto broadcast = [&](usize plane) { return _mm_load_si128(reinterpret_cast<const __m128i*>(planes[plane].data())); };
+        return {
+            .byte0 = _mm256_broadcastsi128_si256(broadcast(0)),
+            .byte1 = _mm256_broadcastsi128_si256(broadcast(1)),
+            .byte2 = _mm256_broadcastsi128_si256(broadcast(2)),
+            .byte3 = _mm256_broadcastsi128_si256(broadcast(3)),
+        };
+    }
+
+    // Looks up colours of 32 indices, then interleaves the 4 byte planes back into whole colours
+    AVX2_TARGET void lookupAVX2(__m256i index, const ColourTableAVX2& table, u32* colours) {
+        const __m256i byte0 {_mm256_shuffle_epi8(table.byte0, index)};
+        const __m256i byte1 {_mm256_shuffle_epi8(table.byte1, index)};
+        const __m256i byte2 {_mm256_shuffle_epi8(table.byte2, index)};
+        const __m256i byte3 {_mm256_shuffle_epi8(table.byte3, index)};
+
+        // Unpacks stay within 128-bit lanes, so the low lane ends up with pixels 0-15 and the high lane 16-31
+        const __m256i low01 {_mm256_unpacklo_epi8(byte0, byte1)};
+        const __m256i high01 {_mm256_unpackhi_epi8(byte0, byte1)};
+        const __m256i low23 {_mm256_unpacklo_epi8(byte2, byte3)};
+        const __m256i high23 {_mm256_unpackhi_epi8(byte2, byte3)};
+
+        const __m256i pixels0 {_mm256_unpacklo_epi16(low01, low23)};    // 0-3 and 16-19
+        const __m256i pixels4 {_mm256_unpackhi_epi16(low01, low23)};    // 4-7 and 20-23
+        const __m256i pixels8 {_mm256_unpacklo_epi16(high01, high23)};  // 8-11 and 24-27
+        const __m256i pixels12 {_mm256_unpackhi_epi16(high01, high23)}; // 12-15 and 28-31
+
+        auto* out {reinterpret_cast<__m256i*>(colours)};
+        _mm256_storeu_si256(out, _mm256_permute2x128_si256(pixels0, pixels4, 0x20));
+        _mm256_storeu_si256(out + 1, _mm256_permute2x128_si256(pixels8, pixels12, 0x20));
+        _mm256_storeu_si256(out + 2, _mm256_permute2x128_si256(pixels0, pixels4, 0x31));
+        _mm256_storeu_si256(out + 3, _mm256_permute2x128_si256(pixels8, pixels12, 0x31));
+    }
+
+    // 32 pixels per iteration
+    AVX2_TARGET void applyPaletteAVX2(const u8* indices, const Palette& palette, u32* colours, usize count) {
+        const ColourTableAVX2 table {makeColourTable(palette)};
+
+        usize i {0};
+        for (; i + 32 <= count; i += 32) {
+            lookupAVX2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(indices + i)), table, colours + i);
+        }
+
+        applyPaletteSSE2(indices + i, palette, colours + i, count - i);
+    }
+
+    // Same as compositeIndex() for 16 pixels at once. bgPriority is all set bits if the background can cover sprites
+    __m128i compositeIndicesSSE2(__m128i bg, __m128i sprite, __m128i attributes, __m128i bgPriority) {
+        const __m128i zero {_mm_setzero_si128()};
+        const __m128i behindBit {_mm_set1_epi8(static_cast<char>(BEHIND_BG))};
+        const __m128i paletteBit {_mm_set1_epi8(static_cast<char>(OBJ_PALETTE_1))};
+
+        // Sprite loses where it's transparent, or where it's behind background which isn't colour 0
+        const __m128i behind {_mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(attributes, behindBit), behindBit), bgPriority)};
+        const __m128i covered {_mm_andnot_si128(_mm_cmpeq_epi8(bg, zero), behind)};
+        const __m128i hidden {_mm_or_si128(_mm_cmpeq_epi8(sprite, zero), covered)};
+
+        const __m128i palette1 {_mm_cmpeq_epi8(_mm_and_si128(attributes, paletteBit), paletteBit)};
+        const __m128i spriteIndex {_mm_add_epi8(_mm_add_epi8(sprite, _mm_set1_epi8(4)), _mm_and_si128(palette1, _mm_set1_epi8(4)))};
+
+        return _mm_or_si128(_mm_and_si128(hidden, bg), _mm_andnot_si128(hidden, spriteIndex));
+    }
+
+    AVX2_TARGET __m256i compositeIndicesAVX2(__m256i bg, __m256i sprite, __m256i attributes, __m256i bgPriority) {
+        const __m256i zero {_mm256_setzero_si256()};
+        const __m256i behindBit {_mm256_set1_epi8(static_cast<char>(BEHIND_BG))};
+        const __m256i paletteBit {_mm256_set1_epi8(static_cast<char>(OBJ_PALETTE_1))};
+
+        const __m256i behind {_mm256_and_si256(_mm256_cmpeq_epi8(_mm256_and_si256(attributes, behindBit), behindBit), bgPriority)};
+        const __m256i covered {_mm256_andnot_si256(_mm256_cmpeq_epi8(bg, zero), behind)};
+        const __m256i hidden {_mm256_or_si256(_mm256_cmpeq_epi8(sprite, zero), covered)};
+
+        const __m256i palette1 {_mm256_cmpeq_epi8(_mm256_and_si256(attributes, paletteBit), paletteBit)};
+        const __m256i spriteIndex {_mm256_add_epi8(_mm256_add_epi8(sprite, _mm256_set1_epi8(4)), _mm256_and_si256(palette1, _mm256_set1_epi8(4)))};
+
+        return _mm256_blendv_epi8(spriteIndex, bg, hidden);
+    }
+
+    // 16 pixels per iteration. Priority is resolved with vectors, but colours are still looked up one at a time
+    // as SSE2 has no byte shuffle
+    void compositeSSE2(const CompositeLines& lines, const LinePalettes& palettes, bool bgPriority, u32* colours, usize count) {
+        const __m128i priority {bgPriority ? _mm_set1_epi8(-1) : _mm_setzero_si128()};
+
+        usize i {0};
+        for (; i + 16 <= count; i += 16) {
+            const auto load = [&](const u8* line) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(line + i)); };
+            const __m128i indices {compositeIndicesSSE2(load(lines.bg), load(lines.sprites), load(lines.attributes), priority)};
+
+            alignas(16) std::array<u8, 16> merged {};
+            _mm_store_si128(reinterpret_cast<__m128i*>(merged.data()), indices);
+            for (usize pixel {0}; pixel < merged.size(); pixel++) colours[i + pixel] = palettes[merged[pixel]];
+        }
+
+        compositeScalar(lines, palettes, bgPriority, colours, i, count);
+    }
+
+    // 32 pixels per iteration. Merged indices go straight into a shuffle lookup of all 12 colours
+    AVX2_TARGET void compositeAVX2(const CompositeLines& lines, const LinePalettes& palettes, bool bgPriority, u32* colours, usize count) {
+        const ColourTableAVX2 table {makeColourTable(palettes)};
+        const __m256i priority {bgPriority ? _mm256_set1_epi8(-1) : _mm256_setzero_si256()};
+
+        usize i {0};
+        for (; i + 32 <= count; i += 32) {
+            const __m256i bg {_mm256_loadu_si256(reinterpret_cast<const __m256i*>(lines.bg + i))};
+            const __m256i sprites {_mm256_loadu_si256(reinterpret_cast<const __m256i*>(lines.sprites + i))};
+            const __m256i attributes {_mm256_loadu_si256(reinterpret_cast<const __m256i*>(lines.attributes + i))};
+            lookupAVX2(compositeIndicesAVX2(bg, sprites, attributes, priority), table, colours + i);
+        }
+
+        compositeScalar(lines, palettes, bgPriority, colours, i, count);
+    }
+#endif
+
+    Isa detectIsa() {
+#ifdef GBBUDDY_SIMD
+#if defined(_MSC_VER) && !defined(__clang__)
+        // AVX2 also needs the OS to save YMM registers
+        std::array<int, 4> info {};
+        __cpuid(info.data(), 1);
+        const bool osSavesYmm {(info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 0x6) == 0x6};
+        __cpuidex(info.data(), 7, 0);
+        const bool avx2 {osSavesYmm && (info[1] & (1 << 5)) != 0};
+#else
+        const bool avx2 {__builtin_cpu_supports("avx2") != 0};
+#endif
+        return avx2 ? Isa::AVX2 : Isa::SSE2;  // SSE2 is part of x86-64
+#else
+        return Isa::Scalar;
+#endif
+    }
+}
+
+namespace pixels {
+    Isa hostIsa() {
+        static const Isa isa {detectIsa()};
+        return isa;
+    }
+
+    void decode(std::span<const u8> planar, std::span<u8> indices, Isa isa) {
+        const usize pairs {std::min(planar.size() / 2, indices.size() / 8)};
+
+        switch (isa) {
+#ifdef GBBUDDY_SIMD
+            case Isa::AVX2: decodeAVX2(planar.data(), indices.data(), pairs); break;
+            case Isa::SSE2: decodeSSE2(planar.data(), indices.data(), pairs); break;
+#endif
+            default: decodeScalar(planar.data(), indices.data(), 0, pairs); break;
+        }
+    }
+
+    void applyPalette(std::span<const u8> indices, const Palette& palette, std::span<u32> colours, Isa isa) {
+        const usize count {std::min(indices.size(), colours.size())};
+
+        switch (isa) {
+#ifdef GBBUDDY_SIMD
+            case Isa::AVX2: applyPaletteAVX2(indices.data(), palette, colours.data(), count); break;
+            case Isa::SSE2: applyPaletteSSE2(indices.data(), palette, colours.data(), count); break;
+#endif
+            default: applyPaletteScalar(indices.data(), palette, colours.data(), 0, count); break;
+        }
+    }
+
+    void composite(std::span<const u8> bgIndices, std::span<const u8> spriteIndices, std::span<const u8> spriteAttributes,
+                   const LinePalettes& palettes, bool bgPriority, std::span<u32> colours, Isa isa) {
+        const usize count {std::min({bgIndices.size(), spriteIndices.size(), spriteAttributes.size(), colours.size()})};
+        const CompositeLines lines {.bg = bgIndices.data(), .sprites = spriteIndices.data(), .attributes = spriteAttributes.data()};
+
+        switch (isa) {
+#ifdef GBBUDDY_SIMD
+            case Isa::AVX2: compositeAVX2(lines, palettes, bgPriority, colours.data(), count); break;
+            case Isa::SSE2: compositeSSE2(lines, palettes, bgPriority, colours.data(), count); break;
+#endif
+            default: compositeScalar(lines, palettes, bgPriority, colours.data(), 0, count); break;
+        }
+    }
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <array>
+#include <span>
+
+#include "common/types.h"
+
+// Kernels for turning 2bpp tile data into pixels. Each has a scalar version, plus SSE2 and AVX2 versions when
+// built with SIMD on an x86-64 host. The best one the host supports is picked at runtime
+namespace pixels {
+    enum class Isa : u8 {
+        Scalar,
+        SSE2,
+        AVX2,
+    };
+
+    // RGBA8888 colour for each of the 4 colour indices
+    using Palette = std::array<u32, 4>;
+
+    // Background palette followed by both sprite palettes. Composited pixels index into this
+    using LinePalettes = std::array<u32, 12>;
+
+    // Sprite attribute bits used when compositing
+    inline constexpr u8 BEHIND_BG {0x80};      // Background colours 1-3 cover the sprite
+    inline constexpr u8 OBJ_PALETTE_1 {0x10};  // Uses the second sprite palette
+
+    // Gets best instruction set supported by the host. Always Scalar if SIMD kernels weren't built
+    Isa hostIsa();
+
+    // Decodes 2bpp planar data into one colour index per pixel, leftmost pixel first.
+    // Data is pairs of low and high bitplane bytes like in VRAM, so indices must hold 4 entries per byte.
+    // A whole 160 pixel line is 40 bytes
+    void decode(std::span<const u8> planar, std::span<u8> indices, Isa isa = hostIsa());
+
+    // Looks up colour of each colour index, which must be 0-3. colours must be as long as indices
+    void applyPalette(std::span<const u8> indices, const Palette& palette, std::span<u32> colours, Isa isa = hostIsa());
+
+    // Gets which of the line palettes' colours a pixel shows. Sprite colour 0 is transparent.
+    // Without background priority, like on GBC with LCDC bit 0 clear, sprites are always on top
+    constexpr u8 compositeIndex(u8 bgIndex, u8 spriteIndex, u8 spriteAttributes, bool bgPriority) {
+        if (spriteIndex == 0) return bgIndex;
+        if (bgPriority && (spriteAttributes & BEHIND_BG) != 0 && bgIndex != 0) return bgIndex;
+        return static_cast<u8>(((spriteAttributes & OBJ_PALETTE_1) != 0 ? 8 : 4) + spriteIndex);
+    }
+
+    // Merges background and sprite lines into colours using compositeIndex(). Sprite index 0 means no sprite.
+    // Resolves whole vectors of pixels at once with masks instead of branching on each one
+    void composite(std::span<const u8> bgIndices, std::span<const u8> spriteIndices, std::span<const u8> spriteAttributes,
+                   const LinePalettes& palettes, bool bgPriority, std::span<u32> colours, Isa isa = hostIsa());
+
+    // Gets colours picked by a DMG palette register like BGP, OBP0 or OBP1 out of the 4 shades
+    constexpr Palette dmgPalette(u8 value, const Palette& shades) {
+        return {shades[value & 0b11], shades[(value >> 2) & 0b11], shades[(value >> 4) & 0b11], shades[(value >> 6) & 0b11]};
+    }
+
+    // Gets colours of a GBC palette from its 4 little-endian RGB555 entries in palette RAM
+    constexpr Palette cgbPalette(std::span<const u8, 8> data) {
+        Palette palette {};
+        for (usize i {0}; i < palette.size(); i++) {
+            const u16 colour {static_cast<u16>(data[i * 2] | (data[i * 2 + 1] << 8))};
+
+            // Scale 5-bit channels up to 8 bits by repeating the top bits
+            const auto channel = [&](u8 shift) { const u32 value {(colour >> shift) & 0x1Fu}; return (value << 3) | (value >> 2); };
+            palette[i] = (channel(0) << 24) | (channel(5) << 16) | (channel(10) << 8) | 0xFF;
+        }
+        return palette;
+    }
+}
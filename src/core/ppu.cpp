@@ -0,0 +1,447 @@
+#include "ppu.h"
+
+#include <algorithm>
+
+#include "gameboy.h"
+#include "pixels.h"
+
+namespace {
+    constexpr u8 VBLANK_INTERRUPT {0x01};
+    constexpr u8 STAT_INTERRUPT {0x02};
+    constexpr u16 IF_ADDRESS {0xFF0F};
+
+    // LCDC bits
+    constexpr u8 LCD_ENABLE {0x80};
+    constexpr u8 WINDOW_MAP {0x40};
+    constexpr u8 WINDOW_ENABLE {0x20};
+    constexpr u8 TILE_DATA {0x10};  // Set for unsigned tile numbers from $8000
+    constexpr u8 BG_MAP {0x08};
+    constexpr u8 SPRITE_SIZE {0x04};
+    constexpr u8 SPRITE_ENABLE {0x02};
+    constexpr u8 BG_ENABLE {0x01};
+
+    // Sprite attribute bits. Priority and palette bits are in pixels.h as the compositor uses them
+    constexpr u8 FLIP_Y {0x40};
+    constexpr u8 FLIP_X {0x20};
+
+    // Gets index from $8000 of a tile number in a map. $8000 addressing uses tile numbers as is,
+    // $8800 addressing treats them as signed offsets from $9000
+    usize tileIndex(u8 tile, u8 lcdc) {
+        return (lcdc & TILE_DATA) != 0 ? tile : static_cast<usize>(256 + static_cast<i8>(tile));
+    }
+
+    u8 paletteShade(u8 palette, u8 index) {
+        return (palette >> (index * 2)) & 0b11;
+    }
+}
+
+PPU::PPU(GameBoy& gb)
+    : m_gb(gb)
+{
+    m_gb.scheduler.setHandler(EventType::PPULineIncrement, [](void* context, u64 timestamp) {
+        static_cast<PPU*>(context)->startLine(timestamp);
+    }, this);
+    m_gb.scheduler.setHandler(EventType::PPUModeChange, [](void* context, u64 timestamp) {
+        static_cast<PPU*>(context)->changeMode(timestamp);
+    }, this);
+}
+
+void PPU::reset() {
+    RealBus& bus {m_gb.bus};
+
+    bus.setIORegister(LCDC_ADDRESS, {
+        .context = this,
+        .read = [](void* context, u16) { return static_cast<PPU*>(context)->m_lcdc; },
+        .write = [](void* context, u16, u8 value) { static_cast<PPU*>(context)->writeLcdc(value); },
+    });
+    bus.setIORegister(STAT_ADDRESS, {
+        .context = this,
+        .read = [](void* context, u16) {
+            const auto* ppu {static_cast<PPU*>(context)};
+            return static_cast<u8>(ppu->m_statSelect | (ppu->m_ly == ppu->m_lyc ? 0x04 : 0x00) | static_cast<u8>(ppu->m_mode));
+        },
+        .write = [](void* context, u16, u8 value) {
+            auto* ppu {static_cast<PPU*>(context)};
+            ppu->m_statSelect = value & 0x78;
+            ppu->updateStat();
+        },
+        .readMask = 0x7F,
+        .writeMask = 0x78,
+    });
+    bus.setIORegister(LY_ADDRESS, {
+        .context = this,
+        .read = [](void* context, u16) { return static_cast<PPU*>(context)->m_ly; },
+        .writeMask = 0x00,
+    });
+    // Rendering registers are plain storage apart from logging writes made mid-line
+    for (u16 address : {SCY_ADDRESS, SCX_ADDRESS, BGP_ADDRESS, OBP0_ADDRESS, OBP1_ADDRESS, WY_ADDRESS, WX_ADDRESS}) {
+        bus.setIORegister(address, {
+            .context = this,
+            .write = [](void* context, u16 address, u8 value) { static_cast<PPU*>(context)->logWrite(address, value); },
+        });
+    }
+    bus.setIORegister(LYC_ADDRESS, {
+        .context = this,
+        .write = [](void* context, u16, u8 value) {
+            auto* ppu {static_cast<PPU*>(context)};
+            ppu->m_lyc = value;
+            ppu->updateStat();
+        },
+    });
+
+    m_framebuffer.fill(SHADES[0]);
+    m_frameCount = 0;
+    m_statSelect = 0;
+    m_statLine = false;
+    m_lyc = 0;
+    m_lcdc = 0;
+    m_lineWrites.clear();
+    m_frameStats = {};
+    m_lastFrameStats = {};
+
+    bus.write(SCY_ADDRESS, 0x00);
+    bus.write(SCX_ADDRESS, 0x00);
+    bus.write(LYC_ADDRESS, 0x00);
+    bus.write(BGP_ADDRESS, 0xFC);
+    bus.write(WY_ADDRESS, 0x00);
+    bus.write(WX_ADDRESS, 0x00);
+    writeLcdc(0x91);
+}
+
+void PPU::writeLcdc(u8 value) {
+    logWrite(LCDC_ADDRESS, value);
+
+    const bool wasEnabled {(m_lcdc & LCD_ENABLE) != 0};
+    m_lcdc = value;
+    const bool enabled {(m_lcdc & LCD_ENABLE) != 0};
+    if (enabled == wasEnabled) return;
+
+    Scheduler& scheduler {m_gb.scheduler};
+
+    if (!enabled) {
+        // Switched off LCD sits at the start of line 0 in H-blank
+        scheduler.cancel(EventType::PPULineIncrement);
+        scheduler.cancel(EventType::PPUModeChange);
+        m_ly = 0;
+        m_mode = Mode::HBlank;
+        updateStat();
+        return;
+    }
+
+    // Starts drawing from line 0. CPU has to stop at the new deadlines
+    const u64 now {m_gb.currentTime()};
+    m_ly = 0;
+    m_windowLine = 0;
+    m_mode = Mode::OAMScan;
+    scheduler.scheduleAt(EventType::PPUModeChange, now + OAM_SCAN_CYCLES);
+    scheduler.scheduleAt(EventType::PPULineIncrement, now + LINE_CYCLES);
+    m_gb.cpu.endRun();
+    updateStat();
+}
+
+void PPU::logWrite(u16 address, u8 value) {
+    if (m_mode != Mode::Drawing) return;
+
+    // Current time counts every instruction before the one doing the write, even part way through a block
+    const u32 dot {static_cast<u32>((m_gb.currentTime() - m_drawingStart) * DOTS_PER_CYCLE)};
+    m_lineWrites.push_back({.dot = dot, .address = address, .value = value});
+}
+
+void PPU::startLine(u64 timestamp) {
+    m_ly = static_cast<u8>((m_ly + 1) % LINE_COUNT);
+    m_gb.scheduler.scheduleAt(EventType::PPULineIncrement, timestamp + LINE_CYCLES);
+
+    if (m_ly < SCREEN_HEIGHT) {
+        if (m_ly == 0) m_windowLine = 0;
+        m_mode = Mode::OAMScan;
+        m_gb.scheduler.scheduleAt(EventType::PPUModeChange, timestamp + OAM_SCAN_CYCLES);
+    } else if (m_ly == SCREEN_HEIGHT) {
+        m_mode = Mode::VBlank;
+        m_frameCount++;
+        m_lastFrameStats = m_frameStats;
+        m_frameStats = {};
+        requestInterrupt(VBLANK_INTERRUPT);
+    }
+
+    updateStat();
+}
+
+void PPU::changeMode(u64 timestamp) {
+    if (m_mode == Mode::OAMScan) {
+        m_lineRegisters = {
+            .lcdc = m_lcdc,
+            .scx = readRegister(SCX_ADDRESS),
+            .scy = readRegister(SCY_ADDRESS),
+            .wx = readRegister(WX_ADDRESS),
+            .wy = readRegister(WY_ADDRESS),
+            .bgp = readRegister(BGP_ADDRESS),
+            .obp0 = readRegister(OBP0_ADDRESS),
+            .obp1 = readRegister(OBP1_ADDRESS),
+        };
+        m_lineWrites.clear();
+        m_drawingStart = timestamp;
+
+        m_mode = Mode::Drawing;
+        m_gb.scheduler.scheduleAt(EventType::PPUModeChange, timestamp + DRAWING_CYCLES);
+        return;  // Drawing has no STAT interrupt
+    }
+
+    renderLine();
+    m_mode = Mode::HBlank;
+    m_gb.dma.hblank();
+    updateStat();
+}
+
+void PPU::updateStat() {
+    const bool line {
+        ((m_statSelect & 0x40) != 0 && m_ly == m_lyc) ||
+        ((m_statSelect & 0x08) != 0 && m_mode == Mode::HBlank) ||
+        ((m_statSelect & 0x10) != 0 && m_mode == Mode::VBlank) ||
+        ((m_statSelect & 0x20) != 0 && m_mode == Mode::OAMScan)
+    };
+
+    if (line && !m_statLine) requestInterrupt(STAT_INTERRUPT);
+    m_statLine = line;
+}
+
+void PPU::requestInterrupt(u8 mask) {
+    m_gb.bus.write(IF_ADDRESS, m_gb.bus.read(IF_ADDRESS) | mask);
+}
+
+void PPU::renderLine() {
+    const std::span<u32, SCREEN_WIDTH> line {m_framebuffer.data() + m_ly * SCREEN_WIDTH, SCREEN_WIDTH};
+
+    if (m_lineWrites.empty()) {
+        renderLineFast(line);
+        m_frameStats.fastLines++;
+    } else {
+        renderLineFifo(line);
+        m_frameStats.fifoLines++;
+    }
+}
+
+void PPU::renderLineFast(std::span<u32, SCREEN_WIDTH> line) {
+    const LineRegisters& registers {m_lineRegisters};
+    std::array<u8, SCREEN_WIDTH> indices {};  // Background/window colour index of each pixel
+
+    if ((registers.lcdc & BG_ENABLE) != 0) {
+        const u16 bgMap {static_cast<u16>((registers.lcdc & BG_MAP) != 0 ? 0x9C00 : 0x9800)};
+        renderTiles(indices, 0, bgMap, registers.scx, static_cast<u8>(registers.scy + m_ly), registers.lcdc);
+
+        // Window covers everything right of WX - 7 once LY has reached WY
+        if ((registers.lcdc & WINDOW_ENABLE) != 0 && m_ly >= registers.wy && registers.wx < SCREEN_WIDTH + 7) {
+            const u16 windowMap {static_cast<u16>((registers.lcdc & WINDOW_MAP) != 0 ? 0x9C00 : 0x9800)};
+            const usize startX {static_cast<usize>(std::max(registers.wx - 7, 0))};
+            renderTiles(indices, startX, windowMap, static_cast<u8>(startX + 7 - registers.wx), m_windowLine, registers.lcdc);
+            m_windowLine++;
+        }
+    }
+
+    const pixels::Palette bgPalette {pixels::dmgPalette(registers.bgp, SHADES)};
+
+    SpriteLine sprites {};
+    if ((registers.lcdc & SPRITE_ENABLE) == 0 || !resolveSprites(sprites, registers.lcdc)) {
+        // Nothing to mix in, so it's a straight palette lookup
+        pixels::applyPalette(indices, bgPalette, line);
+        return;
+    }
+
+    const std::array<pixels::Palette, 3> parts {
+        bgPalette,
+        pixels::dmgPalette(registers.obp0, SHADES),
+        pixels::dmgPalette(registers.obp1, SHADES),
+    };
+    pixels::LinePalettes palettes {};
+    for (usize i {0}; i < palettes.size(); i++) palettes[i] = parts[i / 4][i % 4];
+
+    // DMG background always covers sprites behind it. Disabling it already leaves every index at 0
+    pixels::composite(indices, sprites.colours, sprites.attributes, palettes, true, line);
+}
+
+void PPU::renderLineFifo(std::span<u32, SCREEN_WIDTH> line) {
+    // Line shouldn't take anywhere near this long. Stops a runaway if the window keeps restarting
+    static constexpr u32 MAX_DOTS {1024};
+
+    LineRegisters registers {m_lineRegisters};
+    usize nextWrite {0};
+
+    SpriteLine sprites {};
+    resolveSprites(sprites, registers.lcdc);
+
+    // Background FIFO. Only ever holds up to 8 pixels as the fetcher waits for it to empty
+    std::array<u8, 8> fifo {};
+    usize fifoSize {0};
+    usize fifoHead {0};
+
+    // Fetcher takes 2 dots each for tile number, low byte and high byte, then pushes once the FIFO is empty.
+    // First fetch of the line gets thrown away like on hardware, which delays output by a tile
+    u32 fetchStep {0};
+    u8 fetchX {0};
+    u8 tile {0};
+    const u8* row {nullptr};
+    bool dummyFetch {true};
+    bool window {false};
+
+    usize discard {registers.scx % 8u};  // Fine scroll drops pixels from the first tile
+    usize x {0};
+    const u8* vram {m_gb.bus.vram(0)};
+    TileCache& tiles {m_gb.bus.tiles()};
+
+    for (u32 dot {0}; x < SCREEN_WIDTH && dot < MAX_DOTS; dot++) {
+        while (nextWrite < m_lineWrites.size() && m_lineWrites[nextWrite].dot <= dot) {
+            const LineWrite& write {m_lineWrites[nextWrite++]};
+            switch (write.address) {
+                case LCDC_ADDRESS: registers.lcdc = write.value; break;
+                case SCX_ADDRESS:  registers.scx = write.value; break;
+                case SCY_ADDRESS:  registers.scy = write.value; break;
+                case WX_ADDRESS:   registers.wx = write.value; break;
+                case WY_ADDRESS:   registers.wy = write.value; break;
+                case BGP_ADDRESS:  registers.bgp = write.value; break;
+                case OBP0_ADDRESS: registers.obp0 = write.value; break;
+                case OBP1_ADDRESS: registers.obp1 = write.value; break;
+                default: break;
+            }
+        }
+
+        // Window restarts the fetcher from its own map once output reaches WX - 7
+        const bool windowVisible {(registers.lcdc & WINDOW_ENABLE) != 0 && (registers.lcdc & BG_ENABLE) != 0 && m_ly >= registers.wy};
+        if (!window && !dummyFetch && windowVisible && x + 7 >= registers.wx) {
+            window = true;
+            fifoSize = 0;
+            fetchStep = 0;
+            fetchX = 0;
+            discard = registers.wx < 7 ? 7 - registers.wx : 0;
+            m_windowLine++;
+        }
+
+        // Shift out a pixel
+        if (fifoSize > 0) {
+            const u8 index {fifo[fifoHead]};
+            fifoHead = (fifoHead + 1) % fifo.size();
+            fifoSize--;
+
+            if (discard > 0) {
+                discard--;
+            } else {
+                line[x] = composePixel(index, sprites.colours[x], sprites.attributes[x], registers);
+                x++;
+            }
+        }
+
+        // Advance fetcher
+        switch (fetchStep++) {
+            case 1: {
+                const u8 mapX {static_cast<u8>(window ? fetchX : (registers.scx / 8 + fetchX) % 32)};
+                const u8 mapY {window ? static_cast<u8>(m_windowLine - 1) : static_cast<u8>(registers.scy + m_ly)};
+                const bool highMap {(registers.lcdc & (window ? WINDOW_MAP : BG_MAP)) != 0};
+                tile = vram[(highMap ? 0x1C00 : 0x1800) + (mapY / 8) * 32 + mapX];
+                break;
+            }
+            case 3: {
+                // Low and high bytes come from the decoded row in one go. The high byte step is just waiting
+                const usize tileY {static_cast<u8>(window ? m_windowLine - 1 : registers.scy + m_ly) % 8u};
+                row = tiles.tile(0, tileIndex(tile, registers.lcdc)).row(tileY);
+                break;
+            }
+            case 6:
+                if (fifoSize > 0) {
+                    fetchStep = 6;  // Waits until the FIFO runs dry
+                    break;
+                }
+
+                fetchStep = 0;
+                if (dummyFetch) {
+                    dummyFetch = false;
+                    break;
+                }
+
+                // DMG shows colour 0 everywhere with the background off
+                if ((registers.lcdc & BG_ENABLE) != 0) {
+                    std::copy_n(row, fifo.size(), fifo.begin());
+                } else {
+                    fifo.fill(0);
+                }
+                fifoHead = 0;
+                fifoSize = fifo.size();
+                fetchX++;
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+void PPU::renderTiles(std::span<u8, SCREEN_WIDTH> line, usize startX, u16 mapAddress, u8 mapX, u8 mapY, u8 lcdc) const {
+    const u8* mapRow {m_gb.bus.vram(0) + (mapAddress - 0x8000) + (mapY / 8) * 32};
+    TileCache& tiles {m_gb.bus.tiles()};
+    const usize tileY {mapY % 8u};
+
+    usize x {startX};
+    u8 tileX {static_cast<u8>(mapX / 8)};
+    usize skip {mapX % 8u};  // Pixels of the first tile scrolled off the left edge
+
+    while (x < SCREEN_WIDTH) {
+        const u8* pixels {tiles.tile(0, tileIndex(mapRow[tileX % 32], lcdc)).row(tileY)};
+
+        const usize count {std::min<usize>(8 - skip, SCREEN_WIDTH - x)};
+        std::copy_n(pixels + skip, count, line.begin() + x);
+
+        x += count;
+        skip = 0;
+        tileX++;
+    }
+}
+
+bool PPU::resolveSprites(SpriteLine& line, u8 lcdc) const {
+    const u8* oam {m_gb.bus.oam()};
+    TileCache& tiles {m_gb.bus.tiles()};
+    const u8 height {static_cast<u8>((lcdc & SPRITE_SIZE) != 0 ? 16 : 8)};
+
+    // OAM scan picks the first 10 sprites on the line
+    std::array<const u8*, MAX_SPRITES_PER_LINE> sprites {};
+    usize spriteCount {0};
+    for (usize i {0}; i < 40 && spriteCount < MAX_SPRITES_PER_LINE; i++) {
+        const u8* sprite {oam + i * 4};
+        const int top {sprite[0] - 16};
+        if (m_ly >= top && m_ly < top + height) sprites[spriteCount++] = sprite;
+    }
+
+    if (spriteCount == 0) return false;
+
+    // Lower X wins, then earlier in OAM. The first opaque pixel at each position belongs to the winner
+    std::stable_sort(sprites.begin(), sprites.begin() + spriteCount, [](const u8* a, const u8* b) { return a[1] < b[1]; });
+
+    for (usize i {0}; i < spriteCount; i++) {
+        const u8* sprite {sprites[i]};
+        const u8 attributes {sprite[3]};
+
+        usize row {static_cast<usize>(m_ly - (sprite[0] - 16))};
+        if ((attributes & FLIP_Y) != 0) row = height - 1 - row;
+
+        // Bit 0 of the tile number is ignored for 8x16 sprites, which carry on into the next tile
+        const u8 tile {static_cast<u8>(height == 16 ? sprite[2] & 0xFE : sprite[2])};
+        const u8* colours {tiles.tile(0, tile + row / 8).row(row % 8, (attributes & FLIP_X) != 0)};
+
+        for (usize pixel {0}; pixel < 8; pixel++) {
+            const int x {sprite[1] - 8 + static_cast<int>(pixel)};
+            if (x < 0 || x >= static_cast<int>(SCREEN_WIDTH) || colours[pixel] == 0 || line.colours[x] != 0) continue;
+            line.colours[x] = colours[pixel];
+            line.attributes[x] = attributes;
+        }
+    }
+
+    return true;
+}
+
+u32 PPU::composePixel(u8 bgIndex, u8 spriteColour, u8 spriteAttributes, const LineRegisters& registers) {
+    const u8 sprite {(registers.lcdc & SPRITE_ENABLE) != 0 ? spriteColour : u8 {0}};
+    const u8 index {pixels::compositeIndex(bgIndex, sprite, spriteAttributes, true)};
+
+    // Index picks out background, OBP0 or OBP1 in blocks of 4
+    const u8 palette {index < 4 ? registers.bgp : index < 8 ? registers.obp0 : registers.obp1};
+    return SHADES[paletteShade(palette, index % 4)];
+}
+
+u8 PPU::readRegister(u16 address) const {
+    return m_gb.bus.read(address);
+}
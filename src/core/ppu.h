@@ -0,0 +1,158 @@
+#pragma once
+
+#include <array>
+#include <span>
+#include <vector>
+
+#include "common/types.h"
+
+class GameBoy;
+
+struct PPUStats {
+    u32 fastLines {};  // Lines drawn in one go as nothing changed while they were drawn
+    u32 fifoLines {};  // Lines replayed through the pixel FIFO because registers changed mid-line
+};
+
+// DMG picture processing unit. Draws a whole scanline at once when the line enters H-blank, straight into a
+// 160x144 RGBA8888 framebuffer which can be handed to the renderer as is.
+// Modes and LY only change on scheduled events, so registers are exact at any point the CPU can read them
+// as the CPU never runs past the next event.
+// Writes to rendering registers while a line is being drawn are logged with the dot they happened on.
+// Lines with none take the fast whole-line path, and the rare lines with some get replayed dot by dot
+// through a pixel FIFO so raster effects land on the right pixel
+class PPU {
+public:
+    static constexpr usize SCREEN_WIDTH {160};
+    static constexpr usize SCREEN_HEIGHT {144};
+
+    // Line timing in M-cycles. Drawing length doesn't vary with sprites or scrolling yet
+    static constexpr u64 OAM_SCAN_CYCLES {20};
+    static constexpr u64 DRAWING_CYCLES {43};
+    static constexpr u64 LINE_CYCLES {114};
+    static constexpr u8 LINE_COUNT {154};  // Including V-blank lines
+
+    static constexpr u16 LCDC_ADDRESS {0xFF40};
+    static constexpr u16 STAT_ADDRESS {0xFF41};
+    static constexpr u16 SCY_ADDRESS {0xFF42};
+    static constexpr u16 SCX_ADDRESS {0xFF43};
+    static constexpr u16 LY_ADDRESS {0xFF44};
+    static constexpr u16 LYC_ADDRESS {0xFF45};
+    static constexpr u16 BGP_ADDRESS {0xFF47};
+    static constexpr u16 OBP0_ADDRESS {0xFF48};
+    static constexpr u16 OBP1_ADDRESS {0xFF49};
+    static constexpr u16 WY_ADDRESS {0xFF4A};
+    static constexpr u16 WX_ADDRESS {0xFF4B};
+
+    enum class Mode : u8 {
+        HBlank = 0,
+        VBlank = 1,
+        OAMScan = 2,
+        Drawing = 3,
+    };
+
+    explicit PPU(GameBoy& gb);
+
+    // Hooks up registers and turns the LCD on with the values the boot ROM leaves behind
+    void reset();
+
+    // Gets finished pixels as 0xRRGGBBAA, row by row. Lines are only complete once frameCount() moves on
+    std::span<const u32> framebuffer() const { return m_framebuffer; }
+
+    // Number of frames finished since reset. Goes up on entering V-blank
+    u64 frameCount() const { return m_frameCount; }
+
+    Mode mode() const { return m_mode; }
+    u8 ly() const { return m_ly; }
+
+    // Gets how many lines of the last finished frame took each rendering path
+    const PPUStats& lastFrameStats() const { return m_lastFrameStats; }
+
+private:
+    // DMG shades from lightest to darkest
+    static constexpr std::array<u32, 4> SHADES {0xFFFFFFFF, 0xAAAAAAFF, 0x555555FF, 0x000000FF};
+
+    static constexpr usize MAX_SPRITES_PER_LINE {10};
+    static constexpr u32 DOTS_PER_CYCLE {4};
+
+    // Registers which affect drawing, as they were when the line started drawing
+    struct LineRegisters {
+        u8 lcdc;
+        u8 scx;
+        u8 scy;
+        u8 wx;
+        u8 wy;
+        u8 bgp;
+        u8 obp0;
+        u8 obp1;
+    };
+
+    // Write to a rendering register while the line was being drawn
+    struct LineWrite {
+        u32 dot;  // Dots since drawing started
+        u16 address;
+        u8 value;
+    };
+
+    // Sprite pixels which won priority at each position of a line. Kept as separate lines so they can be
+    // composited a vector at a time. Colour 0 means there isn't one
+    struct SpriteLine {
+        std::array<u8, SCREEN_WIDTH> colours;
+        std::array<u8, SCREEN_WIDTH> attributes;
+    };
+
+    GameBoy& m_gb;
+
+    alignas(64) std::array<u32, SCREEN_WIDTH * SCREEN_HEIGHT> m_framebuffer {};
+    u64 m_frameCount {0};
+
+    Mode m_mode {Mode::HBlank};
+    u8 m_ly {0};
+    u8 m_lyc {0};
+    u8 m_lcdc {0};
+    u8 m_statSelect {0};      // STAT interrupt sources in bits 3-6
+    bool m_statLine {false};  // STAT interrupt fires on the rising edge of this
+    u8 m_windowLine {0};      // Window's own line counter. Only moves on lines where it's drawn
+
+    LineRegisters m_lineRegisters {};
+    std::vector<LineWrite> m_lineWrites {};
+    u64 m_drawingStart {0};  // Timestamp current line started drawing at
+
+    PPUStats m_frameStats {};
+    PPUStats m_lastFrameStats {};
+
+    void writeLcdc(u8 value);
+
+    // Records write to rendering register if the line is being drawn
+    void logWrite(u16 address, u8 value);
+
+    // Scheduler handlers. Line increments start each line, mode changes happen within it
+    void startLine(u64 timestamp);
+    void changeMode(u64 timestamp);
+
+    // Updates STAT interrupt line after anything feeding into it changes
+    void updateStat();
+
+    void requestInterrupt(u8 mask);
+
+    // Draws current line into the framebuffer, picking the path based on whether registers changed mid-line
+    void renderLine();
+
+    // Draws line with the registers as they were at the start
+    void renderLineFast(std::span<u32, SCREEN_WIDTH> line);
+
+    // Steps through the line dot by dot with a background fetcher and FIFO, applying logged writes as they come up
+    void renderLineFifo(std::span<u32, SCREEN_WIDTH> line);
+
+    // Writes colour indices of background or window into line, starting at screen x
+    void renderTiles(std::span<u8, SCREEN_WIDTH> line, usize startX, u16 mapAddress, u8 mapX, u8 mapY, u8 lcdc) const;
+
+    // Picks the sprite pixel shown at each position of the current line. Returns false if no sprites are on it
+    bool resolveSprites(SpriteLine& sprites, u8 lcdc) const;
+
+    // Gets final colour of a single pixel from its background colour index and sprite.
+    // Used when registers can change between pixels, otherwise whole lines go through pixels::composite()
+    static u32 composePixel(u8 bgIndex, u8 spriteColour, u8 spriteAttributes, const LineRegisters& registers);
+
+    // Reads register stored on the bus
+    u8 readRegister(u16 address) const;
+};
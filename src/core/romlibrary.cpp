@@ -0,0 +1,328 @@
+#include "romlibrary.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cctype>
+#include <condition_variable>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+#include "common/log.h"
+
+namespace {
+    constexpr std::array<char, 4> INDEX_MAGIC {'G', 'B', 'B', 'L'};
+    constexpr usize READ_CHUNK_SIZE {64 * 1024};
+
+    // Size of an index entry with empty path and title
+    constexpr usize MIN_ENTRY_SIZE {2 + 8 + 8 + 4 + sizeof(Sha1::Digest) + 2 + 1 + 2 + 1 + 1 + 2 + 1};
+
+    bool isRomFile(const std::filesystem::path& path) {
+        std::string extension {path.extension().string()};
+        std::ranges::transform(extension, extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        return extension == ".gb" || extension == ".gbc";
+    }
+
+    // Paths are stored and compared in generic form so the separators match whatever produced them
+    std::string pathKey(const std::filesystem::path& path) {
+        const std::u8string key {path.generic_u8string()};
+        return {key.begin(), key.end()};
+    }
+
+    usize workerCount() {
+        return std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    // Little-endian serialisation of index entries
+    class IndexWriter {
+    public:
+        template<typename T>
+        void put(T value) {
+            for (usize i {0}; i < sizeof(T); i++) m_data.push_back(static_cast<u8>(static_cast<u64>(value) >> (i * 8)));
+        }
+
+        void putBytes(std::span<const u8> bytes) { m_data.insert(m_data.end(), bytes.begin(), bytes.end()); }
+
+        // Strings are prefixed with a u16 length
+        void putString(std::string_view string) {
+            put(static_cast<u16>(string.size()));
+            putBytes({reinterpret_cast<const u8*>(string.data()), string.size()});
+        }
+
+        const std::vector<u8>& data() const { return m_data; }
+
+    private:
+        std::vector<u8> m_data {};
+    };
+
+    // Reads entries back. Every read past the end fails and leaves ok() false
+    class IndexReader {
+    public:
+        explicit IndexReader(std::span<const u8> data) : m_data(data) {}
+
+        template<typename T>
+        T get() {
+            u64 value {0};
+            for (usize i {0}; i < sizeof(T); i++) value |= static_cast<u64>(getByte()) << (i * 8);
+            return static_cast<T>(value);
+        }
+
+        void getBytes(std::span<u8> bytes) {
+            if (bytes.size() > m_data.size() - m_position) {
+                m_ok = false;
+                return;
+            }
+            std::memcpy(bytes.data(), m_data.data() + m_position, bytes.size());
+            m_position += bytes.size();
+        }
+
+        std::string getString() {
+            std::string string(get<u16>(), '\0');
+            getBytes({reinterpret_cast<u8*>(string.data()), string.size()});
+            return string;
+        }
+
+        bool ok() const { return m_ok; }
+        usize remaining() const { return m_data.size() - m_position; }
+
+    private:
+        std::span<const u8> m_data;
+        usize m_position {0};
+        bool m_ok {true};
+
+        u8 getByte() {
+            if (m_position >= m_data.size()) {
+                m_ok = false;
+                return 0;
+            }
+            return m_data[m_position++];
+        }
+    };
+}
+
+RomLibrary::RomLibrary(std::filesystem::path indexPath)
+    : m_indexPath(std::move(indexPath))
+{
+    load();
+}
+
+usize RomLibrary::scan(std::span<const std::filesystem::path> directories) {
+    // Walk directories with a shared queue so deep and wide trees both keep every worker busy
+    std::vector<RomInfo> found {};
+    {
+        std::mutex mutex {};
+        std::condition_variable wake {};
+        std::vector<std::filesystem::path> queue(directories.begin(), directories.end());
+        usize pending {queue.size()};  // Directories queued or being walked
+
+        const auto walk = [&] {
+            std::unique_lock lock {mutex};
+            while (true) {
+                wake.wait(lock, [&] { return !queue.empty() || pending == 0; });
+                if (queue.empty()) return;
+
+                const std::filesystem::path directory {std::move(queue.back())};
+                queue.pop_back();
+                lock.unlock();
+
+                std::vector<std::filesystem::path> subdirectories {};
+                std::vector<RomInfo> roms {};
+                std::error_code error {};
+                for (std::filesystem::directory_iterator it {directory, error}, end {}; !error && it != end; it.increment(error)) {
+                    const std::filesystem::directory_entry& entry {*it};
+                    if (entry.is_directory(error) && !entry.is_symlink(error)) {  // Links could loop back up the tree
+                        subdirectories.push_back(entry.path());
+                    } else if (entry.is_regular_file(error) && isRomFile(entry.path())) {
+                        RomInfo rom {};
+                        rom.path = entry.path();
+                        rom.modifiedTime = entry.last_write_time(error).time_since_epoch().count();
+                        rom.size = entry.file_size(error);
+                        if (!error) roms.push_back(std::move(rom));
+                    }
+                    error.clear();
+                }
+
+                lock.lock();
+                std::ranges::move(subdirectories, std::back_inserter(queue));
+                std::ranges::move(roms, std::back_inserter(found));
+                pending += subdirectories.size();
+                pending--;
+                wake.notify_all();
+            }
+        };
+
+        std::vector<std::jthread> workers {};
+        for (usize i {0}; i < workerCount(); i++) workers.emplace_back(walk);
+    }
+
+    // Unchanged files keep what the index already has. Everything else gets read
+    std::unordered_map<std::string, const RomInfo*> indexed {};
+    for (const RomInfo& rom : m_roms) indexed.emplace(pathKey(rom.path), &rom);
+
+    std::vector<RomInfo*> changed {};
+    for (RomInfo& rom : found) {
+        const auto it {indexed.find(pathKey(rom.path))};
+        if (it != indexed.end() && it->second->modifiedTime == rom.modifiedTime && it->second->size == rom.size) {
+            rom = *it->second;
+        } else {
+            changed.push_back(&rom);
+        }
+    }
+
+    std::vector<std::atomic<bool>> valid(changed.size());
+    {
+        std::atomic<usize> next {0};
+        const auto read = [&] {
+            for (usize i {next++}; i < changed.size(); i = next++) valid[i] = readRom(*changed[i]);
+        };
+
+        std::vector<std::jthread> workers {};
+        for (usize i {0}; i < std::min(workerCount(), changed.size()); i++) workers.emplace_back(read);
+    }
+
+    // Files which turned out not to be ROMs are left out. Real ROMs can't be empty, so size marks them
+    for (usize i {0}; i < changed.size(); i++) {
+        if (!valid[i]) changed[i]->size = 0;
+    }
+    std::erase_if(found, [](const RomInfo& rom) { return rom.size == 0; });
+
+    std::ranges::sort(found, {}, &RomInfo::path);
+    m_roms = std::move(found);
+    return changed.size();
+}
+
+bool RomLibrary::save() const {
+    IndexWriter writer {};
+    writer.putBytes({reinterpret_cast<const u8*>(INDEX_MAGIC.data()), INDEX_MAGIC.size()});
+    writer.put(INDEX_VERSION);
+    writer.put(static_cast<u32>(m_roms.size()));
+
+    for (const RomInfo& rom : m_roms) {
+        writer.putString(pathKey(rom.path));
+        writer.put(rom.modifiedTime);
+        writer.put(rom.size);
+        writer.put(rom.crc32);
+        writer.putBytes(rom.sha1);
+
+        const CartHeader& header {rom.header};
+        writer.putString(header.title);
+        writer.put(header.cartType);
+        writer.put(header.romBanks);
+        writer.put(header.ramBanks);
+        writer.put(header.headerChecksum);
+        writer.put(header.globalChecksum);
+        writer.put(static_cast<u8>((header.hasBattery ? 0x01 : 0x00) | (header.cgbSupport ? 0x02 : 0x00)));
+    }
+
+    // Written next to the index first so a crash never leaves half an index behind
+    std::filesystem::path temporaryPath {m_indexPath};
+    temporaryPath += ".tmp";
+    {
+        std::ofstream file {temporaryPath, std::ios::binary | std::ios::trunc};
+        file.write(reinterpret_cast<const char*>(writer.data().data()), static_cast<std::streamsize>(writer.data().size()));
+        if (!file) {
+            log::err("Failed to write ROM library index: {}", temporaryPath);
+            return false;
+        }
+    }
+
+    std::error_code error {};
+    std::filesystem::rename(temporaryPath, m_indexPath, error);
+    if (error) {
+        log::err("Failed to write ROM library index: {} Error: {}", m_indexPath, error.message());
+        return false;
+    }
+    return true;
+}
+
+void RomLibrary::load() {
+    std::ifstream file {m_indexPath, std::ios::binary | std::ios::ate};
+    if (!file) return;  // Nothing indexed yet
+
+    std::vector<u8> data(static_cast<usize>(file.tellg()));
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(data.data()), static_cast<std::streamsize>(data.size()));
+
+    IndexReader reader {data};
+    std::array<char, 4> magic {};
+    reader.getBytes({reinterpret_cast<u8*>(magic.data()), magic.size()});
+    if (magic != INDEX_MAGIC || reader.get<u32>() != INDEX_VERSION) {
+        log::warn("Ignoring ROM library index in unknown format: {}", m_indexPath);
+        return;
+    }
+
+    // Count comes from the file, so check it could fit before allocating for it
+    const u32 count {reader.get<u32>()};
+    if (count > reader.remaining() / MIN_ENTRY_SIZE) {
+        log::warn("Ignoring truncated ROM library index: {}", m_indexPath);
+        return;
+    }
+
+    std::vector<RomInfo> roms(count);
+    for (RomInfo& rom : roms) {
+        const std::string path {reader.getString()};
+        rom.path = std::filesystem::path {std::u8string {path.begin(), path.end()}};
+        rom.modifiedTime = reader.get<i64>();
+        rom.size = reader.get<u64>();
+        rom.crc32 = reader.get<u32>();
+        reader.getBytes(rom.sha1);
+
+        CartHeader& header {rom.header};
+        header.title = reader.getString();
+        header.cartType = reader.get<u8>();
+        header.romBanks = reader.get<u16>();
+        header.ramBanks = reader.get<u8>();
+        header.headerChecksum = reader.get<u8>();
+        header.globalChecksum = reader.get<u16>();
+        const u8 flags {reader.get<u8>()};
+        header.hasBattery = (flags & 0x01) != 0;
+        header.cgbSupport = (flags & 0x02) != 0;
+
+        if (!reader.ok()) {
+            log::warn("Ignoring truncated ROM library index: {}", m_indexPath);
+            return;
+        }
+    }
+
+    m_roms = std::move(roms);
+}
+
+bool RomLibrary::readRom(RomInfo& rom) {
+    std::ifstream file {rom.path, std::ios::binary};
+    if (!file) return false;
+
+    Crc32 crc32 {};
+    Sha1 sha1 {};
+    std::vector<u8> chunk(READ_CHUNK_SIZE);
+    bool first {true};
+
+    while (file) {
+        file.read(reinterpret_cast<char*>(chunk.data()), static_cast<std::streamsize>(chunk.size()));
+        const std::span<const u8> data {chunk.data(), static_cast<usize>(file.gcount())};
+        if (data.empty()) break;
+
+        // Header always sits in the first chunk
+        if (first) {
+            try {
+                rom.header = Cartridge::parseHeader(data);
+            } catch (const std::runtime_error&) {
+                return false;
+            }
+            first = false;
+        }
+
+        crc32.update(data);
+        sha1.update(data);
+    }
+
+    if (first) return false;  // Empty file
+
+    rom.crc32 = crc32.value();
+    rom.sha1 = sha1.finish();
+    return true;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <filesystem>
+#include <span>
+#include <vector>
+
+#include "common/hash.h"
+#include "common/types.h"
+
+#include "cartridge.h"
+
+// Everything the library knows about a single ROM file
+struct RomInfo {
+    std::filesystem::path path;
+    i64 modifiedTime;  // Last write time in file clock ticks. Only compared for equality
+    u64 size;
+    u32 crc32;
+    Sha1::Digest sha1;
+    CartHeader header;
+};
+
+// Index of every ROM under a set of directories, kept on disk so listing doesn't touch the ROMs at all.
+// Files are keyed by path, modification time and size, so rescans only read files which are new or changed,
+// and for those only the header gets parsed while the rest is streamed through the hashes
+class RomLibrary {
+public:
+    static constexpr u32 INDEX_VERSION {1};
+
+    // Loads index at indexPath if there is one. A missing or unreadable index just starts out empty
+    explicit RomLibrary(std::filesystem::path indexPath);
+
+    // Walks directories recursively in parallel and brings the index up to date with the .gb/.gbc files found.
+    // Files which are gone are dropped. Returns number of files which had to be read
+    usize scan(std::span<const std::filesystem::path> directories);
+
+    // Gets every indexed ROM, sorted by path
+    const std::vector<RomInfo>& roms() const { return m_roms; }
+
+    // Writes index to disk, replacing the old one in a single rename. Returns false on failure
+    bool save() const;
+
+private:
+    std::filesystem::path m_indexPath;
+    std::vector<RomInfo> m_roms {};
+
+    void load();
+
+    // Parses header and hashes ROM file. Returns false if it can't be read or is too small to be a ROM
+    static bool readRom(RomInfo& rom);
+};
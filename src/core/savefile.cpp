@@ -0,0 +1,38 @@
+#include "savefile.h"
+
+SaveFile::SaveFile(const std::filesystem::path& filepath, usize size)
+    : m_file(filepath, size)
+    , m_flusher([this](std::stop_token stopToken) { runFlusher(stopToken); })
+{
+}
+
+SaveFile::~SaveFile() {
+    m_flusher.request_stop();
+    m_flusher.join();
+    flush();
+}
+
+void SaveFile::requestFlush() {
+    {
+        std::scoped_lock lock {m_mutex};
+        if (m_flushRequested) return;
+        m_flushRequested = true;
+    }
+    m_wake.notify_one();
+}
+
+void SaveFile::runFlusher(std::stop_token stopToken) {
+    std::unique_lock lock {m_mutex};
+
+    while (true) {
+        if (!m_wake.wait(lock, stopToken, [this] { return m_flushRequested; })) return;
+        m_flushRequested = false;
+
+        lock.unlock();
+        flush();
+        lock.lock();
+
+        // Games writing every frame would otherwise keep the disk busy. Anything requested meanwhile goes out next time
+        m_wake.wait_for(lock, stopToken, FLUSH_INTERVAL, [] { return false; });
+    }
+}
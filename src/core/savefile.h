@@ -0,0 +1,48 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <mutex>
+#include <span>
+#include <thread>
+
+#include "common/fs.h"
+#include "common/types.h"
+
+// Battery save mapped straight into memory so cartridge RAM writes land in the file as they happen.
+// Mapped pages belong to the OS, so a crash only loses what it hasn't written back yet. A background thread
+// forces them to disk at most every FLUSH_INTERVAL, which bounds how much a power cut can lose without the
+// emulation thread ever waiting on the disk
+class SaveFile {
+public:
+    static constexpr std::chrono::milliseconds FLUSH_INTERVAL {1000};
+
+    // Maps save file at filepath, creating it or growing it to size. Throws std::runtime_error on failure
+    SaveFile(const std::filesystem::path& filepath, usize size);
+
+    // Stops the flusher and writes everything out
+    ~SaveFile();
+
+    SaveFile(const SaveFile&) = delete;
+    SaveFile& operator=(const SaveFile&) = delete;
+
+    std::span<u8> bytes() { return m_file.bytes(); }
+
+    // Asks the flusher to write the file out. Never blocks, and requests made while one is pending are merged
+    void requestFlush();
+
+    // Writes file out and waits for it to reach the disk
+    void flush() { m_file.flush(); }
+
+private:
+    WritableMappedFile m_file;
+
+    std::mutex m_mutex {};
+    std::condition_variable_any m_wake {};
+    bool m_flushRequested {false};
+
+    std::jthread m_flusher {};  // Declared last so it stops before anything it uses is destroyed
+
+    void runFlusher(std::stop_token stopToken);
+};
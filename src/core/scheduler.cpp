@@ -0,0 +1,97 @@
+#include "scheduler.h"
+
+void Scheduler::setHandler(EventType type, Handler handler, void* context) {
+    m_handlers[index(type)] = handler;
+    m_contexts[index(type)] = context;
+}
+
+void Scheduler::scheduleAt(EventType type, u64 timestamp) {
+    m_deadlines[index(type)] = timestamp;
+
+    const u8 position {m_positions[index(type)]};
+    if (position == NOT_SCHEDULED) {
+        place(m_size, type);
+        siftUp(m_size++);
+        return;
+    }
+
+    // Already pending so only its position needs fixing
+    siftUp(position);
+    siftDown(m_positions[index(type)]);
+}
+
+void Scheduler::cancel(EventType type) {
+    const u8 position {m_positions[index(type)]};
+    if (position != NOT_SCHEDULED) removeAt(position);
+}
+
+void Scheduler::runDueEvents() {
+    while (m_size > 0 && m_deadlines[index(m_heap[0])] <= m_now) {
+        const EventType type {m_heap[0]};
+        const u64 timestamp {m_deadlines[index(type)]};
+        removeAt(0);
+
+        if (m_handlers[index(type)] != nullptr) {
+            m_handlers[index(type)](m_contexts[index(type)], timestamp);
+        }
+    }
+}
+
+void Scheduler::removeAt(usize position) {
+    const EventType removed {m_heap[position]};
+    m_positions[index(removed)] = NOT_SCHEDULED;
+
+    // Fill hole with the last event and restore ordering around it
+    m_size--;
+    if (position == m_size) return;
+
+    const EventType moved {m_heap[m_size]};
+    place(position, moved);
+    siftUp(position);
+    siftDown(m_positions[index(moved)]);
+}
+
+void Scheduler::siftUp(usize position) {
+    while (position > 0) {
+        const usize parent {(position - 1) / 2};
+        if (!earlier(position, parent)) break;
+
+        const EventType type {m_heap[position]};
+        place(position, m_heap[parent]);
+        place(parent, type);
+        position = parent;
+    }
+}
+
+void Scheduler::siftDown(usize position) {
+    while (true) {
+        const usize left {position * 2 + 1};
+        const usize right {left + 1};
+
+        usize earliest {position};
+        if (left < m_size && earlier(left, earliest)) earliest = left;
+        if (right < m_size && earlier(right, earliest)) earliest = right;
+        if (earliest == position) break;
+
+        const EventType type {m_heap[position]};
+        place(position, m_heap[earliest]);
+        place(earliest, type);
+        position = earliest;
+    }
+}
+
+void Scheduler::place(usize position, EventType type) {
+    m_heap[position] = type;
+    m_positions[index(type)] = static_cast<u8>(position);
+}
+
+bool Scheduler::earlier(usize position1, usize position2) const {
+    const EventType type1 {m_heap[position1]};
+    const EventType type2 {m_heap[position2]};
+
+    // Ties go to the lower event type so order never depends on scheduling history
+    if (m_deadlines[index(type1)] != m_deadlines[index(type2)]) {
+        return m_deadlines[index(type1)] < m_deadlines[index(type2)];
+    }
+    return type1 < type2;
+}
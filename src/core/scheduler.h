@@ -0,0 +1,88 @@
+#pragma once
+
+#include <array>
+#include <limits>
+
+#include "common/types.h"
+
+// Timed hardware events. Each type can only be pending once
+enum class EventType : u8 {
+    PPUModeChange,
+    PPULineIncrement,  // LY increment
+    TimerOverflow,     // TIMA overflow
+    DMAComplete,
+    SerialBit,
+
+    Count,
+};
+
+// Keeps track of emulated time and when each pending event is due.
+// Pending events live in a fixed-size binary heap ordered by deadline so the next deadline
+// is always O(1) to check and scheduling/cancelling is O(log n) with no allocation
+class Scheduler {
+public:
+    static constexpr u64 NEVER {std::numeric_limits<u64>::max()};
+
+    // Called when event is due with the timestamp it was scheduled for, which may be slightly in the past
+    using Handler = void (*)(void* context, u64 timestamp);
+
+    // Sets function called when event of the given type is due
+    void setHandler(EventType type, Handler handler, void* context);
+
+    // Gets current timestamp in M-cycles
+    u64 now() const { return m_now; }
+
+    // Gets timestamp of the next pending event. NEVER if nothing is pending
+    u64 nextDeadline() const { return m_size > 0 ? m_deadlines[index(m_heap[0])] : NEVER; }
+
+    // Moves time forward. Doesn't fire any events
+    void advance(u64 cycles) { m_now += cycles; }
+
+    // Schedules event to fire after delay M-cycles. Replaces any pending event of the same type
+    void schedule(EventType type, u64 delay) { scheduleAt(type, m_now + delay); }
+
+    // Schedules event to fire at timestamp. Replaces any pending event of the same type
+    void scheduleAt(EventType type, u64 timestamp);
+
+    // Removes pending event. Does nothing if it isn't pending
+    void cancel(EventType type);
+
+    bool isScheduled(EventType type) const { return m_positions[index(type)] != NOT_SCHEDULED; }
+
+    // Fires every event which is due, in deadline order. Handlers may schedule more events
+    void runDueEvents();
+
+private:
+    static constexpr usize MAX_EVENTS {static_cast<usize>(EventType::Count)};
+    static constexpr u8 NOT_SCHEDULED {0xFF};
+
+    u64 m_now {0};
+
+    std::array<EventType, MAX_EVENTS> m_heap {};  // Pending events. Earliest deadline first
+    usize m_size {0};
+
+    std::array<u64, MAX_EVENTS> m_deadlines {};  // Indexed by event type
+    std::array<u8, MAX_EVENTS> m_positions = [] {
+        std::array<u8, MAX_EVENTS> positions {};
+        positions.fill(NOT_SCHEDULED);
+        return positions;
+    }();  // Position of each event type in heap
+
+    std::array<Handler, MAX_EVENTS> m_handlers {};
+    std::array<void*, MAX_EVENTS> m_contexts {};
+
+    static constexpr usize index(EventType type) { return static_cast<usize>(type); }
+
+    // Removes event at heap position
+    void removeAt(usize position);
+
+    // Moves event at heap position towards the top/bottom until heap is ordered again
+    void siftUp(usize position);
+    void siftDown(usize position);
+
+    // Puts event at heap position and records where it went
+    void place(usize position, EventType type);
+
+    // Checks if event at position1 is due before event at position2
+    bool earlier(usize position1, usize position2) const;
+};
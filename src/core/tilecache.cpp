@@ -0,0 +1,32 @@
+#include "tilecache.h"
+
+#include <algorithm>
+
+#include "bus.h"
+#include "pixels.h"
+
+TileCache::TileCache(const u8* vram)
+    : m_vram(vram)
+{
+    clear();
+}
+
+void TileCache::invalidate(u8 bank, u16 offset, usize size) {
+    if (offset >= TILE_DATA_SIZE) return;
+
+    const usize first {offset / TILE_SIZE};
+    const usize last {std::min<usize>((offset + size - 1) / TILE_SIZE, TILES_PER_BANK - 1)};
+    for (usize index {first}; index <= last; index++) m_stale.set(bank * TILES_PER_BANK + index);
+}
+
+void TileCache::decode(usize slot) {
+    const u8* data {m_vram + (slot / TILES_PER_BANK) * RealBus::VRAM_BANK_SIZE + (slot % TILES_PER_BANK) * TILE_SIZE};
+    DecodedTile& tile {m_tiles[slot]};
+
+    pixels::decode({data, TILE_SIZE}, tile.pixels);
+    for (usize y {0}; y < 8; y++) {
+        std::reverse_copy(tile.pixels.begin() + y * 8, tile.pixels.begin() + y * 8 + 8, tile.flipped.begin() + y * 8);
+    }
+
+    m_stale.reset(slot);
+}
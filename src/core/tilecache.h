@@ -0,0 +1,48 @@
+#pragma once
+
+#include <array>
+#include <bitset>
+
+#include "common/types.h"
+
+// 8x8 tile with one colour index per pixel, row by row
+struct alignas(64) DecodedTile {
+    std::array<u8, 64> pixels;
+    std::array<u8, 64> flipped;  // Mirrored horizontally for sprites with X flip
+
+    const u8* row(usize y, bool flipX = false) const { return (flipX ? flipped : pixels).data() + y * 8; }
+};
+
+// Tiles from VRAM tile data ($8000-$97FF) decoded from 2bpp planar bytes.
+// Tiles are decoded on first use after being written, so drawing a line is just lookups
+class TileCache {
+public:
+    static constexpr usize TILES_PER_BANK {384};
+    static constexpr usize BANK_COUNT {2};
+    static constexpr usize TILE_SIZE {16};  // Bytes of VRAM taken up by each tile
+    static constexpr u16 TILE_DATA_SIZE {TILES_PER_BANK * TILE_SIZE};
+
+    // vram points at both VRAM banks one after the other
+    explicit TileCache(const u8* vram);
+
+    // Gets tile by its index from $8000 in a VRAM bank, decoding it if it changed since last time
+    const DecodedTile& tile(u8 bank, usize index) {
+        const usize slot {bank * TILES_PER_BANK + index};
+        if (m_stale[slot]) decode(slot);
+        return m_tiles[slot];
+    }
+
+    // Marks tiles covering [offset, offset + size) of a VRAM bank as changed. Offsets past tile data are ignored
+    void invalidate(u8 bank, u16 offset, usize size = 1);
+
+    // Marks every tile as changed
+    void clear() { m_stale.set(); }
+
+private:
+    const u8* m_vram;
+
+    std::array<DecodedTile, BANK_COUNT * TILES_PER_BANK> m_tiles {};
+    std::bitset<BANK_COUNT * TILES_PER_BANK> m_stale {};
+
+    void decode(usize slot);
+};
@@ -1,10 +1,30 @@
+#include <chrono>
+#include <string_view>
+
+#include "common/log.h"
+
 #include "application.h"
 
-int main() {
+int main(int argc, char* argv[]) {
+    Application::Options options {.startTime = std::chrono::steady_clock::now()};
+
+    for (int i {1}; i < argc; i++) {
+        const std::string_view arg {argv[i]};
+        if (arg == "--startup-profile") {
+            options.startupProfile = true;
+        } else if (arg.starts_with("--") || options.romPath) {
+            log::err("Unexpected argument: {}", arg);
+            log::err("Usage: gbbuddy [--startup-profile] [rom]");
+            return 1;
+        } else {
+            options.romPath = argv[i];
+        }
+    }
+
     Application app;
-    app.init();
+    app.init(options);
 
     app.run();
 
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,124 @@
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "common/types.h"
+#include "core/bus.h"
+#include "core/cpu.h"
+#include "core/gameboy.h"
+
+TEST_CASE("Block cache reuses decoded blocks") {
+    MockBus bus;
+    CPU<MockBus> cpu(bus);
+
+    // Loop: INC A, INC B, JR -4
+    bus.write(0x0100, 0x3C);
+    bus.write(0x0101, 0x04);
+    bus.write(0x0102, 0x18);
+    bus.write(0x0103, 0xFC);
+
+    cpu.setState({.sp = 0xFFFE, .pc = 0x0100, .ime = 0});
+
+    for (int i {0}; i < 10; i++) {
+        cpu.runBlock();
+    }
+
+    REQUIRE(cpu.getState().a == 10);
+    REQUIRE(cpu.getState().b == 10);
+    REQUIRE(cpu.getState().pc == 0x0100);
+    REQUIRE(cpu.blockCacheStats().misses == 1);
+    REQUIRE(cpu.blockCacheStats().hits == 9);
+}
+
+TEST_CASE("Block cache is invalidated by writes to code") {
+    MockBus bus;
+    CPU<MockBus> cpu(bus);
+
+    // Code in WRAM: LD (HL), $04 which overwrites the INC A after it with INC B, then JP $C000
+    bus.write(0xC000, 0x36);
+    bus.write(0xC001, 0x04);
+    bus.write(0xC002, 0x3C);
+    bus.write(0xC003, 0xC3);
+    bus.write(0xC004, 0x00);
+    bus.write(0xC005, 0xC0);
+
+    cpu.setState({.h = 0xC0, .l = 0x02, .sp = 0xFFFE, .pc = 0xC000, .ime = 0});
+
+    // First run stops right after the write as rest of the block is stale
+    cpu.runBlock();
+    REQUIRE(cpu.getState().pc == 0xC002);
+    REQUIRE(cpu.blockCacheStats().invalidations == 1);
+
+    // Next run decodes the modified code
+    cpu.runBlock();
+    REQUIRE(cpu.getState().a == 0);
+    REQUIRE(cpu.getState().b == 1);
+    REQUIRE(cpu.getState().pc == 0xC000);
+}
+
+TEST_CASE("Invalidated blocks are forgotten by every page they span") {
+    MockBus bus;
+    CPU<MockBus> cpu(bus);
+
+    // JP $C0FE across the $C100 page boundary, and code elsewhere doing LD (HL), A
+    bus.write(0xC0FE, 0xC3);
+    bus.write(0xC0FF, 0xFE);
+    bus.write(0xC100, 0xC0);
+    bus.write(0xC200, 0x77);
+    bus.write(0xC201, 0x18);
+    bus.write(0xC202, 0xFE);
+
+    cpu.setState({.sp = 0xFFFE, .pc = 0xC0FE, .ime = 0});
+    cpu.runBlock();
+
+    // Turns the jump into JR -2, which fits in the first page
+    cpu.setState({.a = 0x18, .h = 0xC0, .l = 0xFE, .sp = 0xFFFE, .pc = 0xC200, .ime = 0});
+    cpu.runBlock();
+    REQUIRE(cpu.blockCacheStats().invalidations == 1);
+
+    cpu.setState({.sp = 0xFFFE, .pc = 0xC0FE, .ime = 0});
+    cpu.runBlock();
+    REQUIRE(cpu.getState().pc == 0xC0FE);
+
+    // New block doesn't use the second page so writing there leaves it alone
+    cpu.setState({.h = 0xC1, .l = 0x00, .sp = 0xFFFE, .pc = 0xC200, .ime = 0});
+    cpu.runBlock();
+    REQUIRE(cpu.blockCacheStats().invalidations == 1);
+}
+
+TEST_CASE("Writes through echo RAM invalidate blocks in WRAM and the other way round") {
+    GameBoy gb;
+    gb.init(std::vector<u8>(32 * 1024, 0));
+
+    // INC A, JR -3 in WRAM, and code elsewhere doing LD (HL), A
+    gb.bus.write(0xC000, 0x3C);
+    gb.bus.write(0xC001, 0x18);
+    gb.bus.write(0xC002, 0xFD);
+    gb.bus.write(0xC100, 0x77);
+    gb.bus.write(0xC101, 0x18);
+    gb.bus.write(0xC102, 0xFE);
+
+    gb.cpu.setState({.sp = 0xFFFE, .pc = 0xC000, .ime = 0});
+    gb.cpu.runBlock();
+    REQUIRE(gb.cpu.getState().a == 1);
+
+    // Replaces INC A with INC B through its echo
+    gb.cpu.setState({.a = 0x04, .h = 0xE0, .l = 0x00, .sp = 0xFFFE, .pc = 0xC100, .ime = 0});
+    gb.cpu.runBlock();
+    gb.cpu.setState({.sp = 0xFFFE, .pc = 0xC000, .ime = 0});
+    gb.cpu.runBlock();
+    REQUIRE(gb.cpu.getState().a == 0);
+    REQUIRE(gb.cpu.getState().b == 1);
+
+    // Runs the same code from echo RAM, then replaces INC B with INC C in WRAM
+    gb.cpu.setState({.sp = 0xFFFE, .pc = 0xE000, .ime = 0});
+    gb.cpu.runBlock();
+    REQUIRE(gb.cpu.getState().b == 1);
+
+    gb.cpu.setState({.a = 0x0C, .h = 0xC0, .l = 0x00, .sp = 0xFFFE, .pc = 0xC100, .ime = 0});
+    gb.cpu.runBlock();
+    gb.cpu.setState({.sp = 0xFFFE, .pc = 0xE000, .ime = 0});
+    gb.cpu.runBlock();
+    REQUIRE(gb.cpu.getState().b == 0);
+    REQUIRE(gb.cpu.getState().c == 1);
+}
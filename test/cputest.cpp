@@ -48,7 +48,7 @@ struct SingleTest {
 class CPUFixture {
 public:
     MockBus bus;
-    CPU cpu;
+    CPU<MockBus> cpu;
 
     CPUFixture()
         : cpu(bus) {};
@@ -75,7 +75,7 @@ void performTest(CPUFixture& cpuFixture, const SingleTest &test) {
         cpuFixture.bus.write(memEntry.addr, memEntry.val);
     }
 
-    cpuFixture.cpu.step();
+    const u8 cycles {cpuFixture.cpu.step()};
 
     CPUState actualState = cpuFixture.cpu.getState();
     CPUState expectedState {
@@ -113,6 +113,7 @@ void performTest(CPUFixture& cpuFixture, const SingleTest &test) {
 
     REQUIRE(actualState == expectedState);
     REQUIRE(ramMatch);
+    REQUIRE(cycles == test.cycles.size());
 }
 
 void testOpcode(CPUFixture& fixture, const std::string_view filename) {
@@ -666,4 +667,127 @@ TEST_CASE_METHOD(CPUFixture, "CPU miscellaneous instructions") {
     SECTION("STOP: Stop") {
         testOpcode(*this, "10");
     }
-}
\ No newline at end of file
+}
+
+TEST_CASE_METHOD(CPUFixture, "CPU runs for a cycle budget") {
+    SECTION("Budget is met exactly") {
+        // Memory is all NOPs which take 1 M-cycle each
+        cpu.setState({.sp = 0xFFFE, .pc = 0xC000, .ime = 0});
+
+        REQUIRE(cpu.run(1000) == 1000);
+        REQUIRE(cpu.getState().pc == 0xC000 + 1000);
+    }
+
+    SECTION("Budget is only exceeded by the last instruction") {
+        // LD B, n takes 2 M-cycles
+        for (u16 address {0xC000}; address < 0xC400; address += 2) {
+            bus.write(address, 0x06);
+            bus.write(address + 1, 0x00);
+        }
+        cpu.setState({.sp = 0xFFFE, .pc = 0xC000, .ime = 0});
+
+        REQUIRE(cpu.run(101) == 102);
+        REQUIRE(cpu.getState().pc == 0xC000 + 102);
+    }
+}
+
+TEST_CASE("Stepping many instructions matches single steps") {
+    // Code in VRAM never gets cached, so stepMany() runs all of it:
+    //   LD B, $20 / LD HL, $C000
+    //   loop: LD A, B / ADD A, A / LD (HL+), A / CALL sub / DEC B / JR NZ, loop / JR -2
+    //   sub: EI / INC C / DI / RET
+    constexpr u8 program[] {
+        0x06, 0x20, 0x21, 0x00, 0xC0, 0x78, 0x87, 0x22, 0xCD, 0x10, 0x80, 0x05, 0x20, 0xF7, 0x18, 0xFE,
+        0xFB, 0x0C, 0xF3, 0xC9,
+    };
+
+    MockBus manyBus;
+    MockBus singleBus;
+    for (u16 i {0}; i < sizeof(program); i++) {
+        manyBus.write(0x8000 + i, program[i]);
+        singleBus.write(0x8000 + i, program[i]);
+    }
+
+    CPU<MockBus> many(manyBus);
+    CPU<MockBus> single(singleBus);
+    many.setState({.sp = 0xFFFE, .pc = 0x8000, .ime = 0});
+    single.setState({.sp = 0xFFFE, .pc = 0x8000, .ime = 0});
+
+    u64 manyCycles {0};
+    while (manyCycles < 2000) manyCycles += many.stepMany(2000 - manyCycles);
+
+    u64 singleCycles {0};
+    while (singleCycles < manyCycles) singleCycles += single.step();
+
+    CPUState manyState {many.getState()};
+    CPUState singleState {single.getState()};
+    const bool statesMatch {manyState == singleState};
+    REQUIRE(statesMatch);
+    REQUIRE(manyCycles == singleCycles);
+    REQUIRE(manyState.c == 0x20);
+    for (u16 address {0xC000}; address < 0xC020; address++) {
+        REQUIRE(manyBus.read(address) == singleBus.read(address));
+    }
+}
+
+TEST_CASE_METHOD(CPUFixture, "CPU halts and skips idle time") {
+    SECTION("Halted CPU uses up the whole budget") {
+        bus.write(0xC000, 0x76);  // HALT
+        bus.write(0xFFFF, 0x04);  // Timer interrupt enabled
+        cpu.setState({.sp = 0xFFFE, .pc = 0xC000, .ime = 1});
+
+        REQUIRE(cpu.run(500) == 500);
+        REQUIRE(cpu.isHalted());
+        REQUIRE(cpu.getState().pc == 0xC001);
+
+        // Requesting the interrupt wakes the CPU and jumps to its handler
+        bus.write(0xFF0F, 0x04);
+        cpu.run(1);
+        REQUIRE_FALSE(cpu.isHalted());
+        REQUIRE(cpu.getState().pc == 0x0050);
+        REQUIRE(cpu.getState().ime == 0);
+        REQUIRE(bus.read(0xFF0F) == 0x00);
+    }
+
+    SECTION("Loop polling LY gets skipped") {
+        // LDH A, ($44) / CP $90 / JR NZ, -6
+        const u8 code[] {0xF0, 0x44, 0xFE, 0x90, 0x20, 0xFA};
+        for (u16 i {0}; i < sizeof(code); i++) bus.write(0xC000 + i, code[i]);
+        cpu.setState({.sp = 0xFFFE, .pc = 0xC000, .ime = 0});
+        cpu.setIdleLoopSkipping(true);
+
+        REQUIRE(cpu.run(10000) == 10000);
+        REQUIRE(cpu.skippedCycles() > 9000);
+        REQUIRE(cpu.getState().pc == 0xC000);
+    }
+
+    SECTION("Loop polling through HL isn't skipped") {
+        // LD A, (HL) / CP $90 / JR NZ, -5. HL could be moved onto something which counts on its own
+        const u8 code[] {0x7E, 0xFE, 0x90, 0x20, 0xFB};
+        for (u16 i {0}; i < sizeof(code); i++) bus.write(0xC000 + i, code[i]);
+        cpu.setState({.h = 0xFF, .l = 0x44, .sp = 0xFFFE, .pc = 0xC000, .ime = 0});
+        cpu.setIdleLoopSkipping(true);
+
+        REQUIRE(cpu.run(10000) >= 10000);
+        REQUIRE(cpu.skippedCycles() == 0);
+    }
+
+    SECTION("HALT with IME clear and an interrupt pending reads the next byte twice") {
+        // HALT / LD A, n / INC D. LD A, n gets its own opcode as the operand
+        const u8 code[] {0x76, 0x3E, 0x14};
+        for (u16 i {0}; i < sizeof(code); i++) bus.write(0xC000 + i, code[i]);
+        bus.write(0xFFFF, 0x04);
+        bus.write(0xFF0F, 0x04);
+        cpu.setState({.sp = 0xFFFE, .pc = 0xC000, .ime = 0});
+
+        cpu.step();
+        REQUIRE_FALSE(cpu.isHalted());
+
+        cpu.step();
+        REQUIRE(cpu.getState().a == 0x3E);
+        REQUIRE(cpu.getState().pc == 0xC002);
+
+        cpu.step();
+        REQUIRE(cpu.getState().d == 1);
+    }
+}
@@ -0,0 +1,95 @@
+#include <cstdlib>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "common/types.h"
+#include "core/gameboy.h"
+#include "testrom.h"
+
+TEST_CASE("OAM DMA copies 160 bytes and locks out OAM until done") {
+    GameBoy gb;
+    gb.initForTests();
+
+    for (u16 i {0}; i < DMA::OAM_SIZE; i++) gb.bus.write(0xC100 + i, static_cast<u8>(i ^ 0x5A));
+    gb.bus.write(0xFF46, 0xC1);
+
+    REQUIRE(gb.dma.isOamDmaActive());
+    REQUIRE(gb.bus.read(0xFE00) == 0xFF);
+    gb.bus.write(0xFE00, 0x00);  // Ignored
+
+    gb.run(DMA::OAM_DMA_CYCLES - 1);
+    REQUIRE(gb.dma.isOamDmaActive());
+    gb.run(1);
+    REQUIRE_FALSE(gb.dma.isOamDmaActive());
+
+    for (u16 i {0}; i < DMA::OAM_SIZE; i++) REQUIRE(gb.bus.read(0xFE00 + i) == static_cast<u8>(i ^ 0x5A));
+    REQUIRE(gb.bus.read(0xFF46) == 0xC1);
+}
+
+TEST_CASE("GBC VRAM DMA") {
+    GameBoy gb;
+    gb.init(testrom::make({.cgbOnly = true}));
+
+    for (u16 i {0}; i < 0x100; i++) gb.bus.write(0xC000 + i, static_cast<u8>(i));
+    gb.bus.write(0xFF4F, 0x01);  // VRAM bank 1
+    gb.bus.write(0xFF51, 0xC0);
+    gb.bus.write(0xFF52, 0x00);
+    gb.bus.write(0xFF53, 0x81);
+    gb.bus.write(0xFF54, 0x00);
+
+    SECTION("General purpose DMA copies everything while the CPU waits") {
+        gb.cpu.setState({.sp = 0xFFFE, .pc = 0xC000, .ime = 0});
+        gb.bus.write(0xFF55, 0x0F);  // 16 blocks
+
+        REQUIRE(gb.bus.read(0xFF55) == 0xFF);
+        for (u16 i {0}; i < 0x100; i++) REQUIRE(gb.bus.read(0x8100 + i) == i);
+
+        // Stalled CPU doesn't run the code at $C000
+        gb.run(16 * DMA::HDMA_BLOCK_CYCLES);
+        REQUIRE(gb.cpu.getState().pc == 0xC000);
+
+        gb.bus.write(0xFF4F, 0x00);
+        REQUIRE(gb.bus.read(0x8100) == 0x00);
+    }
+
+    SECTION("H-blank DMA copies a block per H-blank and can be cancelled") {
+        gb.bus.write(0xFF55, 0x83);  // 4 blocks
+        REQUIRE(gb.bus.read(0xFF55) == 0x03);
+        REQUIRE(gb.bus.read(0x8100) == 0x00);
+
+        gb.dma.hblank();
+        REQUIRE(gb.bus.read(0xFF55) == 0x02);
+        REQUIRE(gb.bus.read(0x810F) == 0x0F);
+        REQUIRE(gb.bus.read(0x8110) == 0x00);
+
+        gb.bus.write(0xFF55, 0x00);
+        REQUIRE(gb.bus.read(0xFF55) == 0x82);
+        gb.dma.hblank();
+        REQUIRE(gb.bus.read(0x8110) == 0x00);
+    }
+}
+
+TEST_CASE("STOP switches speed when armed through KEY1") {
+    GameBoy gb;
+    gb.init(testrom::make({.cgbOnly = true}));
+
+    // LD A, $01 / LDH ($4D), A / STOP / loop: INC BC / JR loop
+    const u8 code[] {0x3E, 0x01, 0xE0, 0x4D, 0x10, 0x03, 0x18, 0xFD};
+    for (u16 i {0}; i < sizeof(code); i++) gb.bus.write(0xC000 + i, code[i]);
+    gb.cpu.setState({.sp = 0xFFFE, .pc = 0xC000, .ime = 0});
+
+    REQUIRE(gb.bus.read(0xFF4D) == 0x7E);
+    gb.run(GameBoy::SPEED_SWITCH_CYCLES);
+    REQUIRE(gb.speedShift() == 1);
+    REQUIRE(gb.bus.read(0xFF4D) == 0xFE);
+
+    // Double speed CPU runs 2 M-cycles per M-cycle of time, and each loop takes 5.
+    // Runs stop at PPU events, so the last loop can go over by a few M-cycles
+    const auto counter = [&gb] {
+        const CPUState state {gb.cpu.getState()};
+        return (state.b << 8) | state.c;
+    };
+    const int start {counter()};
+    gb.run(1000);
+    REQUIRE(std::abs(counter() - start - 2000 / 5) <= 1);
+}
@@ -0,0 +1,107 @@
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "common/types.h"
+#include "core/bus.h"
+#include "core/cpu.h"
+#include "core/gameboy.h"
+
+#ifdef GBBUDDY_JIT
+
+namespace {
+    // Countdown loop in WRAM which stores A into (HL+) each iteration:
+    //   loop: ADD A, B / XOR C / LD (HL+), A / INC D / DEC E / JR NZ, loop / HALT
+    void writeLoop(MockBus& bus) {
+        constexpr u8 program[] {0x80, 0xA9, 0x22, 0x14, 0x1D, 0x20, 0xF9, 0x76};
+        for (u16 i {0}; i < sizeof(program); i++) {
+            bus.write(0xC000 + i, program[i]);
+        }
+    }
+
+    constexpr CPUState START_STATE {.a = 1, .b = 3, .c = 0x5A, .e = 200, .h = 0xD0, .sp = 0xFFFE, .pc = 0xC000, .ime = 0};
+}
+
+TEST_CASE("JIT matches the interpreter") {
+    MockBus jitBus;
+    MockBus interpreterBus;
+    writeLoop(jitBus);
+    writeLoop(interpreterBus);
+
+    CPU<MockBus> jitCPU(jitBus);
+    CPU<MockBus> interpreterCPU(interpreterBus);
+    jitCPU.setState(START_STATE);
+    interpreterCPU.setState(START_STATE);
+    jitCPU.setJitDiffMode(true);
+
+    u64 jitCycles {0};
+    while (jitCPU.getState().pc != 0xC008) {
+        jitCycles += jitCPU.runJit();
+    }
+
+    u64 interpreterCycles {0};
+    while (interpreterCPU.getState().pc != 0xC008) {
+        interpreterCycles += interpreterCPU.step();
+    }
+
+    CPUState jitState {jitCPU.getState()};
+    CPUState interpreterState {interpreterCPU.getState()};
+    const bool statesMatch {jitState == interpreterState};
+
+    REQUIRE(jitCPU.jitStats().compiledBlocks == 1);
+    REQUIRE(jitCPU.jitStats().mismatches == 0);
+    REQUIRE(statesMatch);
+    REQUIRE(jitCycles == interpreterCycles);
+    for (u16 address {0xD000}; address < 0xD000 + 200; address++) {
+        REQUIRE(jitBus.read(address) == interpreterBus.read(address));
+    }
+}
+
+TEST_CASE("JIT exits blocks which overwrite their own code") {
+    MockBus bus;
+    CPU<MockBus> cpu(bus);
+
+    // loop: LD (HL+), A / INC B / JR loop
+    // HL walks up from $BFF0 until it hits the loop itself
+    constexpr u8 program[] {0x22, 0x04, 0x18, 0xFC};
+    for (u16 i {0}; i < sizeof(program); i++) {
+        bus.write(0xC000 + i, program[i]);
+    }
+
+    cpu.setState({.a = 0x22, .h = 0xBF, .l = 0xF0, .sp = 0xFFFE, .pc = 0xC000, .ime = 0});
+    cpu.setJitDiffMode(true);
+
+    for (int i {0}; i < 17; i++) {
+        cpu.runJit();
+    }
+
+    REQUIRE(cpu.jitStats().compiledBlocks == 1);
+    REQUIRE(cpu.jitStats().mismatches == 0);
+    REQUIRE(cpu.blockCacheStats().invalidations == 1);
+    REQUIRE(cpu.getState().b == 16);
+    REQUIRE(cpu.getState().pc == 0xC001);
+}
+
+TEST_CASE("JIT diff mode ignores I/O side effects on the real bus") {
+    GameBoy gb;
+    gb.init(std::vector<u8>(32 * 1024, 0));
+
+    // loop: LDH A, (LY) / LD A, $C0 / LDH (DMA), A / LD A, $08 / LDH (STAT), A / JR loop
+    // Starting OAM DMA blocks OAM and STAT only keeps its writable bits, neither of which the shadow copies
+    constexpr u8 program[] {0xF0, 0x44, 0x3E, 0xC0, 0xE0, 0x46, 0x3E, 0x08, 0xE0, 0x41, 0x18, 0xF4};
+    for (u16 i {0}; i < sizeof(program); i++) {
+        gb.bus.write(0xC000 + i, program[i]);
+    }
+
+    gb.cpu.setState({.sp = 0xFFFE, .pc = 0xC000, .ime = 0});
+    gb.cpu.setJitDiffMode(true);
+
+    for (int i {0}; i < 100; i++) {
+        gb.cpu.runJit();
+    }
+
+    REQUIRE(gb.cpu.jitStats().compiledBlocks >= 3);
+    REQUIRE(gb.cpu.jitStats().mismatches == 0);
+}
+
+#endif
@@ -0,0 +1,98 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string_view>
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "common/hash.h"
+#include "common/types.h"
+#include "core/romlibrary.h"
+
+namespace {
+    std::span<const u8> bytes(std::string_view string) {
+        return {reinterpret_cast<const u8*>(string.data()), string.size()};
+    }
+
+    void writeRom(const std::filesystem::path& path, const char* title, u8 fill) {
+        std::vector<char> rom(32 * 1024, static_cast<char>(fill));
+        std::fill(rom.begin() + 0x0134, rom.begin() + 0x0150, '\0');
+        std::copy_n(title, std::strlen(title), rom.begin() + 0x0134);
+        rom[0x0147] = 0x00;
+        std::ofstream {path, std::ios::binary}.write(rom.data(), static_cast<std::streamsize>(rom.size()));
+    }
+}
+
+TEST_CASE("Hashes match reference values") {
+    Crc32 crc32 {};
+    crc32.update(bytes("123456789"));
+    REQUIRE(crc32.value() == 0xCBF43926);
+
+    // Fed in pieces which don't line up with SHA-1 blocks
+    Sha1 sha1 {};
+    const std::string message(1000, 'a');
+    for (usize i {0}; i < message.size(); i += 7) sha1.update(bytes(message).subspan(i, std::min<usize>(7, message.size() - i)));
+    const Sha1::Digest expected {0x29, 0x1e, 0x9a, 0x6c, 0x66, 0x99, 0x49, 0x49, 0xb5, 0x7b, 0xa5, 0xe6, 0x50, 0x36, 0x1e, 0x98, 0xfc, 0x36, 0xb1, 0xba};
+    REQUIRE(sha1.finish() == expected);
+}
+
+TEST_CASE("ROM library only rereads changed files") {
+    const std::filesystem::path root {std::filesystem::temp_directory_path() / "gbbuddy_librarytest"};
+    std::filesystem::remove_all(root);
+    std::filesystem::create_directories(root / "nested" / "deeper");
+
+    writeRom(root / "a.gb", "ALPHA", 0x11);
+    writeRom(root / "nested" / "b.GBC", "BRAVO", 0x22);
+    writeRom(root / "nested" / "deeper" / "c.gb", "CHARLIE", 0x33);
+    std::ofstream {root / "nested" / "readme.txt"} << "Not a ROM";
+    std::ofstream {root / "nested" / "broken.gb"} << "Too small";
+
+    const std::vector<std::filesystem::path> directories {root};
+    const std::filesystem::path indexPath {root / "library.idx"};
+
+    {
+        RomLibrary library {indexPath};
+        REQUIRE(library.scan(directories) == 4);
+        REQUIRE(library.roms().size() == 3);
+        REQUIRE(library.roms()[0].header.title == "ALPHA");
+        REQUIRE(library.save());
+    }
+
+    RomLibrary library {indexPath};
+    REQUIRE(library.roms().size() == 3);
+    REQUIRE(library.roms()[2].header.title == "CHARLIE");
+
+    Crc32 crc32 {};
+    std::ifstream file {root / "nested" / "deeper" / "c.gb", std::ios::binary};
+    std::vector<u8> contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    crc32.update(contents);
+    REQUIRE(library.roms()[2].crc32 == crc32.value());
+
+    // Broken file is tried again as it never made it into the index
+    REQUIRE(library.scan(directories) == 1);
+
+    std::filesystem::remove(root / "a.gb");
+    writeRom(root / "nested" / "b.GBC", "BRAVO2", 0x44);
+    std::filesystem::last_write_time(root / "nested" / "b.GBC", std::filesystem::file_time_type::clock::now() + std::chrono::seconds {5});
+    REQUIRE(library.scan(directories) == 2);
+    REQUIRE(library.roms().size() == 2);
+    REQUIRE(library.roms()[0].header.title == "BRAVO2");
+
+    std::filesystem::remove_all(root);
+}
+
+TEST_CASE("ROM library ignores index with impossible entry count") {
+    const std::filesystem::path indexPath {std::filesystem::temp_directory_path() / "gbbuddy_librarytest_corrupt.idx"};
+
+    // Magic and version 1, then a count with no entries after it
+    const std::vector<char> index {'G', 'B', 'B', 'L', 1, 0, 0, 0, '\xFF', '\xFF', '\xFF', '\x7F'};
+    std::ofstream {indexPath, std::ios::binary}.write(index.data(), static_cast<std::streamsize>(index.size()));
+
+    RomLibrary library {indexPath};
+    REQUIRE(library.roms().empty());
+
+    std::filesystem::remove(indexPath);
+}
@@ -0,0 +1,245 @@
+#include <algorithm>
+#include <array>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include "common/types.h"
+#include "core/gameboy.h"
+#include "core/mappers/rtc.h"
+#include "testrom.h"
+
+TEST_CASE("MBC1 switches banks") {
+    GameBoy gb;
+    gb.init(testrom::make({.cartType = 0x03, .romBanks = 64, .ramSize = 0x03}));  // 1MiB ROM, 32KiB RAM
+
+    REQUIRE(gb.bus.read(0x0000) == 0);
+    REQUIRE(gb.bus.read(0x4000) == 1);
+
+    SECTION("ROM bank 0 selects bank 1") {
+        gb.bus.write(0x2000, 0x05);
+        REQUIRE(gb.bus.read(0x4000) == 5);
+
+        gb.bus.write(0x2000, 0x00);
+        REQUIRE(gb.bus.read(0x4000) == 1);
+
+        // Only the low 5 bits are checked for 0, so $20 also becomes 1
+        gb.bus.write(0x2000, 0x20);
+        REQUIRE(gb.bus.read(0x4000) == 1);
+    }
+
+    SECTION("Upper bits extend the ROM bank") {
+        gb.bus.write(0x2000, 0x03);
+        gb.bus.write(0x4000, 0x01);
+        REQUIRE(gb.bus.read(0x4000) == 0x23);
+        REQUIRE(gb.bus.read(0x0000) == 0);
+
+        // Advanced banking mode applies them to $0000-$3FFF as well
+        gb.bus.write(0x6000, 0x01);
+        REQUIRE(gb.bus.read(0x0000) == 0x20);
+    }
+
+    SECTION("RAM needs to be enabled and is banked in advanced mode") {
+        REQUIRE(gb.bus.read(0xA000) == 0xFF);
+
+        gb.bus.write(0x0000, 0x0A);
+        gb.bus.write(0xA000, 0x55);
+        REQUIRE(gb.bus.read(0xA000) == 0x55);
+
+        gb.bus.write(0x6000, 0x01);
+        gb.bus.write(0x4000, 0x02);
+        REQUIRE(gb.bus.read(0xA000) == 0x00);
+
+        gb.bus.write(0x4000, 0x00);
+        REQUIRE(gb.bus.read(0xA000) == 0x55);
+
+        gb.bus.write(0x0000, 0x00);
+        REQUIRE(gb.bus.read(0xA000) == 0xFF);
+    }
+}
+
+TEST_CASE("MBC1 multicarts use 4-bit ROM bank numbers") {
+    static constexpr u8 LOGO[] {
+        0xCE, 0xED, 0x66, 0x66, 0xCC, 0x0D, 0x00, 0x0B, 0x03, 0x73, 0x00, 0x83, 0x00, 0x0C, 0x00, 0x0D,
+        0x00, 0x08, 0x11, 0x1F, 0x88, 0x89, 0x00, 0x0E, 0xDC, 0xCC, 0x6E, 0xE6, 0xDD, 0xDD, 0xD9, 0x99,
+        0xBB, 0xBB, 0x67, 0x63, 0x6E, 0x0E, 0xEC, 0xCC, 0xDD, 0xDC, 0x99, 0x9F, 0xBB, 0xB9, 0x33, 0x3E,
+    };
+
+    std::vector<u8> rom {testrom::make({.cartType = 0x01, .romBanks = 64})};
+    for (usize game {0}; game < 4; game++) {
+        std::copy(std::begin(LOGO), std::end(LOGO), rom.begin() + game * 0x10 * testrom::ROM_BANK_SIZE + 0x0104);
+    }
+
+    GameBoy gb;
+    gb.init(std::move(rom));
+
+    gb.bus.write(0x2000, 0x12);  // Bit 4 isn't connected
+    gb.bus.write(0x4000, 0x01);
+    REQUIRE(gb.bus.read(0x4000) == 0x12);
+
+    gb.bus.write(0x6000, 0x01);
+    REQUIRE(gb.bus.read(0x0000) == 0x10);
+}
+
+TEST_CASE("Block switching its own ROM bank stops at the switch") {
+    std::vector<u8> rom {testrom::make({.cartType = 0x01, .romBanks = 4})};
+
+    // Same code in banks 1 and 2 selects bank 2 and then runs INC B in bank 1 or INC C in bank 2
+    for (usize bank : {1, 2}) {
+        const std::array<u8, 8> code {0x3E, 0x02, 0xEA, 0x00, 0x20, static_cast<u8>(bank == 1 ? 0x04 : 0x0C), 0x18, 0xFE};
+        std::ranges::copy(code, rom.begin() + bank * testrom::ROM_BANK_SIZE + 1);
+    }
+
+    GameBoy gb;
+    gb.init(rom);
+    gb.cpu.setState({.sp = 0xFFFE, .pc = 0x4001, .ime = 0});
+
+    gb.cpu.runBlock();
+    REQUIRE(gb.cpu.getState().pc == 0x4006);
+
+    gb.cpu.runBlock();
+    REQUIRE(gb.cpu.getState().b == 0);
+    REQUIRE(gb.cpu.getState().c == 1);
+}
+
+TEST_CASE("MBC3 clock runs on emulated time") {
+    GameBoy gb;
+    gb.init(testrom::make({.cartType = 0x10, .romBanks = 128, .ramSize = 0x03}));
+
+    gb.bus.write(0x2000, 0x45);
+    REQUIRE(gb.bus.read(0x4000) == 0x45);
+
+    // Enable RAM and select seconds register
+    gb.bus.write(0x0000, 0x0A);
+    gb.bus.write(0x4000, 0x08);
+
+    auto latch = [&] {
+        gb.bus.write(0x6000, 0x00);
+        gb.bus.write(0x6000, 0x01);
+    };
+
+    gb.scheduler.advance(GameBoy::CYCLES_PER_SECOND * 90 + 10);
+    REQUIRE(gb.bus.read(0xA000) == 0);  // Not latched yet
+
+    latch();
+    REQUIRE(gb.bus.read(0xA000) == 30);
+    gb.bus.write(0x4000, 0x09);
+    REQUIRE(gb.bus.read(0xA000) == 1);
+
+    SECTION("Halted clock doesn't count") {
+        gb.bus.write(0x4000, 0x0C);
+        gb.bus.write(0xA000, 0x40);
+        gb.scheduler.advance(GameBoy::CYCLES_PER_SECOND * 1000);
+        latch();
+
+        gb.bus.write(0x4000, 0x09);
+        REQUIRE(gb.bus.read(0xA000) == 1);
+    }
+
+    SECTION("Clock survives a save file footer") {
+        RTC rtc;
+        rtc.write(RTC::HOURS, 23, 0);
+        rtc.write(RTC::DAYS_LOW, 0xFF, 0);
+        rtc.write(RTC::DAYS_HIGH, 0x01, 0);
+
+        std::array<u8, RTC::FOOTER_SIZE> footer {};
+        rtc.saveFooter(footer, 1000, GameBoy::CYCLES_PER_SECOND * 3600);
+
+        // Loading an hour later carries into the day overflow bit
+        RTC loaded;
+        loaded.loadFooter(footer, 1000 + 3600, 0);
+        loaded.latch(0);
+        REQUIRE(loaded.read(RTC::HOURS) == 1);
+        REQUIRE(loaded.read(RTC::DAYS_LOW) == 0);
+        REQUIRE(loaded.read(RTC::DAYS_HIGH) == 0x80);
+    }
+}
+
+TEST_CASE("MBC5 switches between 512 ROM banks") {
+    std::vector<u8> rom {testrom::make({.cartType = 0x1E, .romBanks = 512, .ramSize = 0x04})};  // 8MiB ROM, 128KiB RAM, rumble
+    rom[0x1FF * testrom::ROM_BANK_SIZE + 1] = 0xAB;
+
+    GameBoy gb;
+    gb.init(std::move(rom));
+
+    std::vector<bool> rumbleChanges {};
+    gb.cartridge.setRumbleHandler([](void* context, bool enabled) {
+        static_cast<std::vector<bool>*>(context)->push_back(enabled);
+    }, &rumbleChanges);
+
+    gb.bus.write(0x2000, 0xFF);
+    gb.bus.write(0x3000, 0x01);
+    REQUIRE(gb.bus.read(0x4001) == 0xAB);
+
+    // Unlike MBC1, bank 0 can be mapped to $4000-$7FFF
+    gb.bus.write(0x2000, 0x00);
+    gb.bus.write(0x3000, 0x00);
+    REQUIRE(gb.bus.read(0x4000) == 0);
+
+    gb.bus.write(0x0000, 0x0A);
+    gb.bus.write(0x4000, 0x0F);  // Bank 7 with the motor on
+    gb.bus.write(0xA000, 0x12);
+    gb.bus.write(0x4000, 0x0F);
+    gb.bus.write(0x4000, 0x07);  // Same bank, motor off
+    REQUIRE(gb.bus.read(0xA000) == 0x12);
+    REQUIRE(rumbleChanges == std::vector<bool> {true, false});
+}
+
+TEST_CASE("Battery RAM is mapped from the save file") {
+    const std::filesystem::path romPath {std::filesystem::temp_directory_path() / "gbbuddy_savetest.gb"};
+    const std::filesystem::path savePath {std::filesystem::temp_directory_path() / "gbbuddy_savetest.sav"};
+    std::filesystem::remove(savePath);
+
+    const std::vector<u8> rom {testrom::make({.cartType = 0x1B, .romBanks = 4, .ramSize = 0x03})};  // MBC5 + RAM + battery, 32KiB RAM
+    std::ofstream {romPath, std::ios::binary}.write(reinterpret_cast<const char*>(rom.data()), rom.size());
+
+    {
+        GameBoy gb;
+        gb.init(romPath);
+        REQUIRE(std::filesystem::file_size(savePath) == 32 * 1024);
+
+        gb.bus.write(0x0000, 0x0A);
+        gb.bus.write(0x4000, 0x03);
+        gb.bus.write(0xA123, 0x5A);
+        REQUIRE(gb.cartridge.isRamDirty());
+        gb.bus.write(0xA124, 0xA5);
+
+        gb.run(1);
+        REQUIRE_FALSE(gb.cartridge.isRamDirty());
+    }
+
+    // Written straight to the file without anything copying RAM out
+    std::vector<char> saved(32 * 1024);
+    std::ifstream {savePath, std::ios::binary}.read(saved.data(), saved.size());
+    REQUIRE(saved[3 * 0x2000 + 0x123] == 0x5A);
+    REQUIRE(static_cast<u8>(saved[3 * 0x2000 + 0x124]) == 0xA5);
+
+    {
+        GameBoy gb;
+        gb.init(romPath);
+        gb.bus.write(0x0000, 0x0A);
+        gb.bus.write(0x4000, 0x03);
+        REQUIRE(gb.bus.read(0xA123) == 0x5A);
+    }
+
+    std::filesystem::remove(romPath);
+    std::filesystem::remove(savePath);
+}
+
+TEST_CASE("MBC1 bank switching throughput", "[.][benchmark]") {
+    GameBoy gb;
+    gb.init(testrom::make({.cartType = 0x01, .romBanks = 128}));
+
+    // Switches bank and reads from it every iteration:
+    //   INC B / LD A, B / LD ($2000), A / LD A, ($4000) / LD A, ($4100) / JR loop
+    const u8 code[] {0x04, 0x78, 0xEA, 0x00, 0x20, 0xFA, 0x00, 0x40, 0xFA, 0x00, 0x41, 0x18, 0xF3};
+    for (u16 i {0}; i < sizeof(code); i++) gb.bus.write(0xC000 + i, code[i]);
+    gb.cpu.setState({.sp = 0xFFFE, .pc = 0xC000, .ime = 0});
+
+    BENCHMARK("1M M-cycles of bank switching") {
+        return gb.cpu.run(1'000'000);
+    };
+}
@@ -6,23 +6,23 @@
 #include "core/gameboy.h"
 
 void testWriteAndRead(GameBoy &gb, u16 addr, u8 value) {
-    gb.mmu->memoryWrite(addr, value);
-    REQUIRE(gb.mmu->memoryRead(addr) == value);
+    gb.bus.write(addr, value);
+    REQUIRE(gb.bus.read(addr) == value);
 }
 
 TEST_CASE("Memory writes are successful") {
     GameBoy gb;
     gb.initForTests();
-    gb.mmu = std::make_unique<RealMMU>(&gb);
 
     // Setup random number generation
     std::mt19937 mt{std::random_device{}()};
     std::uniform_int_distribution randomByte{0, 0xFF};
 
-    SECTION("Writes to ROM are successful") {
+    SECTION("Writes to ROM leave it untouched") {
         for (int addr {0}; addr <= 0x7FFF; addr++) {
-            u8 value {static_cast<u8>(randomByte(mt))};
-            testWriteAndRead(gb, static_cast<u16>(addr), value);
+            const u8 original {gb.bus.read(static_cast<u16>(addr))};
+            gb.bus.write(static_cast<u16>(addr), static_cast<u8>(randomByte(mt)));
+            REQUIRE(gb.bus.read(static_cast<u16>(addr)) == original);
         }
     }
 
@@ -88,4 +88,72 @@ TEST_CASE("Memory writes are successful") {
             testWriteAndRead(gb, static_cast<u16>(addr), value);
         }
     }
-}
\ No newline at end of file
+}
+
+TEST_CASE("I/O registers go through their hooks") {
+    GameBoy gb;
+    gb.initForTests();
+
+    struct Counters {
+        int syncs {0};
+        int writes {0};
+        u8 lastWrite {0};
+    } counters;
+
+    gb.bus.setIORegister(0xFF41, {
+        .context = &counters,
+        .sync = [](void* context) { static_cast<Counters*>(context)->syncs++; },
+        .write = [](void* context, u16, u8 value) {
+            auto* counters {static_cast<Counters*>(context)};
+            counters->writes++;
+            counters->lastWrite = value;
+        },
+        .readMask = 0x7F,
+        .writeMask = 0x78,
+    });
+
+    gb.bus.write(0xFF41, 0xFF);
+    REQUIRE(counters.writes == 1);
+    REQUIRE(counters.lastWrite == 0x78);
+
+    // Unreadable bit 7 reads as 1 while read-only bits 0-2 keep their value
+    gb.bus.write(0xFF41, 0x07);
+    REQUIRE(gb.bus.read(0xFF41) == 0x80);
+    REQUIRE(counters.syncs == 3);
+
+    SECTION("Read hook replaces stored value") {
+        gb.bus.setIORegister(0xFF44, {.read = [](void*, u16) -> u8 { return 0x90; }});
+        gb.bus.write(0xFF44, 0x12);
+        REQUIRE(gb.bus.read(0xFF44) == 0x90);
+    }
+}
+
+TEST_CASE("GBC bank registers switch VRAM and WRAM banks") {
+    GameBoy gb;
+    gb.initForTests();
+    gb.bus.setCgbMode(true);
+
+    for (u8 bank {1}; bank <= 7; bank++) {
+        gb.bus.write(0xFF70, bank);
+        gb.bus.write(0xD000, bank);
+    }
+
+    for (u8 bank {1}; bank <= 7; bank++) {
+        gb.bus.write(0xFF70, bank);
+        REQUIRE(gb.bus.read(0xD000) == bank);
+        REQUIRE(gb.bus.read(0xF000) == bank);  // Echo follows the selected bank
+    }
+
+    // Bank 0 maps bank 1 but reads back as written
+    gb.bus.write(0xFF70, 0x00);
+    REQUIRE(gb.bus.read(0xD000) == 1);
+    REQUIRE(gb.bus.read(0xFF70) == 0xF8);
+
+    gb.bus.write(0x8000, 0x11);
+    gb.bus.write(0xFF4F, 0x01);
+    REQUIRE(gb.bus.read(0xFF4F) == 0xFF);
+    gb.bus.write(0x8000, 0x22);
+    gb.bus.write(0xFF4F, 0x00);
+    REQUIRE(gb.bus.read(0x8000) == 0x11);
+    REQUIRE(gb.bus.read(0xFF4F) == 0xFE);
+}
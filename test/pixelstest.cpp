@@ -0,0 +1,146 @@
+#include <array>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include "common/types.h"
+#include "core/pixels.h"
+
+namespace {
+    // Every instruction set this host can run, scalar first
+    std::vector<pixels::Isa> hostIsas() {
+        std::vector<pixels::Isa> isas {pixels::Isa::Scalar};
+        for (pixels::Isa isa : {pixels::Isa::SSE2, pixels::Isa::AVX2}) {
+            if (pixels::hostIsa() >= isa) isas.push_back(isa);
+        }
+        return isas;
+    }
+
+    constexpr pixels::Palette SHADES {0xFFFFFFFF, 0xAAAAAAFF, 0x555555FF, 0x000000FF};
+}
+
+TEST_CASE("Pixel kernels match the scalar versions") {
+    std::mt19937 random {1234};
+    std::uniform_int_distribution<u32> byte {0, 0xFF};
+
+    // Odd length covers every tail case of the vector loops
+    std::vector<u8> planar(2 * 23);
+    for (u8& value : planar) value = static_cast<u8>(byte(random));
+
+    std::vector<u8> expectedIndices(planar.size() * 4);
+    pixels::decode(planar, expectedIndices, pixels::Isa::Scalar);
+    REQUIRE(expectedIndices[0] == (((planar[1] >> 7) & 1) << 1 | ((planar[0] >> 7) & 1)));
+    REQUIRE(expectedIndices[15] == (((planar[3] & 1) << 1) | (planar[2] & 1)));
+
+    const pixels::Palette palette {pixels::dmgPalette(0x1B, SHADES)};
+    std::vector<u32> expectedColours(expectedIndices.size());
+    pixels::applyPalette(expectedIndices, palette, expectedColours, pixels::Isa::Scalar);
+    REQUIRE(expectedColours[0] == SHADES[3 - expectedIndices[0]]);
+
+    for (pixels::Isa isa : hostIsas()) {
+        CAPTURE(static_cast<int>(isa));
+
+        std::vector<u8> indices(expectedIndices.size());
+        pixels::decode(planar, indices, isa);
+        REQUIRE(indices == expectedIndices);
+
+        std::vector<u32> colours(indices.size());
+        pixels::applyPalette(indices, palette, colours, isa);
+        REQUIRE(colours == expectedColours);
+    }
+}
+
+TEST_CASE("Compositor matches the scalar reference for every pixel combination") {
+    // Every background index, sprite index and attribute byte, with each combination in a different lane position
+    std::vector<u8> bg;
+    std::vector<u8> sprites;
+    std::vector<u8> attributes;
+    for (u32 bgIndex {0}; bgIndex < 4; bgIndex++) {
+        for (u32 spriteIndex {0}; spriteIndex < 4; spriteIndex++) {
+            for (u32 attribute {0}; attribute < 0x100; attribute++) {
+                bg.push_back(static_cast<u8>(bgIndex));
+                sprites.push_back(static_cast<u8>(spriteIndex));
+                attributes.push_back(static_cast<u8>(attribute));
+            }
+        }
+    }
+    // Odd length leaves a tail for the vector loops
+    bg.push_back(1);
+    sprites.push_back(2);
+    attributes.push_back(pixels::BEHIND_BG);
+
+    pixels::LinePalettes palettes {};
+    for (usize i {0}; i < palettes.size(); i++) palettes[i] = 0x01020304u * static_cast<u32>(i + 1);
+
+    for (bool bgPriority : {true, false}) {
+        std::vector<u32> expected(bg.size());
+        for (usize i {0}; i < bg.size(); i++) {
+            expected[i] = palettes[pixels::compositeIndex(bg[i], sprites[i], attributes[i], bgPriority)];
+        }
+
+        for (pixels::Isa isa : hostIsas()) {
+            CAPTURE(bgPriority, static_cast<int>(isa));
+
+            std::vector<u32> colours(bg.size());
+            pixels::composite(bg, sprites, attributes, palettes, bgPriority, colours, isa);
+            REQUIRE(colours == expected);
+        }
+    }
+
+    REQUIRE(pixels::compositeIndex(0, 0, 0, true) == 0);
+    REQUIRE(pixels::compositeIndex(2, 0, 0, true) == 2);
+    REQUIRE(pixels::compositeIndex(2, 3, 0, true) == 7);
+    REQUIRE(pixels::compositeIndex(2, 3, pixels::OBJ_PALETTE_1, true) == 11);
+    REQUIRE(pixels::compositeIndex(2, 3, pixels::BEHIND_BG, true) == 2);
+    REQUIRE(pixels::compositeIndex(0, 3, pixels::BEHIND_BG, true) == 7);
+    REQUIRE(pixels::compositeIndex(2, 3, pixels::BEHIND_BG, false) == 7);
+}
+
+TEST_CASE("GBC palettes expand RGB555 to RGBA8888") {
+    // White, pure red, pure blue, black
+    const std::array<u8, 8> data {0xFF, 0x7F, 0x1F, 0x00, 0x00, 0x7C, 0x00, 0x00};
+    const pixels::Palette palette {pixels::cgbPalette(data)};
+    REQUIRE(palette[0] == 0xFFFFFFFF);
+    REQUIRE(palette[1] == 0xFF0000FF);
+    REQUIRE(palette[2] == 0x0000FFFF);
+    REQUIRE(palette[3] == 0x000000FF);
+}
+
+TEST_CASE("Pixel kernel throughput", "[.][benchmark]") {
+    // A whole frame's worth of lines
+    std::vector<u8> planar(40 * 144);
+    for (usize i {0}; i < planar.size(); i++) planar[i] = static_cast<u8>(i * 37);
+    std::vector<u8> indices(planar.size() * 4);
+    std::vector<u32> colours(indices.size());
+    const pixels::Palette palette {pixels::dmgPalette(0xE4, SHADES)};
+
+    // Sprites every few pixels with a mix of priorities and palettes
+    std::vector<u8> spriteIndices(indices.size());
+    std::vector<u8> attributes(indices.size());
+    for (usize i {0}; i < spriteIndices.size(); i++) {
+        spriteIndices[i] = static_cast<u8>(i % 5 < 2 ? i % 4 : 0);
+        attributes[i] = static_cast<u8>(i * 0x30);
+    }
+    pixels::LinePalettes linePalettes {};
+    for (usize i {0}; i < linePalettes.size(); i++) linePalettes[i] = SHADES[i % 4];
+
+    for (pixels::Isa isa : hostIsas()) {
+        const char* name {isa == pixels::Isa::AVX2 ? "AVX2" : isa == pixels::Isa::SSE2 ? "SSE2" : "scalar"};
+
+        BENCHMARK(std::string {"Decode 144 lines, "} + name) {
+            pixels::decode(planar, indices, isa);
+            return indices[0];
+        };
+        BENCHMARK(std::string {"Apply palette to 144 lines, "} + name) {
+            pixels::applyPalette(indices, palette, colours, isa);
+            return colours[0];
+        };
+        BENCHMARK(std::string {"Composite 144 lines, "} + name) {
+            pixels::composite(indices, spriteIndices, attributes, linePalettes, true, colours, isa);
+            return colours[0];
+        };
+    }
+}
@@ -0,0 +1,228 @@
+#include <algorithm>
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "common/types.h"
+#include "core/gameboy.h"
+#include "testrom.h"
+
+namespace {
+    constexpr u16 IF_ADDRESS {0xFF0F};
+}
+
+TEST_CASE("PPU timing follows scheduled events") {
+    GameBoy gb;
+    gb.init(testrom::make());
+    gb.bus.write(IF_ADDRESS, 0x00);
+
+    REQUIRE(gb.bus.read(PPU::LY_ADDRESS) == 0);
+    REQUIRE((gb.bus.read(PPU::STAT_ADDRESS) & 0x03) == 2);
+
+    gb.run(PPU::OAM_SCAN_CYCLES);
+    REQUIRE((gb.bus.read(PPU::STAT_ADDRESS) & 0x03) == 3);
+    gb.run(PPU::DRAWING_CYCLES);
+    REQUIRE((gb.bus.read(PPU::STAT_ADDRESS) & 0x03) == 0);
+
+    gb.run(PPU::LINE_CYCLES - PPU::OAM_SCAN_CYCLES - PPU::DRAWING_CYCLES);
+    REQUIRE(gb.bus.read(PPU::LY_ADDRESS) == 1);
+
+    SECTION("V-blank starts at line 144") {
+        gb.run(143 * PPU::LINE_CYCLES - 1);
+        REQUIRE(gb.bus.read(PPU::LY_ADDRESS) == 143);
+        REQUIRE((gb.bus.read(IF_ADDRESS) & 0x01) == 0);
+
+        gb.run(1);
+        REQUIRE(gb.bus.read(PPU::LY_ADDRESS) == 144);
+        REQUIRE((gb.bus.read(PPU::STAT_ADDRESS) & 0x03) == 1);
+        REQUIRE((gb.bus.read(IF_ADDRESS) & 0x01) != 0);
+        REQUIRE(gb.ppu.frameCount() == 1);
+
+        // Whole frame later it's back at the same point
+        gb.run(GameBoy::CYCLES_PER_FRAME);
+        REQUIRE(gb.bus.read(PPU::LY_ADDRESS) == 144);
+        REQUIRE(gb.ppu.frameCount() == 2);
+    }
+
+    SECTION("LYC match raises STAT interrupt") {
+        gb.bus.write(PPU::LYC_ADDRESS, 5);
+        gb.bus.write(PPU::STAT_ADDRESS, 0x40);
+        gb.run(3 * PPU::LINE_CYCLES);
+        REQUIRE((gb.bus.read(IF_ADDRESS) & 0x02) == 0);
+
+        gb.run(PPU::LINE_CYCLES);
+        REQUIRE(gb.bus.read(PPU::LY_ADDRESS) == 5);
+        REQUIRE((gb.bus.read(PPU::STAT_ADDRESS) & 0x04) != 0);
+        REQUIRE((gb.bus.read(IF_ADDRESS) & 0x02) != 0);
+    }
+
+    SECTION("Turning the LCD off resets LY") {
+        gb.bus.write(PPU::LCDC_ADDRESS, 0x11);
+        REQUIRE(gb.bus.read(PPU::LY_ADDRESS) == 0);
+        gb.run(GameBoy::CYCLES_PER_FRAME);
+        REQUIRE(gb.bus.read(PPU::LY_ADDRESS) == 0);
+        REQUIRE(gb.ppu.frameCount() == 0);
+    }
+}
+
+TEST_CASE("PPU draws background and sprites into the framebuffer") {
+    GameBoy gb;
+    gb.init(testrom::make());
+    gb.bus.write(PPU::LCDC_ADDRESS, 0x00);
+
+    // Tile 1 is colour 3 on its left half and colour 1 on its right
+    for (u16 row {0}; row < 8; row++) {
+        gb.bus.write(0x8010 + row * 2, 0xFF);
+        gb.bus.write(0x8011 + row * 2, 0xF0);
+    }
+    gb.bus.write(0x9800, 0x01);  // Top-left tile of the map
+    gb.bus.write(PPU::BGP_ADDRESS, 0xE4);
+    gb.bus.write(PPU::OBP0_ADDRESS, 0xE4);
+
+    // Sprite using tile 1 at screen (16, 0), flipped horizontally
+    gb.bus.write(0xFE00, 16);
+    gb.bus.write(0xFE01, 24);
+    gb.bus.write(0xFE02, 0x01);
+    gb.bus.write(0xFE03, 0x20);
+
+    gb.bus.write(PPU::LCDC_ADDRESS, 0x93);
+    gb.run(GameBoy::CYCLES_PER_FRAME);
+
+    const std::span<const u32> pixels {gb.ppu.framebuffer()};
+    REQUIRE(pixels.size() == PPU::SCREEN_WIDTH * PPU::SCREEN_HEIGHT);
+    REQUIRE(pixels[0] == 0x000000FF);
+    REQUIRE(pixels[4] == 0xAAAAAAFF);
+    REQUIRE(pixels[8] == 0xFFFFFFFF);
+    REQUIRE(pixels[7 * PPU::SCREEN_WIDTH + 3] == 0x000000FF);
+    REQUIRE(pixels[16] == 0xAAAAAAFF);
+    REQUIRE(pixels[20] == 0x000000FF);
+    REQUIRE(pixels[8 * PPU::SCREEN_WIDTH + 16] == 0xFFFFFFFF);
+
+    SECTION("Scrolling moves the background") {
+        gb.bus.write(PPU::SCX_ADDRESS, 4);
+        gb.run(GameBoy::CYCLES_PER_FRAME);
+        REQUIRE(gb.ppu.framebuffer()[0] == 0xAAAAAAFF);
+        REQUIRE(gb.ppu.framebuffer()[4] == 0xFFFFFFFF);
+    }
+}
+
+TEST_CASE("PPU replays lines with mid-line writes through the pixel FIFO") {
+    GameBoy gb;
+    gb.init(testrom::make());
+    gb.bus.write(PPU::LCDC_ADDRESS, 0x00);
+
+    // Tile 1 is colour 3 on its left half and colour 1 on its right, tile 2 is colour 2 everywhere
+    for (u16 row {0}; row < 8; row++) {
+        gb.bus.write(0x8010 + row * 2, 0xFF);
+        gb.bus.write(0x8011 + row * 2, 0xF0);
+        gb.bus.write(0x8021 + row * 2, 0xFF);
+    }
+    for (u16 i {0}; i < 0x400; i++) {
+        gb.bus.write(0x9800 + i, static_cast<u8>(1 + i % 3 / 2));
+        gb.bus.write(0x9C00 + i, 0x02);
+    }
+    gb.bus.write(PPU::BGP_ADDRESS, 0xE4);
+    gb.bus.write(PPU::OBP0_ADDRESS, 0xD2);
+    gb.bus.write(PPU::SCX_ADDRESS, 3);
+    gb.bus.write(PPU::SCY_ADDRESS, 5);
+    gb.bus.write(PPU::WX_ADDRESS, 87);
+    gb.bus.write(0xFE00, 16);
+    gb.bus.write(0xFE01, 40);
+    gb.bus.write(0xFE02, 0x01);
+
+    // Window uses the $9C00 map
+    gb.bus.write(PPU::LCDC_ADDRESS, 0xE3);
+    gb.run(GameBoy::CYCLES_PER_FRAME);
+    REQUIRE(gb.ppu.lastFrameStats().fastLines == PPU::SCREEN_HEIGHT);
+    REQUIRE(gb.ppu.lastFrameStats().fifoLines == 0);
+
+    const std::vector<u32> fastFrame(gb.ppu.framebuffer().begin(), gb.ppu.framebuffer().end());
+
+    // Stop part way through drawing line 0 of the next frame
+    constexpr u64 midLine {PPU::OAM_SCAN_CYCLES + 20};
+    gb.run(midLine);
+    REQUIRE(gb.bus.read(PPU::LY_ADDRESS) == 0);
+    REQUIRE((gb.bus.read(PPU::STAT_ADDRESS) & 0x03) == 3);
+
+    SECTION("Writes which change nothing match the fast path") {
+        gb.bus.write(PPU::BGP_ADDRESS, 0xE4);
+        gb.bus.write(PPU::SCX_ADDRESS, 3);
+        gb.run(PPU::SCREEN_HEIGHT * PPU::LINE_CYCLES - midLine);
+
+        REQUIRE(gb.ppu.lastFrameStats().fastLines == PPU::SCREEN_HEIGHT - 1);
+        REQUIRE(gb.ppu.lastFrameStats().fifoLines == 1);
+        REQUIRE(std::ranges::equal(gb.ppu.framebuffer(), fastFrame));
+    }
+
+    SECTION("Palette change takes effect part way along the line") {
+        gb.bus.write(PPU::BGP_ADDRESS, 0x1B);
+        gb.run(PPU::SCREEN_HEIGHT * PPU::LINE_CYCLES - midLine);
+
+        const std::span<const u32> pixels {gb.ppu.framebuffer()};
+        REQUIRE(gb.ppu.lastFrameStats().fifoLines == 1);
+        REQUIRE(pixels[0] == fastFrame[0]);
+        REQUIRE(pixels[32] == fastFrame[32]);  // Sprite keeps its own palette
+        REQUIRE(pixels[PPU::SCREEN_WIDTH - 1] != fastFrame[PPU::SCREEN_WIDTH - 1]);
+    }
+}
+
+TEST_CASE("Palette writes made by code during drawing land at the dot they were made") {
+    GameBoy gb;
+    gb.init(testrom::make());
+    gb.bus.write(PPU::LCDC_ADDRESS, 0x00);
+
+    // Background is tile 0 everywhere, which is colour 3
+    for (u16 i {0}; i < 16; i++) gb.bus.write(0x8000 + i, 0xFF);
+    gb.bus.write(PPU::BGP_ADDRESS, 0xE4);
+
+    // Inverts the palette 14 M-cycles into drawing, then puts it back 13 M-cycles later. Fits in one block
+    const std::vector<u8> code {
+        0x3E, 0x1B,  // LD A, $1B
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0xE0, 0x47,  // LDH (BGP), A
+        0x3E, 0xE4,  // LD A, $E4
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0xE0, 0x47,  // LDH (BGP), A
+        0x18, 0xFE,  // JR -2
+    };
+    for (u16 i {0}; i < code.size(); i++) gb.bus.write(0xC000 + i, code[i]);
+
+    gb.bus.write(PPU::LCDC_ADDRESS, 0x91);
+    gb.run(PPU::OAM_SCAN_CYCLES);
+    REQUIRE((gb.bus.read(PPU::STAT_ADDRESS) & 0x03) == 3);
+
+    gb.cpu.setState({.sp = 0xFFFE, .pc = 0xC000, .ime = 0});
+    gb.run(PPU::SCREEN_HEIGHT * PPU::LINE_CYCLES - PPU::OAM_SCAN_CYCLES);
+
+    const std::span<const u32> pixels {gb.ppu.framebuffer()};
+    REQUIRE(gb.ppu.lastFrameStats().fifoLines == 1);
+
+    // Pixel x gets shifted out at dot x + 14, so writes at dots 56 and 108 land on pixels 42 and 94
+    REQUIRE(pixels[41] == 0x000000FF);
+    REQUIRE(pixels[42] == 0xFFFFFFFF);
+    REQUIRE(pixels[93] == 0xFFFFFFFF);
+    REQUIRE(pixels[94] == 0x000000FF);
+    REQUIRE(std::ranges::count(pixels.first(PPU::SCREEN_WIDTH), 0xFFFFFFFF) == 94 - 42);
+}
+
+TEST_CASE("Writes to tile data invalidate decoded tiles") {
+    GameBoy gb;
+    gb.init(testrom::make());
+    gb.bus.write(PPU::BGP_ADDRESS, 0xE4);
+
+    // Map is all tile 0, which starts out blank
+    gb.run(GameBoy::CYCLES_PER_FRAME);
+    REQUIRE(gb.ppu.framebuffer()[0] == 0xFFFFFFFF);
+
+    gb.bus.write(0x8000, 0x80);
+    REQUIRE(gb.bus.read(0x8000) == 0x80);
+    gb.run(GameBoy::CYCLES_PER_FRAME);
+    REQUIRE(gb.ppu.framebuffer()[0] == 0xAAAAAAFF);
+    REQUIRE(gb.ppu.framebuffer()[1] == 0xFFFFFFFF);
+    REQUIRE(gb.ppu.framebuffer()[8] == 0xAAAAAAFF);
+
+    const DecodedTile& tile {gb.bus.tiles().tile(0, 0)};
+    REQUIRE(tile.pixels[0] == 1);
+    REQUIRE(tile.flipped[7] == 1);
+    REQUIRE(tile.flipped[0] == 0);
+}
@@ -0,0 +1,96 @@
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "common/types.h"
+#include "core/scheduler.h"
+
+namespace {
+    struct FiredEvent {
+        EventType type;
+        u64 timestamp;
+    };
+
+    struct EventLog {
+        std::vector<FiredEvent> fired {};
+    };
+
+    template<EventType type>
+    void logEvent(void* context, u64 timestamp) {
+        static_cast<EventLog*>(context)->fired.push_back({type, timestamp});
+    }
+
+    template<EventType... types>
+    void logEvents(Scheduler& scheduler, EventLog& log) {
+        (scheduler.setHandler(types, &logEvent<types>, &log), ...);
+    }
+}
+
+TEST_CASE("Scheduler fires events in deadline order") {
+    Scheduler scheduler;
+    EventLog log {};
+    logEvents<EventType::PPUModeChange, EventType::TimerOverflow, EventType::SerialBit>(scheduler, log);
+
+    scheduler.schedule(EventType::SerialBit, 300);
+    scheduler.schedule(EventType::PPUModeChange, 100);
+    scheduler.schedule(EventType::TimerOverflow, 200);
+
+    REQUIRE(scheduler.nextDeadline() == 100);
+
+    scheduler.advance(250);
+    scheduler.runDueEvents();
+
+    REQUIRE(log.fired.size() == 2);
+    REQUIRE(log.fired[0].type == EventType::PPUModeChange);
+    REQUIRE(log.fired[0].timestamp == 100);
+    REQUIRE(log.fired[1].type == EventType::TimerOverflow);
+    REQUIRE(scheduler.nextDeadline() == 300);
+}
+
+TEST_CASE("Scheduler reschedules and cancels events") {
+    Scheduler scheduler;
+    EventLog log {};
+    logEvents<EventType::PPUModeChange, EventType::DMAComplete>(scheduler, log);
+
+    scheduler.schedule(EventType::PPUModeChange, 100);
+    scheduler.schedule(EventType::DMAComplete, 50);
+
+    // Rescheduling replaces the pending event instead of adding another
+    scheduler.schedule(EventType::DMAComplete, 150);
+    REQUIRE(scheduler.nextDeadline() == 100);
+
+    scheduler.cancel(EventType::PPUModeChange);
+    REQUIRE_FALSE(scheduler.isScheduled(EventType::PPUModeChange));
+    REQUIRE(scheduler.nextDeadline() == 150);
+
+    scheduler.advance(1000);
+    scheduler.runDueEvents();
+
+    REQUIRE(log.fired.size() == 1);
+    REQUIRE(log.fired[0].type == EventType::DMAComplete);
+    REQUIRE(scheduler.nextDeadline() == Scheduler::NEVER);
+}
+
+TEST_CASE("Scheduler lets handlers schedule periodic events") {
+    Scheduler scheduler;
+    u64 lines {0};
+
+    struct Context {
+        Scheduler& scheduler;
+        u64& lines;
+    } context {scheduler, lines};
+
+    // Reschedules relative to when it was due so lateness doesn't build up
+    scheduler.setHandler(EventType::PPULineIncrement, [](void* data, u64 timestamp) {
+        auto& context {*static_cast<Context*>(data)};
+        context.lines++;
+        context.scheduler.scheduleAt(EventType::PPULineIncrement, timestamp + 114);
+    }, &context);
+
+    scheduler.schedule(EventType::PPULineIncrement, 114);
+    scheduler.advance(114 * 154 + 10);
+    scheduler.runDueEvents();
+
+    REQUIRE(lines == 154);
+    REQUIRE(scheduler.nextDeadline() == 114 * 155);
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <bit>
+#include <vector>
+
+#include "common/types.h"
+
+namespace testrom {
+    constexpr usize ROM_BANK_SIZE {16 * 1024};
+
+    struct Options {
+        u8 cartType {0x00};  // $0147, no mapper by default
+        usize romBanks {2};  // Power of two, at least 2
+        u8 ramSize {0x00};   // $0149 code
+        bool cgbOnly {false};
+    };
+
+    // Builds ROM where the first byte of every bank holds its bank number. The rest is NOPs
+    inline std::vector<u8> make(const Options& options = {}) {
+        std::vector<u8> rom(options.romBanks * ROM_BANK_SIZE, 0);
+        for (usize bank {0}; bank < options.romBanks; bank++) rom[bank * ROM_BANK_SIZE] = static_cast<u8>(bank);
+
+        if (options.cgbOnly) rom[0x0143] = 0xC0;
+        rom[0x0147] = options.cartType;
+        rom[0x0148] = static_cast<u8>(std::countr_zero(options.romBanks / 2));
+        rom[0x0149] = options.ramSize;
+        return rom;
+    }
+}